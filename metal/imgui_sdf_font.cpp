@@ -0,0 +1,247 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "imgui_sdf_font.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+
+#include "common/utils.hpp"
+#include "imgui_internal.h"
+#include "lib/sdf_text_types.h"
+
+ImGuiSdfFont::~ImGuiSdfFont() {
+  // Don't leave a dangling default font.
+  if (m_isEnabled && ImGui::GetCurrentContext() != nullptr) {
+    ImGui::GetIO().FontDefault = nullptr;
+    ImGui::GetStyle().AntiAliasedLinesUseTex = m_antiAliasedLinesUseTex;
+  }
+
+  if (m_pipelineState) {
+    m_pipelineState->release();
+  }
+}
+
+bool ImGuiSdfFont::initialize(MTL::Device * const device, MTL::Library * library) {
+  // Initialize shaders.
+  MTL::FunctionConstantValues * constantValues = MTL::FunctionConstantValues::alloc()->init();
+  METAL_GUARD(constantValues);
+
+  NS::Error * error = nullptr;
+  MTL::Function * vsFunction = library->newFunction(STR("vertexImGui"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(vsFunction);
+
+  MTL::Function * fsFunction =
+    library->newFunction(STR("fragmentImGuiSdf"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(fsFunction);
+
+  // Vertices are bound by the ImGui Metal backend, so the layout follows its
+  // vertex descriptor.
+  auto vertexDescriptor = MTL::VertexDescriptor::alloc()->init();
+  METAL_GUARD(vertexDescriptor);
+  auto position = vertexDescriptor->attributes()->object(ImGuiVertexAttributePosition);
+  position->setFormat(MTL::VertexFormatFloat2);
+  position->setOffset(offsetof(ImDrawVert, pos));
+  position->setBufferIndex(ImGuiBufferVertices);
+  auto uv = vertexDescriptor->attributes()->object(ImGuiVertexAttributeUV);
+  uv->setFormat(MTL::VertexFormatFloat2);
+  uv->setOffset(offsetof(ImDrawVert, uv));
+  uv->setBufferIndex(ImGuiBufferVertices);
+  auto color = vertexDescriptor->attributes()->object(ImGuiVertexAttributeColor);
+  color->setFormat(MTL::VertexFormatUChar4Normalized);
+  color->setOffset(offsetof(ImDrawVert, col));
+  color->setBufferIndex(ImGuiBufferVertices);
+  auto layout = vertexDescriptor->layouts()->object(ImGuiBufferVertices);
+  layout->setStride(sizeof(ImDrawVert));
+  layout->setStepFunction(MTL::VertexStepFunctionPerVertex);
+  layout->setStepRate(1);
+
+  // Initialize pipeline state, blending is the same as in the ImGui backend.
+  auto pipelineStateDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
+  pipelineStateDescriptor->setLabel(STR("ImGui SDF Pipeline State"));
+  METAL_GUARD(pipelineStateDescriptor);
+  pipelineStateDescriptor->setVertexFunction(vsFunction);
+  pipelineStateDescriptor->setFragmentFunction(fsFunction);
+  pipelineStateDescriptor->setVertexDescriptor(vertexDescriptor);
+  pipelineStateDescriptor->setSampleCount(1);
+  auto colorAttachment = pipelineStateDescriptor->colorAttachments()->object(0);
+  colorAttachment->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
+  colorAttachment->setBlendingEnabled(true);
+  colorAttachment->setRgbBlendOperation(MTL::BlendOperationAdd);
+  colorAttachment->setAlphaBlendOperation(MTL::BlendOperationAdd);
+  colorAttachment->setSourceRGBBlendFactor(MTL::BlendFactorSourceAlpha);
+  colorAttachment->setSourceAlphaBlendFactor(MTL::BlendFactorOne);
+  colorAttachment->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
+  colorAttachment->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
+
+  m_pipelineState = device->newRenderPipelineState(pipelineStateDescriptor, &error);
+  CHECK_AND_RETURN(error, false);
+
+  return true;
+}
+
+void ImGuiSdfFont::setGlyphAtlas(std::shared_ptr<sdf::gpu::GlyphAtlas const> glyphAtlas) {
+  m_glyphAtlas = std::move(glyphAtlas);
+  buildFont();
+  if (m_isEnabled) {
+    ImGui::GetIO().FontDefault = m_font;
+  }
+}
+
+void ImGuiSdfFont::setEnabled(bool enabled) {
+  if (m_isEnabled == enabled || m_font == nullptr) {
+    return;
+  }
+  m_isEnabled = enabled;
+  auto & style = ImGui::GetStyle();
+  if (m_isEnabled) {
+    ImGui::GetIO().FontDefault = m_font;
+    // There are no prebaked lines in the atlas.
+    m_antiAliasedLinesUseTex = style.AntiAliasedLinesUseTex;
+    style.AntiAliasedLinesUseTex = false;
+  } else {
+    ImGui::GetIO().FontDefault = nullptr;
+    style.AntiAliasedLinesUseTex = m_antiAliasedLinesUseTex;
+  }
+}
+
+void ImGuiSdfFont::setPixelSize(float pixelSize) {
+  m_pixelSize = pixelSize;
+  if (m_font != nullptr) {
+    m_font->Scale = m_pixelSize / m_font->FontSize;
+  }
+}
+
+void ImGuiSdfFont::beginFrame(MTL::RenderCommandEncoder * encoder) {
+  m_encoder = encoder;
+}
+
+void ImGuiSdfFont::endFrame() {
+  if (!m_isEnabled || m_font == nullptr) {
+    return;
+  }
+  restrictToSdfTexture(*ImGui::GetBackgroundDrawList());
+  for (ImGuiWindow * window : ImGui::GetCurrentContext()->Windows) {
+    if (window->Active) {
+      restrictToSdfTexture(*window->DrawList);
+    }
+  }
+  restrictToSdfTexture(*ImGui::GetForegroundDrawList());
+}
+
+void ImGuiSdfFont::restrictToSdfTexture(ImDrawList & drawList) const {
+  // Draw lists are rendered one after another, so the pipeline state is unknown at
+  // the start of a list and after user callbacks.
+  std::optional<bool> isSdfBound;
+  ImVector<ImDrawCmd> commands;
+  commands.reserve(drawList.CmdBuffer.Size + 1);
+  for (auto const & command : drawList.CmdBuffer) {
+    if (command.UserCallback == &ImGuiSdfFont::setupRenderState) {
+      isSdfBound = true;
+    } else if (command.UserCallback == ImDrawCallback_ResetRenderState) {
+      isSdfBound = false;
+    } else if (command.UserCallback != nullptr) {
+      isSdfBound.reset();
+    } else if (command.ElemCount != 0) {
+      bool const isSdf = command.GetTexID() == m_fontAtlas.TexID;
+      if (isSdfBound != isSdf) {
+        ImDrawCmd callback = command;
+        callback.ElemCount = 0;
+        if (isSdf) {
+          callback.UserCallback = &ImGuiSdfFont::setupRenderState;
+          callback.UserCallbackData = const_cast<ImGuiSdfFont *>(this);
+        } else {
+          callback.UserCallback = ImDrawCallback_ResetRenderState;
+        }
+        commands.push_back(callback);
+        isSdfBound = isSdf;
+      }
+    }
+    commands.push_back(command);
+  }
+  drawList.CmdBuffer.swap(commands);
+
+  // Commands which are added after this pass get the ImGui backend pipeline.
+  if (isSdfBound != false) {
+    drawList.AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+  }
+}
+
+// static
+void ImGuiSdfFont::setupRenderState(ImDrawList const *, ImDrawCmd const * command) {
+  auto const self = static_cast<ImGuiSdfFont *>(command->UserCallbackData);
+  self->m_encoder->setRenderPipelineState(self->m_pipelineState);
+}
+
+void ImGuiSdfFont::buildFont() {
+  m_fontAtlas.Clear();
+  m_font = nullptr;
+  if (m_glyphAtlas == nullptr) {
+    return;
+  }
+
+  auto const & glyphSet = m_glyphAtlas->getGlyphSet();
+  auto const atlasSize = glm::vec2(glyphSet.getAtlasSize());
+  m_fontAtlas.TexID = reinterpret_cast<ImTextureID>(m_glyphAtlas->getTexture());
+  m_fontAtlas.TexWidth = static_cast<int>(glyphSet.getAtlasSize().x);
+  m_fontAtlas.TexHeight = static_cast<int>(glyphSet.getAtlasSize().y);
+  m_fontAtlas.TexUvScale = ImVec2(1.0f / atlasSize.x, 1.0f / atlasSize.y);
+  // The solid texel (see GlyphSet).
+  m_fontAtlas.TexUvWhitePixel = ImVec2(0.5f / atlasSize.x, 0.5f / atlasSize.y);
+  m_fontAtlas.Flags |= ImFontAtlasFlags_NoBakedLines;
+  m_fontAtlas.TexReady = true;
+
+  m_font = IM_NEW(ImFont)();
+  m_fontAtlas.Fonts.push_back(m_font);
+  m_font->ContainerAtlas = &m_fontAtlas;
+  m_font->FontSize = static_cast<float>(glyphSet.getBaseFontSize());
+  m_font->Scale = m_pixelSize / m_font->FontSize;
+
+  // ImGui places glyphs relative to the top of the line with y going down.
+  float ascent = 0.0f;
+  float descent = 0.0f;
+  for (auto const & [code, glyphData] : glyphSet.getGlyphs()) {
+    if (code < sdf::GlyphSet::kFirstIconCode) {
+      ascent = std::max(ascent, glyphData.m_offset.y + glyphData.m_size.y);
+      descent = std::min(descent, glyphData.m_offset.y);
+    }
+  }
+  m_font->Ascent = ascent;
+  m_font->Descent = descent;
+
+  // Quads cover glyph bounds, borders of glyphs in the atlas are excluded as in TextRenderer.
+  auto const border = static_cast<float>(sdf::GlyphSet::kBorderInPixels);
+  for (auto code : glyphSet.getSortedCodes()) {
+    auto const & glyphData = glyphSet.getGlyphs().at(code);
+    auto const uv0 = (glm::vec2(glyphData.m_posInAtlas) + border) / atlasSize;
+    auto const uv1 =
+      (glm::vec2(glyphData.m_posInAtlas + glyphData.m_pixelSize) - border) / atlasSize;
+    m_font->AddGlyph(nullptr,
+                     static_cast<ImWchar>(code),
+                     glyphData.m_offset.x,
+                     ascent - glyphData.m_offset.y - glyphData.m_size.y,
+                     glyphData.m_offset.x + glyphData.m_size.x,
+                     ascent - glyphData.m_offset.y,
+                     uv0.x,
+                     uv0.y,
+                     uv1.x,
+                     uv1.y,
+                     glyphData.m_advance);
+  }
+  m_font->BuildLookupTable();
+}
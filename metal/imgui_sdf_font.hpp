@@ -0,0 +1,69 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+#include <memory>
+
+#include "imgui.h"
+#include "lib/glyph_atlas.hpp"
+
+// ImGui font which takes glyphs from the SDF glyph atlas, so ImGui text stays
+// crisp at any size without rasterizing a separate bitmap font atlas. When the
+// font is enabled it becomes the default ImGui font, and draw commands which sample
+// the glyph atlas (text and shapes filled from its solid texel) are drawn with an
+// SDF pipeline. Other textures, e.g. ImGui::Image, keep the ImGui backend pipeline.
+class ImGuiSdfFont {
+public:
+  ~ImGuiSdfFont();
+
+  bool initialize(MTL::Device * const device, MTL::Library * library);
+
+  // Must be called outside of an ImGui frame. The previous atlas must stay alive
+  // until frames which use it are completed (TextRenderer keeps retired atlases
+  // alive, so both can be switched at the same frame).
+  void setGlyphAtlas(std::shared_ptr<sdf::gpu::GlyphAtlas const> glyphAtlas);
+
+  // Takes effect at the next ImGui frame.
+  void setEnabled(bool enabled);
+  bool isEnabled() const { return m_isEnabled; }
+
+  void setPixelSize(float pixelSize);
+  float getPixelSize() const { return m_pixelSize; }
+
+  // Must be called in the ImGui frame before any window, `encoder` is the encoder
+  // which ImGui is rendered with.
+  void beginFrame(MTL::RenderCommandEncoder * encoder);
+  // Must be called in the ImGui frame after the last window is ended.
+  void endFrame();
+
+private:
+  static void setupRenderState(ImDrawList const * drawList, ImDrawCmd const * command);
+  // Switches the pipeline state before commands which change between the glyph
+  // atlas and other textures.
+  void restrictToSdfTexture(ImDrawList & drawList) const;
+  void buildFont();
+
+  MTL::RenderPipelineState * m_pipelineState = nullptr;
+  MTL::RenderCommandEncoder * m_encoder = nullptr;
+
+  std::shared_ptr<sdf::gpu::GlyphAtlas const> m_glyphAtlas;
+  ImFontAtlas m_fontAtlas;
+  ImFont * m_font = nullptr;
+  bool m_isEnabled = false;
+  float m_pixelSize = 15.0f;
+  // Anti-aliased lines are taken from the ImGui font texture by default.
+  bool m_antiAliasedLinesUseTex = true;
+};
@@ -0,0 +1,517 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "atlas_bake_service.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace sdf {
+namespace {
+uint32_t constexpr kRequestMagic = 0x53444652;  // 'SDFR'
+// 4: requests carry icons.
+uint32_t constexpr kProtocolVersion = 4;
+uint32_t constexpr kMaxFontNameLength = 256;
+uint32_t constexpr kMaxFontSize = 512;
+uint32_t constexpr kMaxAtlasSize = 16384;
+uint32_t constexpr kMaxIconsCount = GlyphSet::kLastIconCode - GlyphSet::kFirstIconCode + 1;
+uint32_t constexpr kMaxIconCommandsCount = 65536;
+uint32_t constexpr kRowsPerRegion = 64;
+
+uint32_t constexpr kStatusOk = 0;
+uint32_t constexpr kStatusFailed = 1;
+
+struct RequestHeader {
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_fontSize;
+  uint32_t m_atlasSize;
+  uint32_t m_fontNameLength;
+  uint32_t m_glyphsCount;
+  uint32_t m_packingOrder;
+  uint32_t m_iconsCount;
+};
+
+// Followed by commands (a byte each) and points (pairs of floats).
+struct IconHeader {
+  uint16_t m_code;
+  uint16_t m_reserved;
+  float m_viewBoxSize[2];
+  uint32_t m_commandsCount;
+  uint32_t m_pointsCount;
+};
+
+struct ResponseHeader {
+  uint32_t m_status;
+  uint32_t m_metadataSize;
+  uint64_t m_checksum;
+};
+
+struct RegionHeader {
+  uint32_t m_y;
+  uint32_t m_rows;
+};
+
+void disableSigPipe(int fd) {
+#ifdef SO_NOSIGPIPE
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+  (void)fd;
+#endif
+}
+
+bool sendAll(int fd, void const * data, size_t size) {
+#ifdef MSG_NOSIGNAL
+  int constexpr kFlags = MSG_NOSIGNAL;
+#else
+  int constexpr kFlags = 0;
+#endif
+  auto ptr = static_cast<uint8_t const *>(data);
+  while (size > 0) {
+    auto const sent = send(fd, ptr, size, kFlags);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    ptr += sent;
+    size -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+bool recvAll(int fd, void * data, size_t size) {
+  auto ptr = static_cast<uint8_t *>(data);
+  while (size > 0) {
+    auto const received = recv(fd, ptr, size, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    ptr += received;
+    size -= static_cast<size_t>(received);
+  }
+  return true;
+}
+
+bool sendIcon(int fd, GlyphSet::Icon const & icon) {
+  IconHeader header = {icon.m_code,
+                       0,
+                       {icon.m_viewBoxSize.x, icon.m_viewBoxSize.y},
+                       static_cast<uint32_t>(icon.m_commands.size()),
+                       static_cast<uint32_t>(icon.m_points.size())};
+  static_assert(sizeof(GlyphSet::Icon::Command) == 1);
+  static_assert(sizeof(glm::vec2) == 2 * sizeof(float));
+  return sendAll(fd, &header, sizeof(header)) &&
+         sendAll(fd, icon.m_commands.data(), icon.m_commands.size()) &&
+         sendAll(fd, icon.m_points.data(), icon.m_points.size() * sizeof(glm::vec2));
+}
+
+bool recvIcon(int fd, GlyphSet::Icon & icon) {
+  IconHeader header;
+  if (!recvAll(fd, &header, sizeof(header)) || header.m_commandsCount > kMaxIconCommandsCount ||
+      header.m_pointsCount > 3 * header.m_commandsCount) {
+    return false;
+  }
+  icon.m_code = header.m_code;
+  icon.m_viewBoxSize = glm::vec2(header.m_viewBoxSize[0], header.m_viewBoxSize[1]);
+  icon.m_commands.resize(header.m_commandsCount);
+  icon.m_points.resize(header.m_pointsCount);
+  return recvAll(fd, icon.m_commands.data(), icon.m_commands.size()) &&
+         recvAll(fd, icon.m_points.data(), icon.m_points.size() * sizeof(glm::vec2));
+}
+
+bool isFinite(glm::vec2 const & p) { return std::isfinite(p.x) && std::isfinite(p.y); }
+
+bool isValid(GlyphSet::Icon const & icon) {
+  auto const isKnown = [](auto command) { return command <= GlyphSet::Icon::Command::Close; };
+  return isFinite(icon.m_viewBoxSize) && icon.m_viewBoxSize.x > 0.0f &&
+         icon.m_viewBoxSize.y > 0.0f &&
+         std::all_of(icon.m_commands.begin(), icon.m_commands.end(), isKnown) &&
+         std::all_of(icon.m_points.begin(), icon.m_points.end(), isFinite);
+}
+
+bool makeSocketAddress(std::string const & socketPath, sockaddr_un & address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  return true;
+}
+
+bool isValid(BakeParams const & params) {
+  auto const isPowerOf2 = (params.m_atlasSize & (params.m_atlasSize - 1)) == 0;
+  return !params.m_fontName.empty() && params.m_fontName.size() <= kMaxFontNameLength &&
+         params.m_fontSize > 0 && params.m_fontSize <= kMaxFontSize && params.m_atlasSize > 0 &&
+         params.m_atlasSize <= kMaxAtlasSize && isPowerOf2 &&
+         params.m_icons.size() <= kMaxIconsCount &&
+         std::all_of(params.m_icons.begin(),
+                     params.m_icons.end(),
+                     [](GlyphSet::Icon const & icon) { return isValid(icon); });
+}
+}  // namespace
+
+AtlasBakeService::AtlasBakeService(std::string const & socketPath,
+                                   std::string const & cacheDirectory,
+                                   uint32_t workersCount /* = 0 */)
+  : m_socketPath(socketPath)
+  , m_cache(cacheDirectory)
+  , m_workersCount(workersCount != 0 ? workersCount
+                                     : std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+AtlasBakeService::~AtlasBakeService() { stop(); }
+
+bool AtlasBakeService::start() {
+  sockaddr_un address;
+  if (!makeSocketAddress(m_socketPath, address)) {
+    return false;
+  }
+  if (pipe(m_wakePipe) != 0) {
+    return false;
+  }
+
+  m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (m_listenFd < 0) {
+    stop();
+    return false;
+  }
+  // Remove a socket file left by a previous instance.
+  unlink(m_socketPath.c_str());
+  if (bind(m_listenFd, reinterpret_cast<sockaddr const *>(&address), sizeof(address)) != 0 ||
+      listen(m_listenFd, SOMAXCONN) != 0) {
+    stop();
+    return false;
+  }
+
+  m_isStopping = false;
+  for (uint32_t i = 0; i < m_workersCount; ++i) {
+    m_workers.emplace_back([this]() { runWorker(); });
+  }
+  m_acceptThread = std::thread([this]() { acceptConnections(); });
+  return true;
+}
+
+void AtlasBakeService::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    m_isStopping = true;
+  }
+  m_jobsCondition.notify_all();
+
+  if (m_wakePipe[1] >= 0) {
+    char const c = 0;
+    // Nothing else writes to the pipe, so the byte always fits.
+    while (write(m_wakePipe[1], &c, 1) < 0 && errno == EINTR) {
+    }
+  }
+  if (m_acceptThread.joinable()) {
+    m_acceptThread.join();
+  }
+
+  for (auto & worker : m_workers) {
+    worker.join();
+  }
+  m_workers.clear();
+
+  // Nobody is going to process the rest of the jobs, unblock connections waiting for them.
+  for (auto & job : m_jobs) {
+    job.m_promise.set_value(nullptr);
+  }
+  m_jobs.clear();
+  m_inFlight.clear();
+
+  std::unordered_map<int, std::thread> connections;
+  {
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    for (auto & [fd, _] : m_connections) {
+      shutdown(fd, SHUT_RDWR);
+    }
+    connections.swap(m_connections);
+    m_finishedConnections.clear();
+  }
+  for (auto & [fd, thread] : connections) {
+    thread.join();
+    close(fd);
+  }
+
+  if (m_listenFd >= 0) {
+    close(m_listenFd);
+    m_listenFd = -1;
+    unlink(m_socketPath.c_str());
+  }
+  for (auto & fd : m_wakePipe) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+}
+
+std::shared_ptr<BakedAtlas const> AtlasBakeService::getAtlas(BakeParams const & params) {
+  if (!isValid(params)) {
+    return nullptr;
+  }
+
+  AtlasFuture future;
+  {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    if (m_isStopping) {
+      return nullptr;
+    }
+    auto const key = params.getKey();
+    if (auto it = m_inFlight.find(key); it != m_inFlight.end()) {
+      // The same atlas is already being baked, wait for it instead of baking twice.
+      future = it->second;
+    } else {
+      Job job{params, {}};
+      future = job.m_promise.get_future().share();
+      m_inFlight.emplace(key, future);
+      m_jobs.push_back(std::move(job));
+      m_jobsCondition.notify_one();
+    }
+  }
+  return future.get();
+}
+
+void AtlasBakeService::acceptConnections() {
+  pollfd fds[2] = {{m_listenFd, POLLIN, 0}, {m_wakePipe[0], POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+
+    // Join connections which are already served.
+    {
+      std::lock_guard<std::mutex> lock(m_connectionsMutex);
+      for (auto fd : m_finishedConnections) {
+        if (auto it = m_connections.find(fd); it != m_connections.end()) {
+          it->second.join();
+          m_connections.erase(it);
+          close(fd);
+        }
+      }
+      m_finishedConnections.clear();
+    }
+
+    int fd = accept(m_listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    disableSigPipe(fd);
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+    m_connections.emplace(fd, std::thread([this, fd]() { serveConnection(fd); }));
+  }
+}
+
+void AtlasBakeService::serveConnection(int fd) {
+  // One connection can issue several requests one by one.
+  while (true) {
+    RequestHeader request;
+    if (!recvAll(fd, &request, sizeof(request)) || request.m_magic != kRequestMagic ||
+        request.m_version != kProtocolVersion || request.m_fontNameLength > kMaxFontNameLength ||
+        request.m_glyphsCount > std::numeric_limits<uint16_t>::max() + 1u ||
+        request.m_packingOrder > static_cast<uint32_t>(GlyphSet::PackingOrder::AsGiven) ||
+        request.m_iconsCount > kMaxIconsCount) {
+      break;
+    }
+
+    BakeParams params;
+    params.m_fontSize = request.m_fontSize;
+    params.m_atlasSize = request.m_atlasSize;
+    params.m_packingOrder = static_cast<GlyphSet::PackingOrder>(request.m_packingOrder);
+    params.m_fontName.resize(request.m_fontNameLength);
+    params.m_glyphs.resize(request.m_glyphsCount);
+    params.m_icons.resize(request.m_iconsCount);
+    bool received =
+      recvAll(fd, params.m_fontName.data(), params.m_fontName.size()) &&
+      recvAll(fd, params.m_glyphs.data(), params.m_glyphs.size() * sizeof(uint16_t));
+    for (size_t i = 0; received && i < params.m_icons.size(); ++i) {
+      received = recvIcon(fd, params.m_icons[i]);
+    }
+    if (!received) {
+      break;
+    }
+
+    auto const atlas = getAtlas(params);
+    if (atlas == nullptr) {
+      ResponseHeader response = {kStatusFailed, 0, 0};
+      if (!sendAll(fd, &response, sizeof(response))) {
+        break;
+      }
+      continue;
+    }
+
+    std::vector<uint8_t> metadata;
+    writeAtlasMetadata(atlas->m_glyphs, atlas->m_atlasSize, metadata);
+    ResponseHeader response = {kStatusOk,
+                               static_cast<uint32_t>(metadata.size()),
+                               atlas->m_checksum};
+    if (!sendAll(fd, &response, sizeof(response)) ||
+        !sendAll(fd, metadata.data(), metadata.size())) {
+      break;
+    }
+
+    // Stream texels by bands of rows, clients can start uploading early.
+    bool sent = true;
+    auto const width = atlas->m_atlasSize.x;
+    for (uint32_t y = 0; sent && y < atlas->m_atlasSize.y; y += kRowsPerRegion) {
+      RegionHeader region = {y, std::min(kRowsPerRegion, atlas->m_atlasSize.y - y)};
+      sent = sendAll(fd, &region, sizeof(region)) &&
+             sendAll(fd,
+                     atlas->m_texels.data() + static_cast<size_t>(y) * width,
+                     static_cast<size_t>(region.m_rows) * width);
+    }
+    if (!sent) {
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_connectionsMutex);
+  m_finishedConnections.push_back(fd);
+}
+
+void AtlasBakeService::runWorker() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_jobsMutex);
+      m_jobsCondition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+      if (m_isStopping) {
+        return;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    std::shared_ptr<BakedAtlas const> atlas;
+    if (auto cached = m_cache.load(job.m_params)) {
+      atlas = std::make_shared<BakedAtlas const>(std::move(cached.value()));
+    } else {
+      // Parallelism comes from the pool, so every bake is single-threaded.
+      auto baked = BakedAtlas::bake(job.m_params, 1 /* threadsCount */);
+      m_cache.store(job.m_params, baked);
+      atlas = std::make_shared<BakedAtlas const>(std::move(baked));
+    }
+
+    // Set the value before removing the future, so there is no window in which
+    // a new identical request starts another bake.
+    job.m_promise.set_value(atlas);
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    m_inFlight.erase(job.m_params.getKey());
+  }
+}
+
+// static
+std::optional<BakedAtlas> AtlasBakeClient::requestAtlas(std::string const & socketPath,
+                                                        BakeParams const & params,
+                                                        RegionCallback const & onRegion) {
+  sockaddr_un address;
+  if (!makeSocketAddress(socketPath, address)) {
+    return std::nullopt;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  disableSigPipe(fd);
+
+  auto result = [&]() -> std::optional<BakedAtlas> {
+    if (connect(fd, reinterpret_cast<sockaddr const *>(&address), sizeof(address)) != 0) {
+      return std::nullopt;
+    }
+
+    RequestHeader request = {kRequestMagic,
+                             kProtocolVersion,
+                             params.m_fontSize,
+                             params.m_atlasSize,
+                             static_cast<uint32_t>(params.m_fontName.size()),
+                             static_cast<uint32_t>(params.m_glyphs.size()),
+                             static_cast<uint32_t>(params.m_packingOrder),
+                             static_cast<uint32_t>(params.m_icons.size())};
+    if (!sendAll(fd, &request, sizeof(request)) ||
+        !sendAll(fd, params.m_fontName.data(), params.m_fontName.size()) ||
+        !sendAll(fd, params.m_glyphs.data(), params.m_glyphs.size() * sizeof(uint16_t))) {
+      return std::nullopt;
+    }
+    for (auto const & icon : params.m_icons) {
+      if (!sendIcon(fd, icon)) {
+        return std::nullopt;
+      }
+    }
+
+    ResponseHeader response;
+    // The atlas holds at most the requested glyphs and icons.
+    auto const maxMetadataSize =
+      getAtlasMetadataSize(params.m_glyphs.size() + params.m_icons.size());
+    if (!recvAll(fd, &response, sizeof(response)) || response.m_status != kStatusOk ||
+        response.m_metadataSize > maxMetadataSize) {
+      return std::nullopt;
+    }
+    std::vector<uint8_t> metadata(response.m_metadataSize);
+    if (!recvAll(fd, metadata.data(), metadata.size())) {
+      return std::nullopt;
+    }
+    BakedAtlas atlas;
+    if (readAtlasMetadata(metadata.data(), metadata.size(), atlas) != metadata.size()) {
+      return std::nullopt;
+    }
+
+    auto const width = atlas.m_atlasSize.x;
+    for (uint32_t y = 0; y < atlas.m_atlasSize.y;) {
+      RegionHeader region;
+      if (!recvAll(fd, &region, sizeof(region)) || region.m_y != y || region.m_rows == 0 ||
+          region.m_rows > atlas.m_atlasSize.y - y) {
+        return std::nullopt;
+      }
+      auto const texels = atlas.m_texels.data() + static_cast<size_t>(y) * width;
+      if (!recvAll(fd, texels, static_cast<size_t>(region.m_rows) * width)) {
+        return std::nullopt;
+      }
+      if (onRegion) {
+        onRegion(y, region.m_rows, texels);
+      }
+      y += region.m_rows;
+    }
+    atlas.m_checksum =
+      computeAtlasChecksum(atlas.m_glyphs, atlas.m_atlasSize, atlas.m_texels.data());
+    if (atlas.m_checksum != response.m_checksum) {
+      return std::nullopt;
+    }
+    return atlas;
+  }();
+
+  close(fd);
+  return result;
+}
+
+}  // namespace sdf
@@ -0,0 +1,97 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "atlas_cache.hpp"
+#include "baked_atlas.hpp"
+
+namespace sdf {
+
+// Local service which bakes atlases on CPU on request over a Unix domain socket.
+// Concurrent requests with the same parameters are coalesced into one bake and
+// results are served from the on-disk cache when possible, so many application
+// instances share one warm cache and one worker pool.
+class AtlasBakeService {
+public:
+  // If `workersCount` is 0, the number of hardware threads is used.
+  AtlasBakeService(std::string const & socketPath,
+                   std::string const & cacheDirectory,
+                   uint32_t workersCount = 0);
+  ~AtlasBakeService();
+
+  bool start();
+  void stop();
+
+  // Blocks until the atlas is available. Returns nullptr if baking failed.
+  std::shared_ptr<BakedAtlas const> getAtlas(BakeParams const & params);
+
+private:
+  using AtlasFuture = std::shared_future<std::shared_ptr<BakedAtlas const>>;
+
+  struct Job {
+    BakeParams m_params;
+    std::promise<std::shared_ptr<BakedAtlas const>> m_promise;
+  };
+
+  void acceptConnections();
+  void serveConnection(int fd);
+  void runWorker();
+
+  std::string const m_socketPath;
+  AtlasCache const m_cache;
+  uint32_t const m_workersCount;
+
+  int m_listenFd = -1;
+  // Written to wake up the accept thread on stop.
+  int m_wakePipe[2] = {-1, -1};
+  std::thread m_acceptThread;
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_connectionsMutex;
+  std::unordered_map<int, std::thread> m_connections;
+  std::vector<int> m_finishedConnections;
+
+  std::mutex m_jobsMutex;
+  std::condition_variable m_jobsCondition;
+  std::deque<Job> m_jobs;
+  std::unordered_map<uint64_t, AtlasFuture> m_inFlight;
+  bool m_isStopping = false;
+};
+
+// Client side of AtlasBakeService.
+class AtlasBakeClient {
+public:
+  // Called for every received band of atlas rows, e.g. to upload it to a texture
+  // while the rest of the atlas is still being streamed.
+  using RegionCallback = std::function<void(uint32_t y, uint32_t rows, uint8_t const * texels)>;
+
+  static std::optional<BakedAtlas> requestAtlas(std::string const & socketPath,
+                                                BakeParams const & params,
+                                                RegionCallback const & onRegion = {});
+};
+
+}  // namespace sdf
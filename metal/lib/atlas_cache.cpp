@@ -0,0 +1,156 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "atlas_cache.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+#include "atlas_codec.hpp"
+
+namespace sdf {
+namespace {
+uint32_t constexpr kFileMagic = 0x53444643;  // 'SDFC'
+uint32_t constexpr kFileVersion = 2;
+
+uint32_t constexpr kTexelsRaw = 0;
+uint32_t constexpr kTexelsAtlasCodec = 1;
+
+// File layout: header, atlas metadata, texels (raw or encoded).
+struct CacheFileHeader {
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint64_t m_key;
+  uint32_t m_texelsEncoding;
+  uint32_t m_reserved;
+  uint64_t m_checksum;
+};
+}  // namespace
+
+AtlasCache::AtlasCache(std::string const & directory, bool compress /* = true */)
+  : m_directory(directory), m_compress(compress) {
+  std::error_code ec;
+  std::filesystem::create_directories(m_directory, ec);
+}
+
+std::optional<BakedAtlas> AtlasCache::load(BakeParams const & params) const {
+  auto const key = params.getKey();
+  std::ifstream file(getPath(key), std::ios::binary | std::ios::ate);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()))) {
+    return std::nullopt;
+  }
+
+  CacheFileHeader header;
+  if (data.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.m_magic != kFileMagic || header.m_version != kFileVersion || header.m_key != key) {
+    return std::nullopt;
+  }
+
+  BakedAtlas atlas;
+  auto offset = sizeof(header);
+  auto const consumed = readAtlasMetadata(data.data() + offset, data.size() - offset, atlas);
+  if (consumed == 0) {
+    return std::nullopt;
+  }
+  offset += consumed;
+
+  auto const texelsData = data.data() + offset;
+  auto const texelsDataSize = data.size() - offset;
+  switch (header.m_texelsEncoding) {
+  case kTexelsRaw:
+    if (texelsDataSize != atlas.m_texels.size()) {
+      return std::nullopt;
+    }
+    memcpy(atlas.m_texels.data(), texelsData, atlas.m_texels.size());
+    break;
+  case kTexelsAtlasCodec:
+    if (!AtlasCodec::decode(texelsData, texelsDataSize, atlas.m_atlasSize, atlas.m_texels.data())) {
+      return std::nullopt;
+    }
+    break;
+  default:
+    return std::nullopt;
+  }
+
+  // Bakes are deterministic, so a mismatch means the file is damaged.
+  atlas.m_checksum =
+    computeAtlasChecksum(atlas.m_glyphs, atlas.m_atlasSize, atlas.m_texels.data());
+  if (atlas.m_checksum != header.m_checksum) {
+    return std::nullopt;
+  }
+  return atlas;
+}
+
+bool AtlasCache::store(BakeParams const & params, BakedAtlas const & atlas) const {
+  auto const key = params.getKey();
+  CacheFileHeader header = {};
+  header.m_magic = kFileMagic;
+  header.m_version = kFileVersion;
+  header.m_key = key;
+  header.m_texelsEncoding = m_compress ? kTexelsAtlasCodec : kTexelsRaw;
+  header.m_checksum = atlas.m_checksum;
+
+  std::vector<uint8_t> data(sizeof(header));
+  memcpy(data.data(), &header, sizeof(header));
+  writeAtlasMetadata(atlas.m_glyphs, atlas.m_atlasSize, data);
+  if (m_compress) {
+    auto const encoded = AtlasCodec::encode(atlas.m_texels.data(), atlas.m_atlasSize);
+    data.insert(data.end(), encoded.begin(), encoded.end());
+  } else {
+    data.insert(data.end(), atlas.m_texels.begin(), atlas.m_texels.end());
+  }
+
+  // Write to a temporary file and rename it, readers never see partial files.
+  auto const path = getPath(key);
+  auto const tmpPath = path + "." + std::to_string(getpid()) + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(reinterpret_cast<char const *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      file.close();
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string AtlasCache::getPath(uint64_t key) const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016" PRIx64 ".sdfatlas", key);
+  return (std::filesystem::path(m_directory) / name).string();
+}
+
+}  // namespace sdf
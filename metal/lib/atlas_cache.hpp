@@ -0,0 +1,42 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "baked_atlas.hpp"
+
+namespace sdf {
+
+// On-disk cache of baked atlases, one file per set of bake parameters.
+// Files are written atomically, so several processes can share a directory.
+// Texels are stored compressed with AtlasCodec unless `compress` is false;
+// both kinds of files are readable regardless of the setting.
+class AtlasCache {
+public:
+  explicit AtlasCache(std::string const & directory, bool compress = true);
+
+  std::optional<BakedAtlas> load(BakeParams const & params) const;
+  bool store(BakeParams const & params, BakedAtlas const & atlas) const;
+
+private:
+  std::string getPath(uint64_t key) const;
+
+  std::string m_directory;
+  bool m_compress = true;
+};
+
+}  // namespace sdf
@@ -0,0 +1,329 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "atlas_codec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+#include "parallel_for.hpp"
+
+namespace sdf {
+namespace {
+uint32_t constexpr kCodecMagic = 0x5344465a;  // 'SDFZ'
+uint32_t constexpr kCodecVersion = 1;
+
+uint8_t constexpr kBlockRaw = 0;
+uint8_t constexpr kBlockRans = 1;
+
+// rANS parameters (byte-wise renormalization, 32-bit state).
+uint32_t constexpr kProbBits = 12;
+uint32_t constexpr kProbScale = 1u << kProbBits;
+uint32_t constexpr kRansLowerBound = 1u << 23;
+
+struct CodecHeader {
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_rowsPerBlock;
+  uint32_t m_blocksCount;
+};
+
+struct SymbolStats {
+  std::array<uint32_t, 256> m_freqs = {};
+  std::array<uint32_t, 257> m_starts = {};
+};
+
+// LOCO-I median edge detector. Neighbours outside the block are replaced by the
+// available ones, so every block can be decoded independently.
+inline uint8_t predict(uint8_t const * row, uint8_t const * upRow, uint32_t x) {
+  int const a = x > 0 ? row[x - 1] : (upRow != nullptr ? upRow[x] : 0);
+  int const b = upRow != nullptr ? upRow[x] : a;
+  int const c = (x > 0 && upRow != nullptr) ? upRow[x - 1] : b;
+  if (c >= std::max(a, b)) return static_cast<uint8_t>(std::min(a, b));
+  if (c <= std::min(a, b)) return static_cast<uint8_t>(std::max(a, b));
+  return static_cast<uint8_t>(a + b - c);
+}
+
+// Maps small signed residuals to small symbols: 0, -1, 1, -2, 2, ...
+inline uint8_t toSymbol(uint8_t residual) {
+  auto const r = static_cast<int8_t>(residual);
+  return static_cast<uint8_t>((r << 1) ^ (r >> 7));
+}
+
+inline uint8_t fromSymbol(uint8_t symbol) {
+  return static_cast<uint8_t>((symbol >> 1) ^ -(symbol & 1));
+}
+
+// Scales symbol frequencies to sum up to kProbScale keeping every used symbol.
+void normalizeFreqs(SymbolStats & stats, size_t total) {
+  uint32_t sum = 0;
+  for (auto & f : stats.m_freqs) {
+    if (f != 0) {
+      f = std::max(1u, static_cast<uint32_t>(static_cast<uint64_t>(f) * kProbScale / total));
+      sum += f;
+    }
+  }
+  while (sum != kProbScale) {
+    auto largest = std::max_element(stats.m_freqs.begin(), stats.m_freqs.end());
+    if (sum < kProbScale) {
+      *largest += kProbScale - sum;
+      sum = kProbScale;
+    } else {
+      // Take from the largest symbols, they lose the least compression.
+      auto const take = std::min(sum - kProbScale, *largest - 1);
+      *largest -= take;
+      sum -= take;
+      if (take == 0) {
+        break;
+      }
+    }
+  }
+  stats.m_starts[0] = 0;
+  for (size_t i = 0; i < 256; ++i) {
+    stats.m_starts[i + 1] = stats.m_starts[i] + stats.m_freqs[i];
+  }
+}
+
+void putU16(std::vector<uint8_t> & out, uint16_t v) {
+  out.push_back(static_cast<uint8_t>(v));
+  out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void putU32(std::vector<uint8_t> & out, uint32_t v) {
+  putU16(out, static_cast<uint16_t>(v));
+  putU16(out, static_cast<uint16_t>(v >> 16));
+}
+
+uint32_t getU16(uint8_t const * p) { return static_cast<uint32_t>(p[0] | (p[1] << 8)); }
+
+uint32_t getU32(uint8_t const * p) { return getU16(p) | (getU16(p + 2) << 16); }
+
+std::vector<uint8_t> encodeRawBlock(uint8_t const * texels, size_t count) {
+  std::vector<uint8_t> out(1, kBlockRaw);
+  out.insert(out.end(), texels, texels + count);
+  return out;
+}
+
+std::vector<uint8_t> encodeBlock(uint8_t const * texels, uint32_t width, uint32_t rows) {
+  auto const count = static_cast<size_t>(width) * rows;
+  std::vector<uint8_t> symbols(count);
+  SymbolStats stats;
+  for (uint32_t y = 0; y < rows; ++y) {
+    auto const row = texels + static_cast<size_t>(y) * width;
+    auto const upRow = y > 0 ? row - width : nullptr;
+    for (uint32_t x = 0; x < width; ++x) {
+      auto const s = toSymbol(static_cast<uint8_t>(row[x] - predict(row, upRow, x)));
+      symbols[static_cast<size_t>(y) * width + x] = s;
+      stats.m_freqs[s]++;
+    }
+  }
+  normalizeFreqs(stats, count);
+
+  // rANS encodes backwards, so the decoder reads bytes forward.
+  // Every symbol takes at most kProbBits bits plus renormalization.
+  std::vector<uint8_t> rans(count * 2 + 16);
+  auto ptr = rans.data() + rans.size();
+  uint32_t state = kRansLowerBound;
+  for (size_t i = count; i-- > 0;) {
+    auto const s = symbols[i];
+    auto const freq = stats.m_freqs[s];
+    auto const maxState = ((kRansLowerBound >> kProbBits) << 8) * freq;
+    while (state >= maxState) {
+      if (ptr == rans.data()) {
+        return encodeRawBlock(texels, count);
+      }
+      *--ptr = static_cast<uint8_t>(state & 0xff);
+      state >>= 8;
+    }
+    state = ((state / freq) << kProbBits) + (state % freq) + stats.m_starts[s];
+  }
+  if (ptr - rans.data() < 4) {
+    return encodeRawBlock(texels, count);
+  }
+  ptr -= 4;
+  for (int i = 0; i < 4; ++i) {
+    ptr[i] = static_cast<uint8_t>(state >> (i * 8));
+  }
+  auto const ransSize = static_cast<size_t>(rans.data() + rans.size() - ptr);
+
+  std::vector<uint8_t> out;
+  out.push_back(kBlockRans);
+  auto const symbolsCount = std::count_if(stats.m_freqs.begin(),
+                                          stats.m_freqs.end(),
+                                          [](uint32_t f) { return f != 0; });
+  putU16(out, static_cast<uint16_t>(symbolsCount));
+  for (size_t i = 0; i < 256; ++i) {
+    if (stats.m_freqs[i] != 0) {
+      out.push_back(static_cast<uint8_t>(i));
+      putU16(out, static_cast<uint16_t>(stats.m_freqs[i]));
+    }
+  }
+  putU32(out, static_cast<uint32_t>(ransSize));
+  out.insert(out.end(), ptr, ptr + ransSize);
+
+  // Noise-like data doesn't compress, keep it as is.
+  if (out.size() >= count + 1) {
+    return encodeRawBlock(texels, count);
+  }
+  return out;
+}
+
+bool decodeBlock(uint8_t const * data, size_t size, uint32_t width, uint32_t rows, uint8_t * texels) {
+  auto const count = static_cast<size_t>(width) * rows;
+  if (size < 1) {
+    return false;
+  }
+  if (data[0] == kBlockRaw) {
+    if (size != count + 1) {
+      return false;
+    }
+    memcpy(texels, data + 1, count);
+    return true;
+  }
+  if (data[0] != kBlockRans || size < 3) {
+    return false;
+  }
+
+  auto const symbolsCount = getU16(data + 1);
+  size_t offset = 3;
+  if (symbolsCount == 0 || symbolsCount > 256 || size < offset + symbolsCount * 3 + 4) {
+    return false;
+  }
+  SymbolStats stats;
+  for (uint32_t i = 0; i < symbolsCount; ++i, offset += 3) {
+    stats.m_freqs[data[offset]] = getU16(data + offset + 1);
+  }
+  stats.m_starts[0] = 0;
+  for (size_t i = 0; i < 256; ++i) {
+    stats.m_starts[i + 1] = stats.m_starts[i] + stats.m_freqs[i];
+  }
+  if (stats.m_starts[256] != kProbScale) {
+    return false;
+  }
+  std::array<uint8_t, kProbScale> slotToSymbol;
+  for (size_t i = 0; i < 256; ++i) {
+    std::fill(slotToSymbol.begin() + stats.m_starts[i],
+              slotToSymbol.begin() + stats.m_starts[i + 1],
+              static_cast<uint8_t>(i));
+  }
+
+  auto const ransSize = getU32(data + offset);
+  offset += 4;
+  if (ransSize < 4 || size != offset + ransSize) {
+    return false;
+  }
+  auto ptr = data + offset;
+  auto const end = ptr + ransSize;
+  uint32_t state = getU32(ptr);
+  ptr += 4;
+
+  for (uint32_t y = 0; y < rows; ++y) {
+    auto const row = texels + static_cast<size_t>(y) * width;
+    auto const upRow = y > 0 ? row - width : nullptr;
+    for (uint32_t x = 0; x < width; ++x) {
+      auto const slot = state & (kProbScale - 1);
+      auto const s = slotToSymbol[slot];
+      state = stats.m_freqs[s] * (state >> kProbBits) + slot - stats.m_starts[s];
+      while (state < kRansLowerBound) {
+        if (ptr == end) {
+          return false;
+        }
+        state = (state << 8) | *ptr++;
+      }
+      row[x] = static_cast<uint8_t>(predict(row, upRow, x) + fromSymbol(s));
+    }
+  }
+  return true;
+}
+}  // namespace
+
+// static
+std::vector<uint8_t> AtlasCodec::encode(uint8_t const * texels,
+                                        glm::uvec2 const & size,
+                                        uint32_t threadsCount /* = 0 */) {
+  auto const blocksCount = (size.y + kRowsPerBlock - 1) / kRowsPerBlock;
+  std::vector<std::vector<uint8_t>> blocks(blocksCount);
+  parallelFor(blocksCount, threadsCount, [&](size_t i) {
+    auto const y = static_cast<uint32_t>(i) * kRowsPerBlock;
+    blocks[i] = encodeBlock(texels + static_cast<size_t>(y) * size.x,
+                            size.x,
+                            std::min(kRowsPerBlock, size.y - y));
+  });
+
+  // Layout: header, offsets of blocks (blocksCount + 1), blocks.
+  CodecHeader header = {kCodecMagic, kCodecVersion, size.x, size.y, kRowsPerBlock, blocksCount};
+  std::vector<uint8_t> out(sizeof(header));
+  memcpy(out.data(), &header, sizeof(header));
+  uint32_t offset = 0;
+  for (auto const & block : blocks) {
+    putU32(out, offset);
+    offset += static_cast<uint32_t>(block.size());
+  }
+  putU32(out, offset);
+  for (auto const & block : blocks) {
+    out.insert(out.end(), block.begin(), block.end());
+  }
+  return out;
+}
+
+// static
+bool AtlasCodec::decode(uint8_t const * data,
+                        size_t dataSize,
+                        glm::uvec2 const & size,
+                        uint8_t * texels,
+                        uint32_t threadsCount /* = 0 */) {
+  CodecHeader header;
+  if (dataSize < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.m_magic != kCodecMagic || header.m_version != kCodecVersion ||
+      header.m_width != size.x || header.m_height != size.y || header.m_rowsPerBlock == 0 ||
+      header.m_blocksCount != (size.y + header.m_rowsPerBlock - 1) / header.m_rowsPerBlock) {
+    return false;
+  }
+  auto const tableSize = (static_cast<size_t>(header.m_blocksCount) + 1) * sizeof(uint32_t);
+  if (dataSize < sizeof(header) + tableSize) {
+    return false;
+  }
+  std::vector<uint32_t> offsets(header.m_blocksCount + 1);
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    offsets[i] = getU32(data + sizeof(header) + i * sizeof(uint32_t));
+  }
+  auto const blocksData = data + sizeof(header) + tableSize;
+  auto const blocksDataSize = dataSize - sizeof(header) - tableSize;
+  if (offsets.back() != blocksDataSize) {
+    return false;
+  }
+
+  std::atomic<bool> succeeded = true;
+  parallelFor(header.m_blocksCount, threadsCount, [&](size_t i) {
+    auto const y = static_cast<uint32_t>(i) * header.m_rowsPerBlock;
+    if (offsets[i] > offsets[i + 1] ||
+        !decodeBlock(blocksData + offsets[i],
+                     offsets[i + 1] - offsets[i],
+                     size.x,
+                     std::min(header.m_rowsPerBlock, size.y - y),
+                     texels + static_cast<size_t>(y) * size.x)) {
+      succeeded = false;
+    }
+  });
+  return succeeded;
+}
+
+}  // namespace sdf
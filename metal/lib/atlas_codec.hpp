@@ -0,0 +1,47 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/glm_math.hpp"
+
+namespace sdf {
+
+// Lossless codec for R8 atlas texels. SDF atlases are smooth gradients, so every
+// texel is predicted from its neighbours (LOCO-I median predictor) and the
+// residuals are entropy coded with a static rANS coder. The atlas is split into
+// independent bands of rows, which are encoded and decoded in parallel.
+class AtlasCodec {
+public:
+  static uint32_t constexpr kRowsPerBlock = 64;
+
+  // If `threadsCount` is 0, the number of hardware threads is used.
+  static std::vector<uint8_t> encode(uint8_t const * texels,
+                                     glm::uvec2 const & size,
+                                     uint32_t threadsCount = 0);
+
+  // Decodes into `texels` which must have room for size.x * size.y bytes.
+  // Returns false if the data is malformed or was encoded for a different size.
+  static bool decode(uint8_t const * data,
+                     size_t dataSize,
+                     glm::uvec2 const & size,
+                     uint8_t * texels,
+                     uint32_t threadsCount = 0);
+};
+
+}  // namespace sdf
@@ -0,0 +1,105 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "atlas_rebuilder.hpp"
+
+#include "common/utils.hpp"
+#include "glyph_texture.hpp"
+
+namespace sdf::gpu {
+
+AtlasRebuilder::AtlasRebuilder(MTL::Device * const device, MTL::Library * library)
+  : m_device(device), m_library(library) {
+  m_library->retain();
+  m_commandQueue = m_device->newCommandQueue();
+  m_commandQueue->setLabel(STR("Atlas Rebuild Command Queue"));
+  m_thread = std::thread([this]() { run(); });
+}
+
+AtlasRebuilder::~AtlasRebuilder() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_condition.notify_one();
+  m_thread.join();
+
+  m_commandQueue->release();
+  m_library->release();
+}
+
+void AtlasRebuilder::requestRebuild(BakeParams const & params, bool deterministic) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pendingParams = params;
+    m_pendingDeterministic = deterministic;
+  }
+  m_condition.notify_one();
+}
+
+std::shared_ptr<GlyphAtlas const> AtlasRebuilder::takeRebuiltAtlas() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return std::move(m_rebuiltAtlas);
+}
+
+bool AtlasRebuilder::isRebuilding() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_isRebuilding || m_pendingParams.has_value();
+}
+
+void AtlasRebuilder::run() {
+  while (true) {
+    BakeParams params;
+    bool deterministic = false;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_isStopping || m_pendingParams.has_value(); });
+      if (m_isStopping) {
+        return;
+      }
+      params = std::move(m_pendingParams.value());
+      deterministic = m_pendingDeterministic;
+      m_pendingParams.reset();
+      m_isRebuilding = true;
+    }
+
+    NS::AutoreleasePool * autoreleasePool = NS::AutoreleasePool::alloc()->init();
+    auto glyphSet = std::make_unique<GlyphSet const>(params.m_glyphs,
+                                                     params.m_atlasSize,
+                                                     params.m_fontSize,
+                                                     params.m_fontName,
+                                                     params.m_packingOrder,
+                                                     params.m_icons);
+    auto texture =
+      GlyphTexture::generate(m_device, m_commandQueue, m_library, *glyphSet, deterministic);
+    uint64_t checksum = 0;
+    if (texture != nullptr) {
+      auto const texels = GlyphTexture::readTexels(m_device, m_commandQueue, texture);
+      checksum =
+        computeAtlasChecksum(glyphSet->getGlyphs(), glyphSet->getAtlasSize(), texels.data());
+    }
+    autoreleasePool->release();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isRebuilding = false;
+    // A newer request supersedes this result.
+    if (texture != nullptr && !m_pendingParams.has_value()) {
+      m_rebuiltAtlas = std::make_shared<GlyphAtlas const>(std::move(glyphSet), texture, checksum);
+    } else if (texture != nullptr) {
+      texture->release();
+    }
+  }
+}
+
+}  // namespace sdf::gpu
@@ -0,0 +1,62 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "baked_atlas.hpp"
+#include "glyph_atlas.hpp"
+
+namespace sdf::gpu {
+
+// Builds glyph sets and their SDF textures on a background thread with its own
+// command queue, so font changes don't stall the render thread. Only the latest
+// request matters: requests made while a rebuild is running replace each other.
+class AtlasRebuilder {
+public:
+  AtlasRebuilder(MTL::Device * const device, MTL::Library * library);
+  ~AtlasRebuilder();
+
+  // See GlyphTexture::generate about `deterministic`.
+  void requestRebuild(BakeParams const & params, bool deterministic = false);
+
+  // Returns the rebuilt atlas once, nullptr if there is nothing new.
+  std::shared_ptr<GlyphAtlas const> takeRebuiltAtlas();
+
+  bool isRebuilding() const;
+
+private:
+  void run();
+
+  MTL::Device * const m_device;
+  MTL::Library * m_library = nullptr;
+  MTL::CommandQueue * m_commandQueue = nullptr;
+
+  std::thread m_thread;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::optional<BakeParams> m_pendingParams;
+  bool m_pendingDeterministic = false;
+  std::shared_ptr<GlyphAtlas const> m_rebuiltAtlas;
+  bool m_isRebuilding = false;
+  bool m_isStopping = false;
+};
+
+}  // namespace sdf::gpu
@@ -0,0 +1,194 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "baked_atlas.hpp"
+
+#include <cstring>
+
+#include "glyph_texture_cpu.hpp"
+
+namespace sdf {
+namespace {
+uint32_t constexpr kMetadataMagic = 0x53444642;  // 'SDFB'
+// 2: texel (0, 0) is solid (see GlyphSet).
+uint32_t constexpr kMetadataVersion = 2;
+uint32_t constexpr kMaxAtlasSize = 16384;
+// 2: packing order is always hashed.
+uint32_t constexpr kKeyVersion = 2;
+
+struct AtlasMetadataHeader {
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_glyphsCount;
+  uint32_t m_atlasWidth;
+  uint32_t m_atlasHeight;
+  uint32_t m_reserved;
+};
+
+uint64_t constexpr kHashBasis = 0xcbf29ce484222325ull;
+
+// FNV-1a, unlike std::hash it gives the same result in every process.
+void hashBytes(uint64_t & hash, void const * data, size_t size) {
+  auto const bytes = static_cast<uint8_t const *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+}
+}  // namespace
+
+uint64_t BakeParams::getKey() const {
+  uint64_t hash = kHashBasis;
+  hashBytes(hash, &kKeyVersion, sizeof(kKeyVersion));
+  hashBytes(hash, m_fontName.data(), m_fontName.size());
+  hashBytes(hash, &m_fontSize, sizeof(m_fontSize));
+  hashBytes(hash, &m_atlasSize, sizeof(m_atlasSize));
+  hashBytes(hash, m_glyphs.data(), m_glyphs.size() * sizeof(uint16_t));
+  auto const packingOrder = static_cast<uint32_t>(m_packingOrder);
+  hashBytes(hash, &packingOrder, sizeof(packingOrder));
+  for (auto const & icon : m_icons) {
+    hashBytes(hash, &icon.m_code, sizeof(icon.m_code));
+    hashBytes(hash, &icon.m_viewBoxSize.x, sizeof(icon.m_viewBoxSize.x));
+    hashBytes(hash, &icon.m_viewBoxSize.y, sizeof(icon.m_viewBoxSize.y));
+    // Counts separate paths of adjacent icons.
+    auto const commandsCount = static_cast<uint32_t>(icon.m_commands.size());
+    auto const pointsCount = static_cast<uint32_t>(icon.m_points.size());
+    hashBytes(hash, &commandsCount, sizeof(commandsCount));
+    hashBytes(hash, &pointsCount, sizeof(pointsCount));
+    hashBytes(hash, icon.m_commands.data(), icon.m_commands.size() * sizeof(icon.m_commands[0]));
+    for (auto const & p : icon.m_points) {
+      hashBytes(hash, &p.x, sizeof(p.x));
+      hashBytes(hash, &p.y, sizeof(p.y));
+    }
+  }
+  return hash;
+}
+
+// static
+BakedAtlas BakedAtlas::bake(BakeParams const & params, uint32_t threadsCount) {
+  GlyphSet glyphSet(params.m_glyphs,
+                    params.m_atlasSize,
+                    params.m_fontSize,
+                    params.m_fontName,
+                    params.m_packingOrder,
+                    params.m_icons);
+
+  BakedAtlas atlas;
+  atlas.m_texels = cpu::GlyphTexture::generate(glyphSet, threadsCount);
+  atlas.m_atlasSize = glyphSet.getAtlasSize();
+  atlas.m_glyphs = glyphSet.getGlyphs();
+  // Outlines are only needed for generation.
+  for (auto & [_, glyphData] : atlas.m_glyphs) {
+    glyphData.m_lines = {};
+    glyphData.m_segments = {};
+  }
+  atlas.m_checksum =
+    computeAtlasChecksum(atlas.m_glyphs, atlas.m_atlasSize, atlas.m_texels.data());
+  return atlas;
+}
+
+uint64_t computeAtlasChecksum(std::unordered_map<uint16_t, GlyphSet::GlyphData> const & glyphs,
+                              glm::uvec2 const & atlasSize,
+                              uint8_t const * texels) {
+  uint64_t hash = kHashBasis;
+  hashBytes(hash, &atlasSize.x, sizeof(atlasSize.x));
+  hashBytes(hash, &atlasSize.y, sizeof(atlasSize.y));
+  for (auto code : GlyphSet::getSortedCodes(glyphs)) {
+    auto const r = BakedGlyphRecord::make(code, glyphs.at(code));
+    hashBytes(hash, &r, sizeof(r));
+  }
+  hashBytes(hash, texels, static_cast<size_t>(atlasSize.x) * atlasSize.y);
+  return hash;
+}
+
+// static
+BakedGlyphRecord BakedGlyphRecord::make(uint16_t code, GlyphSet::GlyphData const & glyphData) {
+  BakedGlyphRecord r = {};
+  r.m_code = code;
+  r.m_advance = glyphData.m_advance;
+  r.m_offset[0] = glyphData.m_offset.x;
+  r.m_offset[1] = glyphData.m_offset.y;
+  r.m_size[0] = glyphData.m_size.x;
+  r.m_size[1] = glyphData.m_size.y;
+  r.m_pixelSize[0] = glyphData.m_pixelSize.x;
+  r.m_pixelSize[1] = glyphData.m_pixelSize.y;
+  r.m_posInAtlas[0] = glyphData.m_posInAtlas.x;
+  r.m_posInAtlas[1] = glyphData.m_posInAtlas.y;
+  return r;
+}
+
+GlyphSet::GlyphData BakedGlyphRecord::toGlyphData() const {
+  GlyphSet::GlyphData glyphData;
+  glyphData.m_advance = m_advance;
+  glyphData.m_offset = glm::vec2{m_offset[0], m_offset[1]};
+  glyphData.m_size = glm::vec2{m_size[0], m_size[1]};
+  glyphData.m_pixelSize = glm::uvec2{m_pixelSize[0], m_pixelSize[1]};
+  glyphData.m_posInAtlas = glm::uvec2{m_posInAtlas[0], m_posInAtlas[1]};
+  return glyphData;
+}
+
+size_t getAtlasMetadataSize(size_t glyphsCount) {
+  return sizeof(AtlasMetadataHeader) + glyphsCount * sizeof(BakedGlyphRecord);
+}
+
+void writeAtlasMetadata(std::unordered_map<uint16_t, GlyphSet::GlyphData> const & glyphs,
+                        glm::uvec2 const & atlasSize,
+                        std::vector<uint8_t> & out) {
+  AtlasMetadataHeader header = {};
+  header.m_magic = kMetadataMagic;
+  header.m_version = kMetadataVersion;
+  header.m_glyphsCount = static_cast<uint32_t>(glyphs.size());
+  header.m_atlasWidth = atlasSize.x;
+  header.m_atlasHeight = atlasSize.y;
+
+  auto offset = out.size();
+  out.resize(offset + getAtlasMetadataSize(glyphs.size()));
+  memcpy(out.data() + offset, &header, sizeof(header));
+  offset += sizeof(header);
+  // Records are sorted, so equal atlases are serialized to equal bytes.
+  for (auto code : GlyphSet::getSortedCodes(glyphs)) {
+    auto const r = BakedGlyphRecord::make(code, glyphs.at(code));
+    memcpy(out.data() + offset, &r, sizeof(r));
+    offset += sizeof(r);
+  }
+}
+
+size_t readAtlasMetadata(uint8_t const * data, size_t size, BakedAtlas & atlas) {
+  AtlasMetadataHeader header;
+  if (size < sizeof(header)) {
+    return 0;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.m_magic != kMetadataMagic || header.m_version != kMetadataVersion ||
+      header.m_atlasWidth > kMaxAtlasSize || header.m_atlasHeight > kMaxAtlasSize) {
+    return 0;
+  }
+  auto const consumed = getAtlasMetadataSize(header.m_glyphsCount);
+  if (size < consumed) {
+    return 0;
+  }
+
+  atlas.m_glyphs.clear();
+  atlas.m_glyphs.reserve(header.m_glyphsCount);
+  for (uint32_t i = 0; i < header.m_glyphsCount; ++i) {
+    BakedGlyphRecord r;
+    memcpy(&r, data + sizeof(header) + i * sizeof(r), sizeof(r));
+    atlas.m_glyphs[r.m_code] = r.toGlyphData();
+  }
+  atlas.m_atlasSize = glm::uvec2{header.m_atlasWidth, header.m_atlasHeight};
+  atlas.m_texels.resize(static_cast<size_t>(header.m_atlasWidth) * header.m_atlasHeight);
+  return consumed;
+}
+
+}  // namespace sdf
@@ -0,0 +1,85 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glyph_set.hpp"
+
+namespace sdf {
+
+// Parameters which fully define a baked atlas.
+struct BakeParams {
+  std::string m_fontName = GlyphSet::kDefaultFontName;
+  uint32_t m_fontSize = 48;
+  uint32_t m_atlasSize = 256;
+  std::vector<uint16_t> m_glyphs;
+  // With PackingOrder::AsGiven glyphs are packed in the order of m_glyphs.
+  GlyphSet::PackingOrder m_packingOrder = GlyphSet::PackingOrder::Sorted;
+  std::vector<GlyphSet::Icon> m_icons;
+
+  // Stable across processes and runs, so it can be used as a cache key.
+  uint64_t getKey() const;
+};
+
+// Glyph metrics and atlas texels (R8, tightly packed rows) of a baked glyph set.
+struct BakedAtlas {
+  std::unordered_map<uint16_t, GlyphSet::GlyphData> m_glyphs;
+  glm::uvec2 m_atlasSize = glm::uvec2{0, 0};
+  std::vector<uint8_t> m_texels;
+  uint64_t m_checksum = 0;
+
+  // Builds the glyph set and generates texels on CPU. The result is bit-identical
+  // for any number of threads.
+  static BakedAtlas bake(BakeParams const & params, uint32_t threadsCount = 0);
+};
+
+// Plain-old-data glyph metrics used wherever baked glyphs leave the process
+// (shared memory, cache files, bake service).
+struct BakedGlyphRecord {
+  uint16_t m_code;
+  uint16_t m_reserved;
+  float m_advance;
+  float m_offset[2];
+  float m_size[2];
+  uint32_t m_pixelSize[2];
+  uint32_t m_posInAtlas[2];
+
+  static BakedGlyphRecord make(uint16_t code, GlyphSet::GlyphData const & glyphData);
+  GlyphSet::GlyphData toGlyphData() const;
+};
+
+// Checksum of glyph metrics and texels, it doesn't depend on the order of glyphs
+// in the map, so equal atlases have equal checksums in every process.
+uint64_t computeAtlasChecksum(std::unordered_map<uint16_t, GlyphSet::GlyphData> const & glyphs,
+                              glm::uvec2 const & atlasSize,
+                              uint8_t const * texels);
+
+// Size of the metadata written by writeAtlasMetadata for `glyphsCount` glyphs.
+size_t getAtlasMetadataSize(size_t glyphsCount);
+
+// Appends the metadata (header and glyph records, without texels) of an atlas.
+void writeAtlasMetadata(std::unordered_map<uint16_t, GlyphSet::GlyphData> const & glyphs,
+                        glm::uvec2 const & atlasSize,
+                        std::vector<uint8_t> & out);
+
+// Reads the metadata written by writeAtlasMetadata and resizes texels of the atlas
+// accordingly. Returns the number of consumed bytes or 0 if the data is malformed.
+size_t readAtlasMetadata(uint8_t const * data, size_t size, BakedAtlas & atlas);
+
+}  // namespace sdf
@@ -0,0 +1,181 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "coverage_atlas.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sdf {
+namespace {
+// Accumulates signed area covered by a line (non-zero fill rule). Coverage of
+// a pixel is the prefix sum of the accumulation buffer along its row.
+void accumulateLine(glm::vec2 p0, glm::vec2 p1, uint32_t width, uint32_t height, float * acc) {
+  if (p0.y == p1.y) {
+    return;
+  }
+  float dir = 1.0f;
+  if (p0.y > p1.y) {
+    std::swap(p0, p1);
+    dir = -1.0f;
+  }
+  auto const dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+  auto x = p0.x;
+  if (p0.y < 0.0f) {
+    x -= p0.y * dxdy;
+  }
+  auto const yBegin = static_cast<uint32_t>(std::max(p0.y, 0.0f));
+  auto const yEnd = std::min(height, static_cast<uint32_t>(std::max(std::ceil(p1.y), 0.0f)));
+  for (uint32_t y = yBegin; y < yEnd; ++y) {
+    auto const row = acc + static_cast<size_t>(y) * width;
+    auto const dy = std::min(static_cast<float>(y + 1), p1.y) - std::max(static_cast<float>(y), p0.y);
+    auto const xNext = x + dxdy * dy;
+    auto const d = dy * dir;
+    auto const x0 = std::min(x, xNext);
+    auto const x1 = std::max(x, xNext);
+    auto const x0Floor = std::floor(x0);
+    auto const x0i = static_cast<int>(x0Floor);
+    auto const x1Ceil = std::ceil(x1);
+    auto const x1i = static_cast<int>(x1Ceil);
+    if (x1i <= x0i + 1) {
+      // The line stays within one pixel of the row.
+      auto const xm = 0.5f * (x + xNext) - x0Floor;
+      row[x0i] += d - d * xm;
+      row[x0i + 1] += d * xm;
+    } else {
+      auto const s = 1.0f / (x1 - x0);
+      auto const x0f = x0 - x0Floor;
+      auto const a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+      auto const x1f = x1 - x1Ceil + 1.0f;
+      auto const am = 0.5f * s * x1f * x1f;
+      row[x0i] += d * a0;
+      if (x1i == x0i + 2) {
+        row[x0i + 1] += d * (1.0f - a0 - am);
+      } else {
+        auto const a1 = s * (1.5f - x0f);
+        row[x0i + 1] += d * (a1 - a0);
+        for (int xi = x0i + 2; xi < x1i - 1; ++xi) {
+          row[xi] += d * s;
+        }
+        auto const a2 = a1 + static_cast<float>(x1i - x0i - 3) * s;
+        row[x1i - 1] += d * (1.0f - a2 - am);
+      }
+      row[x1i] += d * am;
+    }
+    x = xNext;
+  }
+}
+}  // namespace
+
+CoverageAtlas::CoverageAtlas(uint32_t atlasSize /* = 512 */)
+  : m_atlasSize(atlasSize), m_texels(static_cast<size_t>(atlasSize) * atlasSize, 0) {
+  // Packing starts from (1, 1), the corner texel is reserved as a solid one.
+  m_texels[0] = 255;
+}
+
+CoverageAtlas::Entry const * CoverageAtlas::getEntry(GlyphSet const & glyphSet,
+                                                     uint16_t code,
+                                                     uint32_t pixelSize,
+                                                     uint32_t subpixelPosition) {
+  Key const key{&glyphSet, code, pixelSize, subpixelPosition};
+  if (auto it = m_entries.find(key); it != m_entries.end()) {
+    return &it->second;
+  }
+  if (m_isFull) {
+    return nullptr;
+  }
+
+  auto const glyphIt = glyphSet.getGlyphs().find(code);
+  if (glyphIt == glyphSet.getGlyphs().end() || glyphIt->second.m_lines.empty()) {
+    return nullptr;
+  }
+  auto const & glyphData = glyphIt->second;
+
+  // Outlines are stored in pixels of the SDF glyph (base font size, y goes down,
+  // with a border), move them to the target size with the subpixel shift.
+  auto const scale = static_cast<float>(pixelSize) / static_cast<float>(glyphSet.getBaseFontSize());
+  auto const shift = static_cast<float>(subpixelPosition) / kSubpixelPositions;
+  auto const border = static_cast<float>(GlyphSet::kBorderInPixels);
+  auto const contentPixelSize = glm::vec2(glyphData.m_pixelSize) - glm::vec2(2.0f * border);
+  auto const outlineScale = contentPixelSize / glyphData.m_size;
+
+  // One pixel margin on each side keeps antialiased edges (and the accumulation
+  // of the rightmost pixel) inside the bitmap.
+  auto const minX = static_cast<int>(std::floor(glyphData.m_offset.x * scale + shift)) - 1;
+  auto const maxX =
+    static_cast<int>(std::ceil((glyphData.m_offset.x + glyphData.m_size.x) * scale + shift)) + 1;
+  auto const minY = static_cast<int>(std::floor(glyphData.m_offset.y * scale)) - 1;
+  auto const maxY =
+    static_cast<int>(std::ceil((glyphData.m_offset.y + glyphData.m_size.y) * scale)) + 1;
+  auto const width = static_cast<uint32_t>(maxX - minX);
+  auto const height = static_cast<uint32_t>(maxY - minY);
+
+  // Shelf packing, the same as for the SDF atlas.
+  if (m_cursor.x + width + 1 > m_atlasSize) {
+    m_cursor.x = 1;
+    m_cursor.y += m_shelfHeight + 1;
+    m_shelfHeight = 0;
+  }
+  if (width + 2 > m_atlasSize || m_cursor.y + height + 1 > m_atlasSize) {
+    m_isFull = true;
+    return nullptr;
+  }
+  auto const pos = m_cursor;
+  m_cursor.x += width + 1;
+  m_shelfHeight = std::max(m_shelfHeight, height);
+
+  auto toBitmap = [&](float x, float y) {
+    auto const fontX = (x - border) / outlineScale.x + glyphData.m_offset.x;
+    auto const fontY = (static_cast<float>(glyphData.m_pixelSize.y) - border - y) / outlineScale.y +
+                       glyphData.m_offset.y;
+    return glm::vec2(fontX * scale + shift - static_cast<float>(minX),
+                     static_cast<float>(maxY) - fontY * scale);
+  };
+
+  std::vector<float> acc(static_cast<size_t>(width) * height + 1, 0.0f);
+  for (auto const & l : glyphData.m_lines) {
+    accumulateLine(toBitmap(l.x, l.y), toBitmap(l.z, l.w), width, height, acc.data());
+  }
+
+  for (uint32_t j = 0; j < height; ++j) {
+    auto const accRow = acc.data() + static_cast<size_t>(j) * width;
+    auto const row = m_texels.data() + static_cast<size_t>(pos.y + j) * m_atlasSize + pos.x;
+    float coverage = 0.0f;
+    for (uint32_t i = 0; i < width; ++i) {
+      coverage += accRow[i];
+      row[i] = static_cast<uint8_t>(std::min(std::abs(coverage), 1.0f) * 255.0f + 0.5f);
+    }
+  }
+
+  m_dirtyRegions.push_back(Region{.m_pos = pos, .m_size = glm::uvec2{width, height}});
+
+  Entry entry;
+  entry.m_posInAtlas = pos;
+  entry.m_size = glm::uvec2{width, height};
+  entry.m_origin = glm::ivec2{minX, minY};
+  return &m_entries.emplace(key, entry).first->second;
+}
+
+void CoverageAtlas::reset() {
+  m_entries.clear();
+  std::fill(m_texels.begin(), m_texels.end(), 0);
+  m_texels[0] = 255;
+  m_cursor = glm::uvec2{1, 1};
+  m_shelfHeight = 0;
+  m_isFull = false;
+  m_dirtyRegions.assign(1, Region{.m_pos = glm::uvec2{0, 0}, .m_size = getAtlasSize()});
+}
+
+}  // namespace sdf
@@ -0,0 +1,85 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "common/glm_math.hpp"
+#include "glyph_set.hpp"
+
+namespace sdf {
+
+// Atlas of coverage bitmaps rasterized on CPU from glyph outlines for a specific
+// pixel size and subpixel offset. Tiny text looks sharper with such bitmaps than
+// with SDF, and they are cheaper to draw (one unfiltered sample per fragment).
+class CoverageAtlas {
+public:
+  static uint32_t constexpr kSubpixelPositions = 4;
+
+  struct Entry {
+    glm::uvec2 m_posInAtlas;
+    glm::uvec2 m_size;
+    // Left-bottom corner of the bitmap relative to the pen position (y goes up).
+    glm::ivec2 m_origin;
+  };
+
+  explicit CoverageAtlas(uint32_t atlasSize = 512);
+
+  // Returns the bitmap of a glyph, it is rasterized on the first request.
+  // Returns nullptr if the glyph has no outline (e.g. a space or a prebaked
+  // glyph set) or there is no space left in the atlas.
+  Entry const * getEntry(GlyphSet const & glyphSet,
+                         uint16_t code,
+                         uint32_t pixelSize,
+                         uint32_t subpixelPosition);
+
+  // Set once a bitmap didn't fit, the atlas must be reset to accept new glyphs.
+  bool isFull() const { return m_isFull; }
+  void reset();
+
+  glm::uvec2 getAtlasSize() const { return glm::uvec2{m_atlasSize, m_atlasSize}; }
+  // Texture coordinates of a fully covered texel, used to draw solid shapes.
+  glm::vec2 getSolidTexelUv() const { return glm::vec2(0.5f / static_cast<float>(m_atlasSize)); }
+  std::vector<uint8_t> const & getTexels() const { return m_texels; }
+
+  struct Region {
+    glm::uvec2 m_pos;
+    glm::uvec2 m_size;
+  };
+  // Bitmaps added since the last call of clearDirtyRegions (the whole atlas after
+  // reset). New bitmaps never overlap texels of the existing ones, so uploading
+  // only them never touches texels which frames in flight may sample.
+  std::vector<Region> const & getDirtyRegions() const { return m_dirtyRegions; }
+  void clearDirtyRegions() { m_dirtyRegions.clear(); }
+
+private:
+  using Key = std::tuple<GlyphSet const *, uint16_t, uint32_t, uint32_t>;
+
+  uint32_t const m_atlasSize;
+  std::vector<uint8_t> m_texels;
+  std::map<Key, Entry> m_entries;
+
+  // Shelf packing.
+  glm::uvec2 m_cursor = glm::uvec2{1, 1};
+  uint32_t m_shelfHeight = 0;
+  bool m_isFull = false;
+
+  std::vector<Region> m_dirtyRegions;
+};
+
+}  // namespace sdf
@@ -0,0 +1,289 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "editable_text.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "common/utils.hpp"
+#include "text_pipeline.hpp"
+
+namespace sdf::gpu {
+
+uint32_t constexpr kMinBufferCapacity = 64;
+
+EditableText::EditableText(float pixelSize /* = 24.0f */, float lineSpacing /* = 1.25f */)
+  : m_pixelSize(pixelSize), m_lineHeight(std::ceil(pixelSize * lineSpacing)) {}
+
+EditableText::~EditableText() {
+  for (auto & frameBuffer : m_frameBuffers) {
+    if (frameBuffer.m_buffer) {
+      frameBuffer.m_buffer->release();
+    }
+  }
+
+  if (m_pipelineState) {
+    m_pipelineState->release();
+  }
+}
+
+bool EditableText::initialize(MTL::Device * const device,
+                              MTL::Library * library,
+                              uint32_t maxFramesInFlight /* = 3 */) {
+  m_frameBuffers.resize(maxFramesInFlight);
+
+  // Initialize shaders.
+  MTL::FunctionConstantValues * constantValues = MTL::FunctionConstantValues::alloc()->init();
+  METAL_GUARD(constantValues);
+
+  NS::Error * error = nullptr;
+  MTL::Function * vsFunction = library->newFunction(STR("vertexText"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(vsFunction);
+
+  MTL::Function * fsFunction = library->newFunction(STR("fragmentText"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(fsFunction);
+
+  // Initialize pipeline state.
+  m_pipelineState = createTextPipelineState(device,
+                                            vsFunction,
+                                            fsFunction,
+                                            STR("Editable Text Render Pipeline State"),
+                                            false /* premultipliedAlpha */,
+                                            &error);
+  CHECK_AND_RETURN(error, false);
+
+  return true;
+}
+
+void EditableText::setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas) {
+  m_glyphAtlas = std::move(glyphAtlas);
+  layoutGlyphs(0, m_glyphs.size());
+  markDirty(0, m_glyphs.size());
+}
+
+void EditableText::setText(std::string_view s) {
+  m_text.assign(s);
+  m_glyphs.resize(m_text.size());
+  m_pens.resize(m_text.size() + 1);
+  layoutGlyphs(0, m_glyphs.size());
+  markDirty(0, m_glyphs.size());
+}
+
+void EditableText::setColor(glm::vec4 const & color) {
+  m_color = color;
+  for (auto & g : m_glyphs) {
+    g.color = make_packed_float4(color);
+  }
+  markDirty(0, m_glyphs.size());
+}
+
+void EditableText::replace(size_t pos, size_t count, std::string_view s) {
+  pos = std::min(pos, m_text.size());
+  count = std::min(count, m_text.size() - pos);
+
+  // Chars which the replacement doesn't change keep their instances.
+  while (count > 0 && !s.empty() && m_text[pos] == s.front()) {
+    pos++;
+    count--;
+    s.remove_prefix(1);
+  }
+  while (count > 0 && !s.empty() && m_text[pos + count - 1] == s.back()) {
+    count--;
+    s.remove_suffix(1);
+  }
+  if (count == 0 && s.empty()) {
+    return;
+  }
+
+  auto const oldEnd = pos + count;
+  auto const newEnd = pos + s.size();
+  auto const oldPenEnd = m_pens[oldEnd];
+  m_text.replace(pos, count, s);
+  if (newEnd > oldEnd) {
+    m_glyphs.insert(m_glyphs.begin() + oldEnd, newEnd - oldEnd, Glyph{});
+    m_pens.insert(m_pens.begin() + oldEnd + 1, newEnd - oldEnd, glm::vec2(0.0f, 0.0f));
+  } else if (newEnd < oldEnd) {
+    m_glyphs.erase(m_glyphs.begin() + newEnd, m_glyphs.begin() + oldEnd);
+    m_pens.erase(m_pens.begin() + newEnd + 1, m_pens.begin() + oldEnd + 1);
+  }
+  layoutGlyphs(pos, newEnd);
+
+  // The rest of the line moves with the pen, the following lines move only vertically.
+  auto const offset = m_pens[newEnd] - oldPenEnd;
+  auto const lineEnd = std::min(m_text.find('\n', newEnd), m_text.size());
+  auto const sameLineEnd = std::min(lineEnd + 1, m_text.size());
+  if (offset.x != 0.0f || offset.y != 0.0f) {
+    // The pen after '\n' starts a new line, so it moves only vertically too.
+    shiftGlyphs(newEnd, sameLineEnd, offset);
+    shiftPens(newEnd + 1, lineEnd + 1, offset);
+    if (offset.y != 0.0f && lineEnd < m_text.size()) {
+      shiftGlyphs(lineEnd + 1, m_glyphs.size(), glm::vec2(0.0f, offset.y));
+      shiftPens(lineEnd + 1, m_pens.size(), glm::vec2(0.0f, offset.y));
+    }
+  }
+
+  // Instances after the edit are moved in the buffer if the length changes.
+  size_t dirtyEnd = newEnd;
+  if (newEnd != oldEnd || offset.y != 0.0f) {
+    dirtyEnd = m_glyphs.size();
+  } else if (offset.x != 0.0f) {
+    dirtyEnd = sameLineEnd;
+  }
+  markDirty(pos, dirtyEnd);
+}
+
+void EditableText::layoutGlyphs(size_t begin, size_t end) {
+  if (m_glyphAtlas == nullptr) {
+    return;
+  }
+  auto const & glyphSet = m_glyphAtlas->getGlyphSet();
+  auto const & glyphs = glyphSet.getGlyphs();
+  auto const scale = m_pixelSize / static_cast<float>(glyphSet.getBaseFontSize());
+  auto const atlasSize = glm::vec2(glyphSet.getAtlasSize());
+  auto const border = glm::vec2(GlyphSet::kBorderInPixels, GlyphSet::kBorderInPixels) / atlasSize;
+
+  // The same placement as in TextRenderer::addText, with a fixed scale.
+  for (auto i = begin; i < end; ++i) {
+    auto const pen = m_pens[i];
+    if (m_text[i] == '\n') {
+      m_glyphs[i] = Glyph{
+        .center = make_packed_float2(pen),
+        .halfSize = make_packed_float2(glm::vec2(0.0f, 0.0f)),
+        .uvCenter = make_packed_float2(glm::vec2(0.0f, 0.0f)),
+        .uvHalfSize = make_packed_float2(glm::vec2(0.0f, 0.0f)),
+        .color = make_packed_float4(m_color),
+      };
+      m_pens[i + 1] = glm::vec2(0.0f, pen.y - m_lineHeight);
+      continue;
+    }
+
+    auto it = glyphs.find(m_text[i]);
+    if (it == glyphs.end()) {
+      it = glyphs.find(' ');
+      METAL_ASSERT(it != glyphs.end());
+    }
+    auto const & glyphData = it->second;
+    auto const halfSize = glyphData.m_size * 0.5f;
+    auto const uvHalfSize = glm::vec2(glyphData.m_pixelSize) * 0.5f / atlasSize;
+    m_glyphs[i] = Glyph{
+      .center = make_packed_float2(pen + (glyphData.m_offset + halfSize) * scale),
+      .halfSize = make_packed_float2(halfSize * scale),
+      .uvCenter = make_packed_float2(glm::vec2(glyphData.m_posInAtlas) / atlasSize + uvHalfSize),
+      .uvHalfSize = make_packed_float2(uvHalfSize - border),
+      .color = make_packed_float4(m_color),
+    };
+    m_pens[i + 1] = pen + glm::vec2(glyphData.m_advance * scale, 0.0f);
+  }
+}
+
+void EditableText::shiftGlyphs(size_t begin, size_t end, glm::vec2 const & offset) {
+  // Plain loops over contiguous ranges, the compiler vectorizes them.
+  for (auto i = begin; i < end; ++i) {
+    m_glyphs[i].center.x += offset.x;
+    m_glyphs[i].center.y += offset.y;
+  }
+}
+
+void EditableText::shiftPens(size_t begin, size_t end, glm::vec2 const & offset) {
+  for (auto i = begin; i < end; ++i) {
+    m_pens[i] += offset;
+  }
+}
+
+void EditableText::markDirty(size_t begin, size_t end) {
+  if (begin >= end) {
+    return;
+  }
+  for (auto & frameBuffer : m_frameBuffers) {
+    if (frameBuffer.m_dirtyBegin >= frameBuffer.m_dirtyEnd) {
+      frameBuffer.m_dirtyBegin = begin;
+      frameBuffer.m_dirtyEnd = end;
+    } else {
+      frameBuffer.m_dirtyBegin = std::min(frameBuffer.m_dirtyBegin, begin);
+      frameBuffer.m_dirtyEnd = std::max(frameBuffer.m_dirtyEnd, end);
+    }
+  }
+}
+
+void EditableText::update(MTL::Device * const device) {
+  m_uploadedGlyphsCount = 0;
+  if (m_frameBuffers.empty()) {
+    return;
+  }
+  m_frameIndex++;
+  auto & frameBuffer = m_frameBuffers[m_frameIndex % m_frameBuffers.size()];
+
+  // Reallocate buffer.
+  if (frameBuffer.m_capacity < m_glyphs.size()) {
+    auto capacity = std::max(frameBuffer.m_capacity, static_cast<size_t>(kMinBufferCapacity));
+    while (capacity < m_glyphs.size()) {
+      capacity *= 2;
+    }
+    if (frameBuffer.m_buffer != nullptr) {
+      frameBuffer.m_buffer->release();
+    }
+    frameBuffer.m_buffer =
+      device->newBuffer(capacity * sizeof(Glyph), MTL::ResourceStorageModeShared);
+    frameBuffer.m_buffer->setLabel(STR("Editable Text Glyphs Buffer"));
+    frameBuffer.m_capacity = capacity;
+    frameBuffer.m_dirtyBegin = 0;
+    frameBuffer.m_dirtyEnd = m_glyphs.size();
+  }
+
+  // Shrinking leaves the dirty range past the end.
+  auto const dirtyEnd = std::min(frameBuffer.m_dirtyEnd, m_glyphs.size());
+  if (frameBuffer.m_dirtyBegin < dirtyEnd) {
+    auto const contentPtr = static_cast<Glyph *>(frameBuffer.m_buffer->contents());
+    memcpy(contentPtr + frameBuffer.m_dirtyBegin,
+           m_glyphs.data() + frameBuffer.m_dirtyBegin,
+           (dirtyEnd - frameBuffer.m_dirtyBegin) * sizeof(Glyph));
+    m_uploadedGlyphsCount = dirtyEnd - frameBuffer.m_dirtyBegin;
+  }
+  frameBuffer.m_dirtyBegin = 0;
+  frameBuffer.m_dirtyEnd = 0;
+}
+
+void EditableText::render(glm::vec2 const & screenSize,
+                          MTL::RenderCommandEncoder * commandEncoder) {
+  if (m_glyphs.empty() || m_glyphAtlas == nullptr || m_frameBuffers.empty()) {
+    return;
+  }
+  auto const & frameBuffer = m_frameBuffers[m_frameIndex % m_frameBuffers.size()];
+  if (frameBuffer.m_buffer == nullptr) {
+    return;
+  }
+
+  // Instances are relative to the origin, it's applied by the projection.
+  FrameData frameData;
+  auto const m = glm::ortho(-m_origin.x,
+                            screenSize.x - m_origin.x,
+                            -m_origin.y,
+                            screenSize.y - m_origin.y);
+  memcpy(&frameData.projection, glm::value_ptr(m), sizeof(m));
+
+  commandEncoder->setRenderPipelineState(m_pipelineState);
+  commandEncoder->setVertexBytes(&frameData, sizeof(frameData), TextRenderBufferFrame);
+  commandEncoder->setVertexBuffer(frameBuffer.m_buffer, 0, TextRenderBufferGlyphs);
+  commandEncoder->setFragmentTexture(m_glyphAtlas->getTexture(), TextRenderTextureGlyphs);
+  commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
+                                 0 /* vertexStart */,
+                                 4 /* vertexCount */,
+                                 static_cast<uint32_t>(m_glyphs.size()));
+}
+
+}  // namespace sdf::gpu
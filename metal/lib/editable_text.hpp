@@ -0,0 +1,97 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "glyph_atlas.hpp"
+#include "sdf_text_types.h"
+
+namespace sdf::gpu {
+
+// Text which is edited in place, e.g. a text field. Instances persist between
+// frames: an edit lays out only the replaced chars, the rest of the line and
+// the following lines are shifted, and only instances which changed are uploaded.
+// The font size is fixed, so an edit never rescales the whole text.
+class EditableText {
+public:
+  explicit EditableText(float pixelSize = 24.0f, float lineSpacing = 1.25f);
+  ~EditableText();
+
+  // Every frame in flight has its own instance buffer, so an upload never
+  // touches instances which GPU may still read.
+  bool initialize(MTL::Device * const device,
+                  MTL::Library * library,
+                  uint32_t maxFramesInFlight = 3);
+
+  // Lays out the whole text again.
+  void setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas);
+
+  // Lines are separated with '\n'.
+  void setText(std::string_view s);
+  void replace(size_t pos, size_t count, std::string_view s);
+  void insert(size_t pos, std::string_view s) { replace(pos, 0, s); }
+  void erase(size_t pos, size_t count) { replace(pos, count, std::string_view()); }
+  std::string const & getText() const { return m_text; }
+
+  void setColor(glm::vec4 const & color);
+  // Left end of the first baseline on the screen, in pixels. Moving is free.
+  void setOrigin(glm::vec2 const & origin) { m_origin = origin; }
+
+  // Number of instances uploaded by the last update.
+  size_t getUploadedGlyphsCount() const { return m_uploadedGlyphsCount; }
+  size_t getGlyphsCount() const { return m_glyphs.size(); }
+
+  // Uploads changed instances to the buffer of the next frame.
+  void update(MTL::Device * const device);
+  void render(glm::vec2 const & screenSize, MTL::RenderCommandEncoder * commandEncoder);
+
+private:
+  struct FrameBuffer {
+    MTL::Buffer * m_buffer = nullptr;
+    size_t m_capacity = 0;
+    // Instances [begin; end) changed since this buffer was updated.
+    size_t m_dirtyBegin = 0;
+    size_t m_dirtyEnd = 0;
+  };
+
+  void layoutGlyphs(size_t begin, size_t end);
+  void shiftGlyphs(size_t begin, size_t end, glm::vec2 const & offset);
+  void shiftPens(size_t begin, size_t end, glm::vec2 const & offset);
+  void markDirty(size_t begin, size_t end);
+
+  float m_pixelSize;
+  float m_lineHeight;
+  glm::vec4 m_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec2 m_origin = glm::vec2(0.0f, 0.0f);
+  std::shared_ptr<GlyphAtlas const> m_glyphAtlas;
+
+  // One instance per char ('\n' gets an empty one), instances are relative to
+  // the origin. m_pens[i] is the pen position before char i.
+  std::string m_text;
+  std::vector<Glyph> m_glyphs;
+  std::vector<glm::vec2> m_pens = {glm::vec2(0.0f, 0.0f)};
+
+  MTL::RenderPipelineState * m_pipelineState = nullptr;
+  std::vector<FrameBuffer> m_frameBuffers;
+  size_t m_frameIndex = 0;
+  size_t m_uploadedGlyphsCount = 0;
+};
+
+}  // namespace sdf::gpu
@@ -0,0 +1,1272 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "font_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "glyph_segments.hpp"
+#include "parallel_for.hpp"
+
+namespace sdf {
+namespace {
+uint32_t constexpr kTagCollection = 0x74746366;  // 'ttcf'
+uint32_t constexpr kTagTrueType = 0x74727565;    // 'true'
+uint32_t constexpr kVersionTrueType = 0x00010000;
+uint32_t constexpr kTagOpenTypeCff = 0x4F54544F;  // 'OTTO'
+
+// Limits of work per glyph, see OutlineBudget.
+uint32_t constexpr kMaxCompositeDepth = 8;
+uint32_t constexpr kMaxCompositeComponents = 1024;
+// Contour ends are 16-bit.
+uint32_t constexpr kMaxOutlinePoints = 0xFFFF;
+uint32_t constexpr kMaxCharStringOperations = 1 << 16;
+// Type 2 charstring limits.
+uint32_t constexpr kMaxSubrDepth = 10;
+uint32_t constexpr kMaxCffStackSize = 48;
+
+// Simple glyph flags.
+uint8_t constexpr kOnCurvePoint = 0x01;
+uint8_t constexpr kXShortVector = 0x02;
+uint8_t constexpr kYShortVector = 0x04;
+uint8_t constexpr kRepeatFlag = 0x08;
+uint8_t constexpr kXIsSameOrPositive = 0x10;
+uint8_t constexpr kYIsSameOrPositive = 0x20;
+
+// Composite glyph flags.
+uint16_t constexpr kArg1And2AreWords = 0x0001;
+uint16_t constexpr kArgsAreXYValues = 0x0002;
+uint16_t constexpr kWeHaveAScale = 0x0008;
+uint16_t constexpr kMoreComponents = 0x0020;
+uint16_t constexpr kWeHaveAnXAndYScale = 0x0040;
+uint16_t constexpr kWeHaveATwoByTwo = 0x0080;
+
+// All values in font files are big-endian.
+uint16_t readU16(uint8_t const * p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+int16_t readI16(uint8_t const * p) { return static_cast<int16_t>(readU16(p)); }
+uint32_t readU32(uint8_t const * p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+float readF2Dot14(uint8_t const * p) { return static_cast<float>(readI16(p)) / 16384.0f; }
+uint32_t readOffset(uint8_t const * p, uint8_t offsetSize) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < offsetSize; ++i) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+bool isInside(size_t size, size_t offset, size_t count) {
+  return offset <= size && count <= size - offset;
+}
+
+template <typename GetPoint>
+void subdivideCurve(GetPoint const & getPoint, std::vector<glm::vec4> & lines) {
+  // The same subdivision as for CoreText paths in GlyphSet.
+  auto constexpr kMaxPointsNum = 50;
+  auto constexpr kTangentTolerance = 0.01f;
+  glm::vec2 prevPoint = getPoint(0.0f);
+  glm::vec2 prevTangentVec;
+  for (int i = 0; i < kMaxPointsNum; ++i) {
+    auto const t = static_cast<float>(i + 1) / kMaxPointsNum;
+    auto const currentPoint = getPoint(t);
+    if (currentPoint == prevPoint) {
+      continue;
+    }
+    auto const tangentVec = glm::normalize(currentPoint - prevPoint);
+    if (i == 0 || (i + 1 == kMaxPointsNum) ||
+        glm::dot(prevTangentVec, tangentVec) < (1.0f - kTangentTolerance)) {
+      lines.emplace_back(glm::vec4(prevPoint.x, prevPoint.y, currentPoint.x, currentPoint.y));
+      prevPoint = currentPoint;
+      prevTangentVec = tangentVec;
+    }
+  }
+}
+
+void subdivideQuadCurve(glm::vec2 const & p1,
+                        glm::vec2 const & p2,
+                        glm::vec2 const & p3,
+                        std::vector<glm::vec4> & lines) {
+  subdivideCurve(
+    [&](float t) {
+      auto const oneMinusT = 1.0f - t;
+      return p1 * (oneMinusT * oneMinusT) + p2 * (2.0f * oneMinusT * t) + p3 * (t * t);
+    },
+    lines);
+}
+
+void subdivideCubicCurve(glm::vec2 const & p1,
+                         glm::vec2 const & p2,
+                         glm::vec2 const & p3,
+                         glm::vec2 const & p4,
+                         std::vector<glm::vec4> & lines) {
+  subdivideCurve(
+    [&](float t) {
+      auto const oneMinusT = 1.0f - t;
+      return p1 * (oneMinusT * oneMinusT * oneMinusT) + p2 * (3.0f * oneMinusT * oneMinusT * t) +
+             p3 * (3.0f * oneMinusT * t * t) + p4 * (t * t * t);
+    },
+    lines);
+}
+
+// Operands of CFF DICT operators, two-byte operators are 1200 + the second byte.
+using CffDict = std::unordered_map<uint16_t, std::vector<double>>;
+
+bool parseCffDict(uint8_t const * data, size_t size, CffDict & dict) {
+  std::vector<double> operands;
+  size_t pos = 0;
+  while (pos < size) {
+    auto const b0 = data[pos++];
+    if (b0 <= 21) {
+      uint16_t op = b0;
+      if (b0 == 12) {
+        if (pos >= size) {
+          return false;
+        }
+        op = static_cast<uint16_t>(1200 + data[pos++]);
+      }
+      dict[op] = std::move(operands);
+      operands.clear();
+    } else if (b0 == 28) {
+      if (!isInside(size, pos, 2)) {
+        return false;
+      }
+      operands.push_back(readI16(data + pos));
+      pos += 2;
+    } else if (b0 == 29) {
+      if (!isInside(size, pos, 4)) {
+        return false;
+      }
+      operands.push_back(static_cast<int32_t>(readU32(data + pos)));
+      pos += 4;
+    } else if (b0 == 30) {
+      // Real number, nibbles until 0xF.
+      std::string number;
+      bool isEnd = false;
+      while (!isEnd && pos < size) {
+        auto const b = data[pos++];
+        for (auto const nibble : {b >> 4, b & 0xF}) {
+          if (nibble <= 9) {
+            number += static_cast<char>('0' + nibble);
+          } else if (nibble == 0xA) {
+            number += '.';
+          } else if (nibble == 0xB) {
+            number += 'E';
+          } else if (nibble == 0xC) {
+            number += "E-";
+          } else if (nibble == 0xE) {
+            number += '-';
+          } else if (nibble == 0xF) {
+            isEnd = true;
+            break;
+          }
+        }
+      }
+      operands.push_back(std::strtod(number.c_str(), nullptr));
+    } else if (b0 >= 32 && b0 <= 246) {
+      operands.push_back(b0 - 139);
+    } else if (b0 >= 247 && b0 <= 254) {
+      if (pos >= size) {
+        return false;
+      }
+      auto const value = (b0 - (b0 <= 250 ? 247 : 251)) * 256 + data[pos++] + 108;
+      operands.push_back(b0 <= 250 ? value : -value);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+// static
+std::unique_ptr<FontFile> FontFile::open(std::string const & path, uint32_t fontIndex) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return nullptr;
+  }
+  auto const mappingSize = static_cast<size_t>(st.st_size);
+  void * p = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::unique_ptr<FontFile> fontFile(new FontFile());
+  fontFile->m_path = path;
+  fontFile->m_mapping = p;
+  fontFile->m_mappingSize = mappingSize;
+  if (!fontFile->parse(fontIndex)) {
+    return nullptr;
+  }
+  return fontFile;
+}
+
+FontFile::~FontFile() {
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_mappingSize);
+  }
+}
+
+FontFile::Table FontFile::findTable(uint32_t tableOffset,
+                                    uint16_t tablesCount,
+                                    char const * tag) const {
+  auto const data = static_cast<uint8_t const *>(m_mapping);
+  for (uint16_t i = 0; i < tablesCount; ++i) {
+    auto const record = data + tableOffset + 12 + i * 16;
+    if (memcmp(record, tag, 4) != 0) {
+      continue;
+    }
+    auto const offset = readU32(record + 8);
+    auto const size = readU32(record + 12);
+    if (!isInside(m_mappingSize, offset, size)) {
+      return Table{};
+    }
+    return Table{data + offset, size};
+  }
+  return Table{};
+}
+
+bool FontFile::parse(uint32_t fontIndex) {
+  auto const data = static_cast<uint8_t const *>(m_mapping);
+  if (m_mappingSize < 12) {
+    return false;
+  }
+
+  // Table directory of the font, collections have several of them.
+  uint32_t tableOffset = 0;
+  if (readU32(data) == kTagCollection) {
+    auto const fontsCount = readU32(data + 8);
+    if (fontIndex >= fontsCount || !isInside(m_mappingSize, 12 + 4 * fontIndex, 4)) {
+      return false;
+    }
+    tableOffset = readU32(data + 12 + 4 * fontIndex);
+  } else if (fontIndex != 0) {
+    return false;
+  }
+  if (!isInside(m_mappingSize, tableOffset, 12)) {
+    return false;
+  }
+  auto const version = readU32(data + tableOffset);
+  if (version != kVersionTrueType && version != kTagTrueType && version != kTagOpenTypeCff) {
+    return false;
+  }
+  auto const tablesCount = readU16(data + tableOffset + 4);
+  if (!isInside(m_mappingSize, tableOffset + 12, tablesCount * 16)) {
+    return false;
+  }
+
+  auto const head = findTable(tableOffset, tablesCount, "head");
+  auto const maxp = findTable(tableOffset, tablesCount, "maxp");
+  auto const hhea = findTable(tableOffset, tablesCount, "hhea");
+  m_cmap = findTable(tableOffset, tablesCount, "cmap");
+  m_glyf = findTable(tableOffset, tablesCount, "glyf");
+  m_hmtx = findTable(tableOffset, tablesCount, "hmtx");
+  m_loca = findTable(tableOffset, tablesCount, "loca");
+  auto const isCff = version == kTagOpenTypeCff;
+  if (head.m_size < 54 || maxp.m_size < 6 || hhea.m_size < 36 || m_cmap.m_size < 4 ||
+      m_hmtx.m_data == nullptr ||
+      (!isCff && (m_glyf.m_data == nullptr || m_loca.m_data == nullptr))) {
+    return false;
+  }
+
+  m_unitsPerEm = readU16(head.m_data + 18);
+  m_isLongLoca = readI16(head.m_data + 50) != 0;
+  m_glyphsCount = readU16(maxp.m_data + 4);
+  m_horizontalMetricsCount = readU16(hhea.m_data + 34);
+  auto const locaEntrySize = m_isLongLoca ? 4u : 2u;
+  if (m_unitsPerEm == 0 || m_glyphsCount == 0 || m_horizontalMetricsCount == 0 ||
+      m_hmtx.m_size < m_horizontalMetricsCount * 4u ||
+      (!isCff && m_loca.m_size < (m_glyphsCount + 1u) * locaEntrySize)) {
+    return false;
+  }
+  if (isCff && !parseCff(findTable(tableOffset, tablesCount, "CFF "))) {
+    return false;
+  }
+
+  // Prefer full Unicode (format 12) over BMP-only (format 4) subtables.
+  auto const subtablesCount = readU16(m_cmap.m_data + 2);
+  if (!isInside(m_cmap.m_size, 4, subtablesCount * 8u)) {
+    return false;
+  }
+  int bestScore = 0;
+  for (uint16_t i = 0; i < subtablesCount; ++i) {
+    auto const record = m_cmap.m_data + 4 + i * 8;
+    auto const platformId = readU16(record);
+    auto const encodingId = readU16(record + 2);
+    auto const offset = readU32(record + 4);
+    if (!isInside(m_cmap.m_size, offset, 8)) {
+      continue;
+    }
+    auto const subtable = m_cmap.m_data + offset;
+    auto const format = readU16(subtable);
+    auto const isUnicode =
+      platformId == 0 || (platformId == 3 && (encodingId == 1 || encodingId == 10));
+    int score = 0;
+    size_t size = 0;
+    if (isUnicode && format == 12 && isInside(m_cmap.m_size, offset, 16)) {
+      score = 2;
+      size = readU32(subtable + 4);
+    } else if (isUnicode && format == 4) {
+      score = 1;
+      size = readU16(subtable + 2);
+    }
+    if (score > bestScore && isInside(m_cmap.m_size, offset, size)) {
+      bestScore = score;
+      m_cmapSubtable = Table{subtable, size};
+      m_cmapFormat = format;
+    }
+  }
+  return bestScore > 0;
+}
+
+bool FontFile::parseCff(Table const & cff) {
+  if (cff.m_size < 4) {
+    return false;
+  }
+  // Header, then Name, Top DICT, String and Global Subr INDEXes one after another.
+  auto const nameIndex = readCffIndex(cff, cff.m_data[2]);
+  if (nameIndex.m_data == nullptr) {
+    return false;
+  }
+  auto getEnd = [&](Table const & index) {
+    return static_cast<size_t>(index.m_data + index.m_size - cff.m_data);
+  };
+  auto const topDictIndex = readCffIndex(cff, getEnd(nameIndex));
+  if (topDictIndex.m_data == nullptr) {
+    return false;
+  }
+  auto const stringIndex = readCffIndex(cff, getEnd(topDictIndex));
+  if (stringIndex.m_data == nullptr) {
+    return false;
+  }
+  m_cffGlobalSubrs = readCffIndex(cff, getEnd(stringIndex));
+  auto const topDictData = getCffIndexObject(topDictIndex, 0);
+  CffDict topDict;
+  if (m_cffGlobalSubrs.m_data == nullptr || topDictData.m_data == nullptr ||
+      !parseCffDict(topDictData.m_data, topDictData.m_size, topDict)) {
+    return false;
+  }
+
+  // Only Type 2 charstrings are defined for OpenType.
+  auto const charStringType = topDict.find(1206);
+  if (charStringType != topDict.end() &&
+      (charStringType->second.size() != 1 || charStringType->second[0] != 2)) {
+    return false;
+  }
+  auto const charStrings = topDict.find(17);
+  if (charStrings == topDict.end() || charStrings->second.size() != 1 ||
+      charStrings->second[0] < 0) {
+    return false;
+  }
+  m_cffCharStrings = readCffIndex(cff, static_cast<size_t>(charStrings->second[0]));
+  if (m_cffCharStrings.m_data == nullptr) {
+    return false;
+  }
+
+  // Subrs of a Private DICT are at an offset from the DICT.
+  auto readLocalSubrs = [&](CffDict const & dict, Table & subrs) {
+    auto const privateDict = dict.find(18);
+    if (privateDict == dict.end()) {
+      subrs = Table{};
+      return true;
+    }
+    if (privateDict->second.size() != 2 || privateDict->second[0] < 0 ||
+        privateDict->second[1] < 0) {
+      return false;
+    }
+    auto const privateSize = static_cast<size_t>(privateDict->second[0]);
+    auto const privateOffset = static_cast<size_t>(privateDict->second[1]);
+    CffDict privateValues;
+    if (!isInside(cff.m_size, privateOffset, privateSize) ||
+        !parseCffDict(cff.m_data + privateOffset, privateSize, privateValues)) {
+      return false;
+    }
+    auto const subrsOffset = privateValues.find(19);
+    if (subrsOffset == privateValues.end()) {
+      subrs = Table{};
+      return true;
+    }
+    if (subrsOffset->second.size() != 1 || subrsOffset->second[0] < 0) {
+      return false;
+    }
+    subrs = readCffIndex(cff, privateOffset + static_cast<size_t>(subrsOffset->second[0]));
+    return subrs.m_data != nullptr;
+  };
+
+  // CID-keyed fonts select a font DICT with its own Private DICT per glyph.
+  auto const fdArray = topDict.find(1236);
+  auto const fdSelect = topDict.find(1237);
+  if (fdArray == topDict.end() || fdSelect == topDict.end()) {
+    m_cffLocalSubrs.resize(1);
+    return readLocalSubrs(topDict, m_cffLocalSubrs[0]);
+  }
+  if (fdArray->second.size() != 1 || fdArray->second[0] < 0 || fdSelect->second.size() != 1 ||
+      fdSelect->second[0] < 0) {
+    return false;
+  }
+  auto const fdArrayIndex = readCffIndex(cff, static_cast<size_t>(fdArray->second[0]));
+  if (fdArrayIndex.m_data == nullptr) {
+    return false;
+  }
+  m_cffLocalSubrs.resize(getCffIndexCount(fdArrayIndex));
+  for (uint32_t i = 0; i < m_cffLocalSubrs.size(); ++i) {
+    auto const fontDictData = getCffIndexObject(fdArrayIndex, i);
+    CffDict fontDict;
+    if (fontDictData.m_data == nullptr ||
+        !parseCffDict(fontDictData.m_data, fontDictData.m_size, fontDict) ||
+        !readLocalSubrs(fontDict, m_cffLocalSubrs[i])) {
+      return false;
+    }
+  }
+  auto const fdSelectOffset = static_cast<size_t>(fdSelect->second[0]);
+  if (!isInside(cff.m_size, fdSelectOffset, 1)) {
+    return false;
+  }
+  m_cffFdSelect = Table{cff.m_data + fdSelectOffset, cff.m_size - fdSelectOffset};
+  return true;
+}
+
+// static
+FontFile::Table FontFile::readCffIndex(Table const & cff, size_t offset) {
+  // Count, offset size, count + 1 offsets (1-based, from the byte before the data), data.
+  if (!isInside(cff.m_size, offset, 2)) {
+    return Table{};
+  }
+  auto const index = cff.m_data + offset;
+  uint32_t const count = readU16(index);
+  if (count == 0) {
+    return Table{index, 2};
+  }
+  if (!isInside(cff.m_size, offset, 3)) {
+    return Table{};
+  }
+  auto const offsetSize = index[2];
+  auto const headerSize = 3 + (count + 1) * static_cast<size_t>(offsetSize);
+  if (offsetSize < 1 || offsetSize > 4 || !isInside(cff.m_size, offset, headerSize)) {
+    return Table{};
+  }
+  auto const dataSize = readOffset(index + 3 + count * offsetSize, offsetSize);
+  if (dataSize < 1 || !isInside(cff.m_size, offset, headerSize + dataSize - 1)) {
+    return Table{};
+  }
+  return Table{index, headerSize + dataSize - 1};
+}
+
+// static
+uint32_t FontFile::getCffIndexCount(Table const & index) {
+  return index.m_data != nullptr ? readU16(index.m_data) : 0;
+}
+
+// static
+FontFile::Table FontFile::getCffIndexObject(Table const & index, uint32_t i) {
+  auto const count = getCffIndexCount(index);
+  if (i >= count) {
+    return Table{};
+  }
+  auto const offsetSize = index.m_data[2];
+  auto const dataStart = 3 + (count + 1) * static_cast<size_t>(offsetSize) - 1;
+  auto const begin = readOffset(index.m_data + 3 + i * offsetSize, offsetSize);
+  auto const end = readOffset(index.m_data + 3 + (i + 1) * offsetSize, offsetSize);
+  if (begin < 1 || end < begin || !isInside(index.m_size, dataStart + begin, end - begin)) {
+    return Table{};
+  }
+  return Table{index.m_data + dataStart + begin, end - begin};
+}
+
+uint16_t FontFile::getGlyphIndex(uint32_t codePoint) const {
+  auto const & t = m_cmapSubtable;
+  uint32_t glyphIndex = 0;
+  if (m_cmapFormat == 4) {
+    if (codePoint > 0xFFFF || t.m_size < 14) {
+      return 0;
+    }
+    uint32_t const segmentsCountX2 = readU16(t.m_data + 6);
+    auto const endCodes = 14u;
+    auto const startCodes = endCodes + segmentsCountX2 + 2;
+    auto const idDeltas = startCodes + segmentsCountX2;
+    auto const idRangeOffsets = idDeltas + segmentsCountX2;
+    if (!isInside(t.m_size, idRangeOffsets, segmentsCountX2)) {
+      return 0;
+    }
+    // The first segment which ends at or after the code point.
+    uint32_t low = 0;
+    uint32_t high = segmentsCountX2 / 2;
+    while (low < high) {
+      auto const mid = (low + high) / 2;
+      if (readU16(t.m_data + endCodes + mid * 2) < codePoint) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    if (low == segmentsCountX2 / 2 || readU16(t.m_data + startCodes + low * 2) > codePoint) {
+      return 0;
+    }
+    auto const idDelta = readU16(t.m_data + idDeltas + low * 2);
+    auto const idRangeOffsetPos = idRangeOffsets + low * 2;
+    auto const idRangeOffset = readU16(t.m_data + idRangeOffsetPos);
+    if (idRangeOffset == 0) {
+      glyphIndex = (codePoint + idDelta) & 0xFFFF;
+    } else {
+      auto const start = readU16(t.m_data + startCodes + low * 2);
+      auto const pos = idRangeOffsetPos + idRangeOffset + (codePoint - start) * 2;
+      if (!isInside(t.m_size, pos, 2)) {
+        return 0;
+      }
+      glyphIndex = readU16(t.m_data + pos);
+      if (glyphIndex != 0) {
+        glyphIndex = (glyphIndex + idDelta) & 0xFFFF;
+      }
+    }
+  } else if (m_cmapFormat == 12) {
+    auto const groupsCount = readU32(t.m_data + 12);
+    if (!isInside(t.m_size, 16, static_cast<size_t>(groupsCount) * 12)) {
+      return 0;
+    }
+    // The first group which ends at or after the code point.
+    uint32_t low = 0;
+    uint32_t high = groupsCount;
+    while (low < high) {
+      auto const mid = low + (high - low) / 2;
+      if (readU32(t.m_data + 16 + mid * 12 + 4) < codePoint) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    if (low == groupsCount) {
+      return 0;
+    }
+    auto const group = t.m_data + 16 + low * 12;
+    auto const start = readU32(group);
+    if (start > codePoint) {
+      return 0;
+    }
+    glyphIndex = readU32(group + 8) + (codePoint - start);
+  }
+  return glyphIndex < m_glyphsCount ? static_cast<uint16_t>(glyphIndex) : 0;
+}
+
+uint16_t FontFile::getAdvance(uint16_t glyphIndex) const {
+  // Glyphs after the last metric share its advance.
+  auto const index = std::min<uint32_t>(glyphIndex, m_horizontalMetricsCount - 1u);
+  return readU16(m_hmtx.m_data + index * 4);
+}
+
+bool FontFile::appendOutline(uint16_t glyphIndex,
+                             glm::vec4 const & transform,
+                             glm::vec2 const & offset,
+                             uint32_t depth,
+                             OutlineBudget & budget,
+                             Outline & outline) const {
+  if (glyphIndex >= m_glyphsCount || depth > kMaxCompositeDepth || budget.m_componentsLeft == 0) {
+    return false;
+  }
+  budget.m_componentsLeft--;
+  size_t begin = 0;
+  size_t end = 0;
+  if (m_isLongLoca) {
+    begin = readU32(m_loca.m_data + glyphIndex * 4);
+    end = readU32(m_loca.m_data + glyphIndex * 4 + 4);
+  } else {
+    begin = readU16(m_loca.m_data + glyphIndex * 2) * 2u;
+    end = readU16(m_loca.m_data + glyphIndex * 2 + 2) * 2u;
+  }
+  if (begin == end) {
+    // No outline, e.g. a space.
+    return true;
+  }
+  if (end < begin || !isInside(m_glyf.m_size, begin, end - begin) || end - begin < 10) {
+    return false;
+  }
+  auto const glyph = m_glyf.m_data + begin;
+  auto const size = end - begin;
+  auto const contoursCount = readI16(glyph);
+
+  auto transformPoint = [&](glm::vec2 const & p) {
+    return glm::vec2(transform.x * p.x + transform.z * p.y, transform.y * p.x + transform.w * p.y) +
+           offset;
+  };
+
+  if (contoursCount >= 0) {
+    size_t pos = 10;
+    if (!isInside(size, pos, contoursCount * 2u + 2u)) {
+      return false;
+    }
+    auto const firstPoint = outline.m_points.size();
+    uint32_t pointsCount = 0;
+    for (int16_t i = 0; i < contoursCount; ++i) {
+      auto const contourEnd = readU16(glyph + pos + i * 2);
+      if (contourEnd + 1u < pointsCount) {
+        return false;
+      }
+      pointsCount = contourEnd + 1u;
+      if (firstPoint + contourEnd > std::numeric_limits<uint16_t>::max()) {
+        return false;
+      }
+      outline.m_contourEnds.push_back(static_cast<uint16_t>(firstPoint + contourEnd));
+    }
+    if (pointsCount > budget.m_pointsLeft) {
+      return false;
+    }
+    budget.m_pointsLeft -= pointsCount;
+    pos += contoursCount * 2u;
+    auto const instructionsLength = readU16(glyph + pos);
+    pos += 2u + instructionsLength;
+
+    // Flags, then x and y deltas.
+    std::vector<uint8_t> flags(pointsCount);
+    for (uint32_t i = 0; i < pointsCount;) {
+      if (!isInside(size, pos, 1)) {
+        return false;
+      }
+      auto const flag = glyph[pos++];
+      uint32_t repeatsCount = 1;
+      if (flag & kRepeatFlag) {
+        if (!isInside(size, pos, 1)) {
+          return false;
+        }
+        repeatsCount += glyph[pos++];
+      }
+      for (; repeatsCount > 0 && i < pointsCount; --repeatsCount) {
+        flags[i++] = flag;
+      }
+    }
+    auto readCoordinates = [&](uint8_t shortFlag, uint8_t sameFlag, auto const & setCoordinate) {
+      int32_t value = 0;
+      for (uint32_t i = 0; i < pointsCount; ++i) {
+        if (flags[i] & shortFlag) {
+          if (!isInside(size, pos, 1)) {
+            return false;
+          }
+          auto const delta = static_cast<int32_t>(glyph[pos++]);
+          value += (flags[i] & sameFlag) ? delta : -delta;
+        } else if (!(flags[i] & sameFlag)) {
+          if (!isInside(size, pos, 2)) {
+            return false;
+          }
+          value += readI16(glyph + pos);
+          pos += 2;
+        }
+        setCoordinate(i, static_cast<float>(value));
+      }
+      return true;
+    };
+    std::vector<glm::vec2> points(pointsCount, glm::vec2(0.0f, 0.0f));
+    if (!readCoordinates(kXShortVector, kXIsSameOrPositive, [&](uint32_t i, float v) {
+          points[i].x = v;
+        })) {
+      return false;
+    }
+    if (!readCoordinates(kYShortVector, kYIsSameOrPositive, [&](uint32_t i, float v) {
+          points[i].y = v;
+        })) {
+      return false;
+    }
+    for (uint32_t i = 0; i < pointsCount; ++i) {
+      outline.m_points.push_back(transformPoint(points[i]));
+      outline.m_pointTypes.push_back((flags[i] & kOnCurvePoint) != 0 ? PointType::OnCurve
+                                                                     : PointType::Quadratic);
+    }
+    return true;
+  }
+
+  // Composite glyph, components are other glyphs placed with affine transforms.
+  size_t pos = 10;
+  uint16_t componentFlags = 0;
+  do {
+    if (!isInside(size, pos, 4)) {
+      return false;
+    }
+    componentFlags = readU16(glyph + pos);
+    auto const componentIndex = readU16(glyph + pos + 2);
+    pos += 4;
+
+    glm::vec2 componentOffset(0.0f, 0.0f);
+    if (componentFlags & kArg1And2AreWords) {
+      if (!isInside(size, pos, 4)) {
+        return false;
+      }
+      componentOffset = glm::vec2(readI16(glyph + pos), readI16(glyph + pos + 2));
+      pos += 4;
+    } else {
+      if (!isInside(size, pos, 2)) {
+        return false;
+      }
+      componentOffset =
+        glm::vec2(static_cast<int8_t>(glyph[pos]), static_cast<int8_t>(glyph[pos + 1]));
+      pos += 2;
+    }
+    // Components aligned by matching points are rare, they are placed without offset.
+    if (!(componentFlags & kArgsAreXYValues)) {
+      componentOffset = glm::vec2(0.0f, 0.0f);
+    }
+
+    glm::vec4 componentTransform(1.0f, 0.0f, 0.0f, 1.0f);
+    if (componentFlags & kWeHaveAScale) {
+      if (!isInside(size, pos, 2)) {
+        return false;
+      }
+      auto const scale = readF2Dot14(glyph + pos);
+      componentTransform = glm::vec4(scale, 0.0f, 0.0f, scale);
+      pos += 2;
+    } else if (componentFlags & kWeHaveAnXAndYScale) {
+      if (!isInside(size, pos, 4)) {
+        return false;
+      }
+      componentTransform =
+        glm::vec4(readF2Dot14(glyph + pos), 0.0f, 0.0f, readF2Dot14(glyph + pos + 2));
+      pos += 4;
+    } else if (componentFlags & kWeHaveATwoByTwo) {
+      if (!isInside(size, pos, 8)) {
+        return false;
+      }
+      componentTransform = glm::vec4(readF2Dot14(glyph + pos),
+                                     readF2Dot14(glyph + pos + 2),
+                                     readF2Dot14(glyph + pos + 4),
+                                     readF2Dot14(glyph + pos + 6));
+      pos += 8;
+    }
+
+    // Component points are transformed by the component first, then by this glyph.
+    glm::vec4 const t = transform;
+    glm::vec4 const c = componentTransform;
+    auto const combinedTransform = glm::vec4(t.x * c.x + t.z * c.y,
+                                             t.y * c.x + t.w * c.y,
+                                             t.x * c.z + t.z * c.w,
+                                             t.y * c.z + t.w * c.w);
+    if (!appendOutline(componentIndex,
+                       combinedTransform,
+                       transformPoint(componentOffset),
+                       depth + 1,
+                       budget,
+                       outline)) {
+      return false;
+    }
+  } while (componentFlags & kMoreComponents);
+  return true;
+}
+
+bool FontFile::appendCffOutline(uint16_t glyphIndex,
+                                OutlineBudget & budget,
+                                Outline & outline) const {
+  auto const charString = getCffIndexObject(m_cffCharStrings, glyphIndex);
+  if (charString.m_data == nullptr) {
+    return false;
+  }
+
+  // Local subroutines of the glyph's font DICT.
+  uint32_t fontDictIndex = 0;
+  if (m_cffFdSelect.m_data != nullptr) {
+    auto const & t = m_cffFdSelect;
+    auto const format = t.m_data[0];
+    if (format == 0 && isInside(t.m_size, 1u + glyphIndex, 1)) {
+      fontDictIndex = t.m_data[1 + glyphIndex];
+    } else if (format == 3 && isInside(t.m_size, 1, 2)) {
+      // Ranges of glyphs (first glyph, font DICT) followed by the sentinel glyph.
+      uint32_t const rangesCount = readU16(t.m_data + 1);
+      if (!isInside(t.m_size, 3, rangesCount * 3u + 2u)) {
+        return false;
+      }
+      uint32_t i = 0;
+      while (i < rangesCount && readU16(t.m_data + 3 + (i + 1) * 3) <= glyphIndex) {
+        ++i;
+      }
+      if (i == rangesCount || readU16(t.m_data + 3 + i * 3) > glyphIndex) {
+        return false;
+      }
+      fontDictIndex = t.m_data[3 + i * 3 + 2];
+    } else {
+      return false;
+    }
+  }
+  if (fontDictIndex >= m_cffLocalSubrs.size()) {
+    return false;
+  }
+  auto const & localSubrs = m_cffLocalSubrs[fontDictIndex];
+  auto getBias = [](uint32_t subrsCount) -> int32_t {
+    return subrsCount < 1240 ? 107 : (subrsCount < 33900 ? 1131 : 32768);
+  };
+  auto const localBias = getBias(getCffIndexCount(localSubrs));
+  auto const globalBias = getBias(getCffIndexCount(m_cffGlobalSubrs));
+
+  float stack[kMaxCffStackSize];
+  uint32_t stackSize = 0;
+  uint32_t stemsCount = 0;
+  // The first stack-clearing operator may take the advance width before its
+  // arguments, metrics are taken from hmtx instead.
+  bool isWidthParsed = false;
+  bool isEnded = false;
+
+  glm::vec2 pen(0.0f, 0.0f);
+  size_t contourBegin = 0;
+  bool isContourOpen = false;
+  auto closeContour = [&]() {
+    if (!isContourOpen) {
+      return;
+    }
+    // Contours are closed implicitly, the closing point is not repeated.
+    if (outline.m_points.size() - contourBegin > 1 &&
+        outline.m_points.back() == outline.m_points[contourBegin] &&
+        outline.m_pointTypes.back() == PointType::OnCurve) {
+      outline.m_points.pop_back();
+      outline.m_pointTypes.pop_back();
+    }
+    outline.m_contourEnds.push_back(static_cast<uint16_t>(outline.m_points.size() - 1));
+    isContourOpen = false;
+  };
+  auto addPoint = [&](float dx, float dy, PointType type) {
+    if (!isContourOpen || budget.m_pointsLeft == 0) {
+      return false;
+    }
+    budget.m_pointsLeft--;
+    pen += glm::vec2(dx, dy);
+    outline.m_points.push_back(pen);
+    outline.m_pointTypes.push_back(type);
+    return true;
+  };
+  auto moveTo = [&](float dx, float dy) {
+    closeContour();
+    contourBegin = outline.m_points.size();
+    isContourOpen = true;
+    return addPoint(dx, dy, PointType::OnCurve);
+  };
+  auto lineTo = [&](float dx, float dy) { return addPoint(dx, dy, PointType::OnCurve); };
+  auto curveTo = [&](float dxa, float dya, float dxb, float dyb, float dxc, float dyc) {
+    return addPoint(dxa, dya, PointType::Cubic) && addPoint(dxb, dyb, PointType::Cubic) &&
+           addPoint(dxc, dyc, PointType::OnCurve);
+  };
+  // Index of the first argument, skips the width if it's there.
+  auto getFirstArg = [&](bool hasWidth) -> uint32_t {
+    auto const first = (!isWidthParsed && hasWidth) ? 1u : 0u;
+    isWidthParsed = true;
+    return first;
+  };
+
+  auto run = [&](auto const & self, Table const & program, uint32_t depth) -> bool {
+    if (depth > kMaxSubrDepth) {
+      return false;
+    }
+    size_t pos = 0;
+    while (pos < program.m_size && !isEnded) {
+      if (budget.m_operationsLeft == 0) {
+        return false;
+      }
+      budget.m_operationsLeft--;
+
+      auto const b0 = program.m_data[pos++];
+      // Operands.
+      if (b0 == 28 || b0 >= 32) {
+        if (stackSize == kMaxCffStackSize) {
+          return false;
+        }
+        if (b0 == 28) {
+          if (!isInside(program.m_size, pos, 2)) {
+            return false;
+          }
+          stack[stackSize++] = readI16(program.m_data + pos);
+          pos += 2;
+        } else if (b0 <= 246) {
+          stack[stackSize++] = static_cast<float>(b0) - 139.0f;
+        } else if (b0 <= 254) {
+          if (!isInside(program.m_size, pos, 1)) {
+            return false;
+          }
+          auto const value = (b0 - (b0 <= 250 ? 247 : 251)) * 256 + program.m_data[pos++] + 108;
+          stack[stackSize++] = static_cast<float>(b0 <= 250 ? value : -value);
+        } else {
+          // 16.16 fixed point.
+          if (!isInside(program.m_size, pos, 4)) {
+            return false;
+          }
+          stack[stackSize++] = static_cast<int32_t>(readU32(program.m_data + pos)) / 65536.0f;
+          pos += 4;
+        }
+        continue;
+      }
+
+      // Operators, arguments are relative to the pen.
+      auto const op = b0 == 12 && pos < program.m_size ? 1200 + program.m_data[pos++] : b0;
+      auto const * a = stack;
+      switch (op) {
+      case 1:    // hstem
+      case 3:    // vstem
+      case 18:   // hstemhm
+      case 23: { // vstemhm
+        auto const first = getFirstArg(stackSize % 2 == 1);
+        stemsCount += (stackSize - first) / 2;
+        break;
+      }
+      case 19:   // hintmask
+      case 20: { // cntrmask
+        // Arguments are stems of an implicit vstem, the mask has a bit per stem.
+        auto const first = getFirstArg(stackSize % 2 == 1);
+        stemsCount += (stackSize - first) / 2;
+        pos += (stemsCount + 7) / 8;
+        if (pos > program.m_size) {
+          return false;
+        }
+        break;
+      }
+      case 21: { // rmoveto
+        auto const first = getFirstArg(stackSize > 2);
+        if (stackSize - first < 2 || !moveTo(a[first], a[first + 1])) {
+          return false;
+        }
+        break;
+      }
+      case 22:   // hmoveto
+      case 4: {  // vmoveto
+        auto const first = getFirstArg(stackSize > 1);
+        if (stackSize - first < 1) {
+          return false;
+        }
+        auto const d = a[first];
+        if (!(op == 22 ? moveTo(d, 0.0f) : moveTo(0.0f, d))) {
+          return false;
+        }
+        break;
+      }
+      case 5: { // rlineto
+        for (uint32_t i = 0; i + 2 <= stackSize; i += 2) {
+          if (!lineTo(a[i], a[i + 1])) {
+            return false;
+          }
+        }
+        break;
+      }
+      case 6:   // hlineto
+      case 7: { // vlineto
+        // Alternating horizontal and vertical lines.
+        bool isHorizontal = op == 6;
+        for (uint32_t i = 0; i < stackSize; ++i, isHorizontal = !isHorizontal) {
+          if (!(isHorizontal ? lineTo(a[i], 0.0f) : lineTo(0.0f, a[i]))) {
+            return false;
+          }
+        }
+        break;
+      }
+      case 8: { // rrcurveto
+        for (uint32_t i = 0; i + 6 <= stackSize; i += 6) {
+          if (!curveTo(a[i], a[i + 1], a[i + 2], a[i + 3], a[i + 4], a[i + 5])) {
+            return false;
+          }
+        }
+        break;
+      }
+      case 24: { // rcurveline
+        if (stackSize < 8) {
+          return false;
+        }
+        uint32_t i = 0;
+        for (; i + 8 <= stackSize; i += 6) {
+          if (!curveTo(a[i], a[i + 1], a[i + 2], a[i + 3], a[i + 4], a[i + 5])) {
+            return false;
+          }
+        }
+        if (!lineTo(a[i], a[i + 1])) {
+          return false;
+        }
+        break;
+      }
+      case 25: { // rlinecurve
+        if (stackSize < 8) {
+          return false;
+        }
+        uint32_t i = 0;
+        for (; i + 8 <= stackSize; i += 2) {
+          if (!lineTo(a[i], a[i + 1])) {
+            return false;
+          }
+        }
+        if (!curveTo(a[i], a[i + 1], a[i + 2], a[i + 3], a[i + 4], a[i + 5])) {
+          return false;
+        }
+        break;
+      }
+      case 26:   // vvcurveto
+      case 27: { // hhcurveto
+        // An odd argument is the first curve's offset across the direction.
+        uint32_t i = stackSize % 2;
+        float across = i == 1 ? a[0] : 0.0f;
+        for (; i + 4 <= stackSize; i += 4) {
+          auto const ok = op == 26 ? curveTo(across, a[i], a[i + 1], a[i + 2], 0.0f, a[i + 3])
+                                   : curveTo(a[i], across, a[i + 1], a[i + 2], a[i + 3], 0.0f);
+          if (!ok) {
+            return false;
+          }
+          across = 0.0f;
+        }
+        break;
+      }
+      case 30:   // vhcurveto
+      case 31: { // hvcurveto
+        // Curves alternate between starting horizontally and vertically, the last
+        // one may end with an extra offset across its end direction.
+        bool isHorizontal = op == 31;
+        for (uint32_t i = 0; i + 4 <= stackSize; i += 4, isHorizontal = !isHorizontal) {
+          auto const last = i + 5 == stackSize ? a[i + 4] : 0.0f;
+          auto const ok = isHorizontal
+                            ? curveTo(a[i], 0.0f, a[i + 1], a[i + 2], last, a[i + 3])
+                            : curveTo(0.0f, a[i], a[i + 1], a[i + 2], a[i + 3], last);
+          if (!ok) {
+            return false;
+          }
+        }
+        break;
+      }
+      case 10:   // callsubr
+      case 29: { // callgsubr
+        if (stackSize == 0) {
+          return false;
+        }
+        auto const & subrs = op == 10 ? localSubrs : m_cffGlobalSubrs;
+        auto const subrIndex =
+          static_cast<int32_t>(stack[--stackSize]) + (op == 10 ? localBias : globalBias);
+        auto const subr =
+          subrIndex >= 0 ? getCffIndexObject(subrs, static_cast<uint32_t>(subrIndex)) : Table{};
+        if (subr.m_data == nullptr || !self(self, subr, depth + 1)) {
+          return false;
+        }
+        // The stack is shared with the subroutine.
+        continue;
+      }
+      case 11: // return
+        return true;
+      case 14: { // endchar
+        // Arguments of the deprecated accented character form are not supported.
+        auto const first = getFirstArg(stackSize == 1 || stackSize == 5);
+        if (stackSize - first != 0) {
+          return false;
+        }
+        closeContour();
+        isEnded = true;
+        return true;
+      }
+      case 1235: { // flex
+        if (stackSize < 13) {
+          return false;
+        }
+        if (!curveTo(a[0], a[1], a[2], a[3], a[4], a[5]) ||
+            !curveTo(a[6], a[7], a[8], a[9], a[10], a[11])) {
+          return false;
+        }
+        break;
+      }
+      case 1234: { // hflex
+        if (stackSize < 7) {
+          return false;
+        }
+        if (!curveTo(a[0], 0.0f, a[1], a[2], a[3], 0.0f) ||
+            !curveTo(a[4], 0.0f, a[5], -a[2], a[6], 0.0f)) {
+          return false;
+        }
+        break;
+      }
+      case 1236: { // hflex1
+        if (stackSize < 9) {
+          return false;
+        }
+        if (!curveTo(a[0], a[1], a[2], a[3], a[4], 0.0f) ||
+            !curveTo(a[5], 0.0f, a[6], a[7], a[8], -(a[1] + a[3] + a[7]))) {
+          return false;
+        }
+        break;
+      }
+      case 1237: { // flex1
+        if (stackSize < 11) {
+          return false;
+        }
+        auto const dx = a[0] + a[2] + a[4] + a[6] + a[8];
+        auto const dy = a[1] + a[3] + a[5] + a[7] + a[9];
+        auto const isHorizontal = std::abs(dx) > std::abs(dy);
+        if (!curveTo(a[0], a[1], a[2], a[3], a[4], a[5]) ||
+            !curveTo(a[6],
+                     a[7],
+                     a[8],
+                     a[9],
+                     isHorizontal ? a[10] : -dx,
+                     isHorizontal ? -dy : a[10])) {
+          return false;
+        }
+        break;
+      }
+      default:
+        // Reserved and deprecated operators.
+        return false;
+      }
+      stackSize = 0;
+    }
+    // Only subroutines may end without endchar.
+    return isEnded || depth > 0;
+  };
+  return run(run, charString, 0);
+}
+
+std::optional<FontFile::Outline> FontFile::getOutline(uint16_t glyphIndex) const {
+  Outline outline;
+  OutlineBudget budget{kMaxCompositeComponents, kMaxOutlinePoints, kMaxCharStringOperations};
+  auto const isAppended =
+    m_cffCharStrings.m_data != nullptr
+      ? glyphIndex < m_glyphsCount && appendCffOutline(glyphIndex, budget, outline)
+      : appendOutline(glyphIndex,
+                      glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),
+                      glm::vec2(0.0f, 0.0f),
+                      0,
+                      budget,
+                      outline);
+  if (!isAppended) {
+    return std::nullopt;
+  }
+  if (!outline.m_points.empty()) {
+    outline.m_min = outline.m_points.front();
+    outline.m_max = outline.m_points.front();
+    for (auto const & p : outline.m_points) {
+      outline.m_min = glm::min(outline.m_min, p);
+      outline.m_max = glm::max(outline.m_max, p);
+    }
+  }
+  return outline;
+}
+
+GlyphSet::GlyphData FontFile::buildGlyphData(uint16_t code, uint32_t fontSize) const {
+  auto const scale = static_cast<float>(fontSize) / m_unitsPerEm;
+  auto const glyphIndex = getGlyphIndex(code);
+  auto const outline = getOutline(glyphIndex);
+
+  GlyphSet::GlyphData data;
+  data.m_advance = static_cast<float>(getAdvance(glyphIndex)) * scale;
+  data.m_offset = glm::vec2(0.0f, 0.0f);
+  data.m_size = glm::vec2(0.0f, 0.0f);
+  if (outline.has_value()) {
+    data.m_offset = outline->m_min * scale;
+    data.m_size = (outline->m_max - outline->m_min) * scale;
+  }
+  data.m_pixelSize = glm::uvec2{static_cast<uint32_t>(std::ceil(data.m_size.x)),
+                                static_cast<uint32_t>(std::ceil(data.m_size.y))};
+  auto const scaleX =
+    data.m_size.x > 0.0f ? static_cast<float>(data.m_pixelSize.x) / data.m_size.x : 1.0f;
+  auto const scaleY =
+    data.m_size.y > 0.0f ? static_cast<float>(data.m_pixelSize.y) / data.m_size.y : 1.0f;
+  data.m_pixelSize += 2 * GlyphSet::kBorderInPixels;
+  if (!outline.has_value() || outline->m_points.empty()) {
+    return data;
+  }
+
+  // The same transform to glyph pixel space (y goes down) as for CoreText paths.
+  auto const border = static_cast<float>(GlyphSet::kBorderInPixels);
+  auto toPixels = [&](glm::vec2 const & p) {
+    auto const height = static_cast<float>(data.m_pixelSize.y);
+    return glm::vec2((p.x * scale - data.m_offset.x) * scaleX + border,
+                     height - (p.y * scale - data.m_offset.y) * scaleY - border);
+  };
+
+  // Two quadratic control points in a row imply an on-curve point in the middle,
+  // cubic control points come in pairs.
+  size_t contourBegin = 0;
+  for (auto contourEnd : outline->m_contourEnds) {
+    auto const pointsCount = contourEnd + 1u - contourBegin;
+    if (contourEnd < contourBegin || pointsCount < 2) {
+      contourBegin = contourEnd + 1u;
+      continue;
+    }
+    size_t firstOnCurve = 0;
+    while (firstOnCurve < pointsCount &&
+           outline->m_pointTypes[contourBegin + firstOnCurve] != FontFile::PointType::OnCurve) {
+      firstOnCurve++;
+    }
+    auto const shift = firstOnCurve < pointsCount ? firstOnCurve : 0;
+    auto point = [&](size_t k) {
+      return toPixels(outline->m_points[contourBegin + (shift + k) % pointsCount]);
+    };
+    auto getPointType = [&](size_t k) {
+      return outline->m_pointTypes[contourBegin + (shift + k) % pointsCount];
+    };
+
+    auto const start = firstOnCurve < pointsCount ? point(0) : (point(0) + point(1)) * 0.5f;
+    auto pen = start;
+    std::optional<glm::vec2> control;
+    for (size_t k = 1; k <= pointsCount; ++k) {
+      auto const p = point(k);
+      auto const pointType = getPointType(k);
+      if (pointType == FontFile::PointType::Cubic) {
+        if (control.has_value() || k + 2 > pointsCount ||
+            getPointType(k + 1) != FontFile::PointType::Cubic ||
+            getPointType(k + 2) != FontFile::PointType::OnCurve) {
+          break;
+        }
+        subdivideCubicCurve(pen, p, point(k + 1), point(k + 2), data.m_lines);
+        pen = point(k + 2);
+        k += 2;
+      } else if (pointType == FontFile::PointType::OnCurve) {
+        if (control.has_value()) {
+          subdivideQuadCurve(pen, *control, p, data.m_lines);
+        } else if (p != pen) {
+          data.m_lines.emplace_back(glm::vec4(pen.x, pen.y, p.x, p.y));
+        }
+        pen = p;
+        control.reset();
+      } else if (control.has_value()) {
+        auto const middle = (*control + p) * 0.5f;
+        subdivideQuadCurve(pen, *control, middle, data.m_lines);
+        pen = middle;
+        control = p;
+      } else {
+        control = p;
+      }
+    }
+    if (control.has_value()) {
+      subdivideQuadCurve(pen, *control, start, data.m_lines);
+    } else if (pen != start) {
+      data.m_lines.emplace_back(glm::vec4(pen.x, pen.y, start.x, start.y));
+    }
+    contourBegin = contourEnd + 1u;
+  }
+  data.m_segments = makeSegments(data.m_lines);
+  return data;
+}
+
+std::unordered_map<uint16_t, GlyphSet::GlyphData> FontFile::buildGlyphs(
+  std::vector<uint16_t> const & codes,
+  uint32_t fontSize,
+  uint32_t threadsCount /* = 0 */) const {
+  std::vector<GlyphSet::GlyphData> glyphs(codes.size());
+  parallelFor(codes.size(), threadsCount, [&](size_t i) {
+    glyphs[i] = buildGlyphData(codes[i], fontSize);
+  });
+
+  std::unordered_map<uint16_t, GlyphSet::GlyphData> result;
+  result.reserve(codes.size());
+  for (size_t i = 0; i < codes.size(); ++i) {
+    result[codes[i]] = std::move(glyphs[i]);
+  }
+  return result;
+}
+
+}  // namespace sdf
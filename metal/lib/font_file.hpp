@@ -0,0 +1,149 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/glm_math.hpp"
+#include "glyph_set.hpp"
+
+namespace sdf {
+
+// OpenType font (.ttf, .otf, or a font of a .ttc collection) mapped read-only
+// into memory. Only the table directory and a few small headers are read on open,
+// glyph outlines and metrics are decoded on demand straight from the mapping.
+// All methods are const and don't mutate any state, so any number of threads
+// can extract glyphs from one FontFile concurrently.
+//
+// Both TrueType ('glyf') and CFF ('CFF ', Type 2 charstrings) outlines are
+// supported. CFF2 and the FontMatrix of CFF fonts are not, outlines are assumed
+// to be in units of unitsPerEm.
+class FontFile {
+public:
+  static std::unique_ptr<FontFile> open(std::string const & path, uint32_t fontIndex = 0);
+
+  ~FontFile();
+
+  FontFile(FontFile const &) = delete;
+  FontFile & operator=(FontFile const &) = delete;
+
+  std::string const & getPath() const { return m_path; }
+  size_t getMappingSize() const { return m_mappingSize; }
+  uint16_t getUnitsPerEm() const { return m_unitsPerEm; }
+  uint16_t getGlyphsCount() const { return m_glyphsCount; }
+
+  // Glyph index from the Unicode cmap, 0 (.notdef) if the font has no such glyph.
+  uint16_t getGlyphIndex(uint32_t codePoint) const;
+  // Advance in font units.
+  uint16_t getAdvance(uint16_t glyphIndex) const;
+
+  enum class PointType : uint8_t {
+    OnCurve,
+    // Control point of a quadratic curve (TrueType). Two of them in a row imply
+    // an on-curve point in the middle.
+    Quadratic,
+    // Control point of a cubic curve (CFF), always two in a row.
+    Cubic
+  };
+  struct Outline {
+    // Points in font units, y goes up. Contour i ends at m_contourEnds[i] (inclusive).
+    // Contours are closed, the first point is not repeated at the end.
+    std::vector<glm::vec2> m_points;
+    std::vector<PointType> m_pointTypes;
+    std::vector<uint16_t> m_contourEnds;
+    glm::vec2 m_min = glm::vec2(0.0f, 0.0f);
+    glm::vec2 m_max = glm::vec2(0.0f, 0.0f);
+  };
+  // Composite glyphs are flattened. Returns nullopt for broken glyph data and for
+  // glyphs which exceed the limits of components, points or charstring operations.
+  std::optional<Outline> getOutline(uint16_t glyphIndex) const;
+
+  // The same data as GlyphSet builds with CoreText: metrics in units of
+  // `fontSize` and outline lines in glyph pixel space. Missing code points
+  // get .notdef.
+  GlyphSet::GlyphData buildGlyphData(uint16_t code, uint32_t fontSize) const;
+  // Extracts glyphs on `threadsCount` threads (0 - all hardware threads).
+  std::unordered_map<uint16_t, GlyphSet::GlyphData> buildGlyphs(
+    std::vector<uint16_t> const & codes,
+    uint32_t fontSize,
+    uint32_t threadsCount = 0) const;
+
+private:
+  struct Table {
+    uint8_t const * m_data = nullptr;
+    size_t m_size = 0;
+  };
+
+  // Work left for one glyph, so broken glyph data can't make extraction
+  // unbounded, e.g. composite glyphs which reference each other many times or
+  // charstrings which call subroutines in a loop.
+  struct OutlineBudget {
+    uint32_t m_componentsLeft = 0;
+    uint32_t m_pointsLeft = 0;
+    uint32_t m_operationsLeft = 0;
+  };
+
+  FontFile() = default;
+
+  bool parse(uint32_t fontIndex);
+  bool parseCff(Table const & cff);
+  Table findTable(uint32_t tableOffset, uint16_t tablesCount, char const * tag) const;
+  // Appends points of the glyph transformed with the 2x2 matrix (xx, xy, yx, yy)
+  // and the offset. Components of composite glyphs are appended recursively.
+  bool appendOutline(uint16_t glyphIndex,
+                     glm::vec4 const & transform,
+                     glm::vec2 const & offset,
+                     uint32_t depth,
+                     OutlineBudget & budget,
+                     Outline & outline) const;
+  // Runs the Type 2 charstring of the glyph.
+  bool appendCffOutline(uint16_t glyphIndex, OutlineBudget & budget, Outline & outline) const;
+
+  // CFF INDEX structures are kept whole, objects are located on access.
+  static Table readCffIndex(Table const & cff, size_t offset);
+  static uint32_t getCffIndexCount(Table const & index);
+  static Table getCffIndexObject(Table const & index, uint32_t i);
+
+  std::string m_path;
+  void * m_mapping = nullptr;
+  size_t m_mappingSize = 0;
+
+  Table m_cmap;
+  Table m_glyf;
+  Table m_hmtx;
+  Table m_loca;
+  // CFF fonts only, m_glyf and m_loca are empty then.
+  Table m_cffCharStrings;
+  Table m_cffGlobalSubrs;
+  // Local subroutines of every font DICT, one for fonts which are not CID-keyed.
+  std::vector<Table> m_cffLocalSubrs;
+  // Font DICT of every glyph, empty for fonts which are not CID-keyed.
+  Table m_cffFdSelect;
+  // Subtable of m_cmap which is used for lookups, format 4 or 12.
+  Table m_cmapSubtable;
+  uint16_t m_cmapFormat = 0;
+  uint16_t m_unitsPerEm = 0;
+  uint16_t m_glyphsCount = 0;
+  uint16_t m_horizontalMetricsCount = 0;
+  bool m_isLongLoca = false;
+};
+
+}  // namespace sdf
@@ -0,0 +1,34 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glyph_atlas.hpp"
+
+namespace sdf::gpu {
+
+GlyphAtlas::GlyphAtlas(std::unique_ptr<GlyphSet const> glyphSet,
+                       MTL::Texture * texture,
+                       uint64_t checksum /* = 0 */,
+                       std::shared_ptr<void const> texelStorage /* = nullptr */)
+  : m_glyphSet(std::move(glyphSet))
+  , m_texture(texture)
+  , m_checksum(checksum)
+  , m_texelStorage(std::move(texelStorage)) {}
+
+GlyphAtlas::~GlyphAtlas() {
+  if (m_texture) {
+    m_texture->release();
+  }
+}
+
+}  // namespace sdf::gpu
@@ -0,0 +1,52 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+#include <memory>
+
+#include "glyph_set.hpp"
+
+namespace sdf::gpu {
+
+// Glyph set together with its SDF texture. Immutable once built, so it can be
+// built on a background thread and then shared with the render thread.
+class GlyphAtlas {
+public:
+  // Takes ownership of the texture. `checksum` is computeAtlasChecksum of
+  // the texture contents, 0 if unknown. `texelStorage` keeps memory which the
+  // texture samples in place alive (see GlyphTexture::createNoCopy), it is
+  // released after the texture.
+  GlyphAtlas(std::unique_ptr<GlyphSet const> glyphSet,
+             MTL::Texture * texture,
+             uint64_t checksum = 0,
+             std::shared_ptr<void const> texelStorage = nullptr);
+  ~GlyphAtlas();
+
+  GlyphAtlas(GlyphAtlas const &) = delete;
+  GlyphAtlas & operator=(GlyphAtlas const &) = delete;
+
+  GlyphSet const & getGlyphSet() const { return *m_glyphSet; }
+  MTL::Texture * getTexture() const { return m_texture; }
+  uint64_t getChecksum() const { return m_checksum; }
+
+private:
+  std::unique_ptr<GlyphSet const> m_glyphSet;
+  MTL::Texture * m_texture = nullptr;
+  uint64_t m_checksum = 0;
+  std::shared_ptr<void const> m_texelStorage;
+};
+
+}  // namespace sdf::gpu
@@ -0,0 +1,114 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glyph_packing_order.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+namespace sdf {
+namespace {
+// Chars closer than this in the corpus co-occur. Quads are drawn in text order,
+// so neighbours are sampled within a few instances of each other.
+size_t constexpr kCooccurrenceDistance = 2;
+// Number of recently placed glyphs which attract the next one, about a few
+// cache lines of a typical atlas row.
+size_t constexpr kWindowSize = 8;
+}  // namespace
+
+std::vector<uint16_t> getCooccurrencePackingOrder(std::vector<uint16_t> const & codes,
+                                                  std::string_view corpus) {
+  // Dense indices of glyphs in the set.
+  std::vector<int32_t> indices(std::numeric_limits<uint16_t>::max() + 1, -1);
+  std::vector<uint16_t> uniqueCodes;
+  for (auto code : codes) {
+    if (indices[code] < 0) {
+      indices[code] = static_cast<int32_t>(uniqueCodes.size());
+      uniqueCodes.push_back(code);
+    }
+  }
+  auto const glyphsCount = uniqueCodes.size();
+
+  // Chars are converted to codes the same way TextRenderer::addText does.
+  std::vector<uint32_t> frequencies(glyphsCount, 0);
+  std::vector<std::unordered_map<uint32_t, uint32_t>> cooccurrences(glyphsCount);
+  for (size_t i = 0; i < corpus.size(); ++i) {
+    auto const a = indices[static_cast<uint16_t>(corpus[i])];
+    if (a < 0) {
+      continue;
+    }
+    frequencies[a]++;
+    for (size_t d = 1; d <= kCooccurrenceDistance && i + d < corpus.size(); ++d) {
+      auto const b = indices[static_cast<uint16_t>(corpus[i + d])];
+      if (b >= 0 && b != a) {
+        cooccurrences[a][b]++;
+        cooccurrences[b][a]++;
+      }
+    }
+  }
+
+  std::vector<uint16_t> order;
+  order.reserve(glyphsCount);
+  std::vector<bool> isPlaced(glyphsCount, false);
+  // Co-occurrence of every glyph with the glyphs in the window.
+  std::vector<uint64_t> scores(glyphsCount, 0);
+  std::vector<uint32_t> window;
+  auto isBetter = [&](size_t a, size_t b) {
+    if (scores[a] != scores[b]) {
+      return scores[a] > scores[b];
+    }
+    if (frequencies[a] != frequencies[b]) {
+      return frequencies[a] > frequencies[b];
+    }
+    return uniqueCodes[a] < uniqueCodes[b];
+  };
+
+  while (true) {
+    size_t best = glyphsCount;
+    for (size_t i = 0; i < glyphsCount; ++i) {
+      if (!isPlaced[i] && frequencies[i] > 0 && (best == glyphsCount || isBetter(i, best))) {
+        best = i;
+      }
+    }
+    if (best == glyphsCount) {
+      break;
+    }
+    isPlaced[best] = true;
+    order.push_back(uniqueCodes[best]);
+
+    for (auto const & [other, count] : cooccurrences[best]) {
+      scores[other] += count;
+    }
+    window.push_back(static_cast<uint32_t>(best));
+    if (window.size() > kWindowSize) {
+      for (auto const & [other, count] : cooccurrences[window.front()]) {
+        scores[other] -= count;
+      }
+      window.erase(window.begin());
+    }
+  }
+
+  // Glyphs which are not in the corpus.
+  auto const usedCount = order.size();
+  for (size_t i = 0; i < glyphsCount; ++i) {
+    if (!isPlaced[i]) {
+      order.push_back(uniqueCodes[i]);
+    }
+  }
+  std::sort(order.begin() + usedCount, order.end());
+  return order;
+}
+
+}  // namespace sdf
@@ -0,0 +1,31 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace sdf {
+
+// Orders glyphs for GlyphSet::PackingOrder::AsGiven, so that glyphs which are
+// drawn together end up close to each other in the atlas. Starts with the most
+// frequent glyph of `corpus` and greedily appends the glyph which co-occurs most
+// with the recently placed ones, ties are broken by frequency. Glyphs which are
+// absent in the corpus follow in ascending order. The result is deterministic.
+std::vector<uint16_t> getCooccurrencePackingOrder(std::vector<uint16_t> const & codes,
+                                                  std::string_view corpus);
+
+}  // namespace sdf
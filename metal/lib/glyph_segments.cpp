@@ -0,0 +1,48 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glyph_segments.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sdf {
+
+Segment makeSegment(glm::vec4 const & line) {
+  auto const direction = glm::vec2(line.z - line.x, line.w - line.y);
+  auto const lengthSq = glm::dot(direction, direction);
+
+  Segment s;
+  s.from.x = line.x;
+  s.from.y = line.y;
+  s.direction.x = direction.x;
+  s.direction.y = direction.y;
+  s.invLengthSq = lengthSq > 0.0f ? 1.0f / lengthSq : 0.0f;
+  s.invLength = lengthSq > 0.0f ? 1.0f / std::sqrt(lengthSq) : 0.0f;
+  s.minY = std::min(line.y, line.w);
+  s.maxY = std::max(line.y, line.w);
+  s.dxdy = direction.y != 0.0f ? direction.x / direction.y : 0.0f;
+  return s;
+}
+
+std::vector<Segment> makeSegments(std::vector<glm::vec4> const & lines) {
+  std::vector<Segment> segments;
+  segments.reserve(lines.size());
+  for (auto const & l : lines) {
+    segments.push_back(makeSegment(l));
+  }
+  return segments;
+}
+
+}  // namespace sdf
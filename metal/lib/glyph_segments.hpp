@@ -0,0 +1,28 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+
+#include "common/glm_math.hpp"
+#include "sdf_text_types.h"
+
+namespace sdf {
+
+// Segment of a line (from.x, from.y, to.x, to.y) of a glyph outline.
+Segment makeSegment(glm::vec4 const & line);
+std::vector<Segment> makeSegments(std::vector<glm::vec4> const & lines);
+
+}  // namespace sdf
@@ -15,37 +15,134 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "common/glm_math.hpp"
+#include "sdf_text_types.h"
 
 namespace sdf {
 
+class FontFile;
+
+// A glyph set is immutable after construction, so it can be read from any
+// number of threads. To add glyphs, bake a new atlas (see AtlasRebuilder) and
+// switch renderers to it.
 class GlyphSet {
 public:
   static uint32_t constexpr kBorderInPixels = 4;
+  static constexpr char const * kDefaultFontName = "Helvetica";
+
+  // Order in which glyphs are placed in the atlas. Glyphs which are drawn
+  // together are better placed next to each other (see getCooccurrencePackingOrder).
+  enum class PackingOrder {
+    // Ascending codes.
+    Sorted,
+    // The order of codes given to the constructor, icons follow the glyphs.
+    AsGiven
+  };
+
+  // Codes of the Unicode Private Use Area, which fonts don't use for regular
+  // characters. Icons should take codes from this range.
+  static uint16_t constexpr kFirstIconCode = 0xE000;
+  static uint16_t constexpr kLastIconCode = 0xF8FF;
+
+  // Monochrome vector icon, which is flattened, packed and turned into SDF like
+  // font glyphs. The path is in a view box with y going down (as in SVG), the
+  // view box height corresponds to the base font size.
+  struct Icon {
+    enum class Command : uint8_t { MoveTo, LineTo, QuadTo, CubicTo, Close };
+
+    uint16_t m_code = kFirstIconCode;
+    glm::vec2 m_viewBoxSize = glm::vec2(24.0f, 24.0f);
+    std::vector<Command> m_commands;
+    // MoveTo and LineTo take 1 point, QuadTo 2 points, CubicTo 3 points, Close none.
+    std::vector<glm::vec2> m_points;
+
+    Icon & moveTo(glm::vec2 const & p);
+    Icon & lineTo(glm::vec2 const & p);
+    Icon & quadTo(glm::vec2 const & control, glm::vec2 const & p);
+    Icon & cubicTo(glm::vec2 const & control1, glm::vec2 const & control2, glm::vec2 const & p);
+    Icon & close();
+  };
 
+  // An icon with the code of a font glyph replaces the font glyph.
   explicit GlyphSet(std::vector<uint16_t> const & unicodeGlyphs,
                     uint32_t baseAtlasSize = 256,
-                    uint32_t baseFontSize = 48);
+                    uint32_t baseFontSize = 48,
+                    std::string const & fontName = kDefaultFontName,
+                    PackingOrder packingOrder = PackingOrder::Sorted,
+                    std::vector<Icon> const & icons = {});
+
+  // The same, but glyph outlines are extracted from a font file on CPU threads
+  // instead of CoreText. The font name is the path of the file.
+  GlyphSet(FontFile const & fontFile,
+           std::vector<uint16_t> const & unicodeGlyphs,
+           uint32_t baseAtlasSize = 256,
+           uint32_t baseFontSize = 48,
+           PackingOrder packingOrder = PackingOrder::Sorted,
+           std::vector<Icon> const & icons = {});
 
   struct GlyphData {
     std::vector<glm::vec4> m_lines;
+    // m_lines prepared for the SDF generators.
+    std::vector<Segment> m_segments;
     float m_advance = 0.0;
     glm::vec2 m_offset;
     glm::vec2 m_size;
     glm::uvec2 m_pixelSize;
     glm::uvec2 m_posInAtlas;
   };
+
+  // Creates a glyph set from already baked and packed glyphs (e.g. loaded from
+  // a shared atlas). Outlines are not required for rendering and can be empty,
+  // missing segments are built from the outlines.
+  GlyphSet(std::unordered_map<uint16_t, GlyphData> && glyphs,
+           glm::uvec2 const & atlasSize,
+           uint32_t baseFontSize = 48,
+           std::string const & fontName = kDefaultFontName);
+
   auto const & getGlyphs() const { return m_glyphs; }
   glm::uvec2 const & getAtlasSize() const { return m_atlasSize; }
+  // Codes in ascending order. Iteration order of the glyphs map is unspecified,
+  // use this wherever the order affects the result (packing, serialization).
+  std::vector<uint16_t> getSortedCodes() const { return getSortedCodes(m_glyphs); }
+  uint32_t getBaseFontSize() const { return m_baseFontSize; }
+  std::string const & getFontName() const { return m_fontName; }
+
+  static std::vector<uint16_t> getSortedCodes(
+    std::unordered_map<uint16_t, GlyphData> const & glyphs);
+
+  // Glyphs are split into pages of kPageMaxGlyphs consecutive glyphs of the packing
+  // order. Pages are packed in parallel into shelves as wide as the atlas and
+  // stacked in the atlas, so the layout only differs from packing all glyphs in
+  // one go at page boundaries.
+  static uint32_t constexpr kPageMaxGlyphs = 1024;
+  struct PackingStats {
+    double m_timeMs = 0.0;
+    uint32_t m_pagesCount = 0;
+    // Atlas sizes tried after the smallest one which holds the glyphs area.
+    uint32_t m_retriesCount = 0;
+  };
+  // Zeros for glyph sets created from already packed glyphs.
+  PackingStats const & getPackingStats() const { return m_packingStats; }
 
 private:
+  void buildGlyphs(std::vector<uint16_t> const & unicodeGlyphs);
+  void buildIcons(std::vector<Icon> const & icons);
+  void setPackingOrder(PackingOrder packingOrder,
+                       std::vector<uint16_t> const & unicodeGlyphs,
+                       std::vector<Icon> const & icons);
   void packGlyphsToAtlas(uint32_t atlasSize);
 
   std::unordered_map<uint16_t, GlyphData> m_glyphs;
+  // Unique codes in packing order, empty for PackingOrder::Sorted.
+  std::vector<uint16_t> m_packingOrder;
   glm::uvec2 m_atlasSize;
+  uint32_t m_baseFontSize = 48;
+  std::string m_fontName;
+  PackingStats m_packingStats;
 };
 
 }  // namespace sdf
@@ -17,17 +17,22 @@
 #import <CoreGraphics/CoreGraphics.h>
 #import <CoreText/CoreText.h>
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <limits>
 #include <optional>
 
+#include "font_file.hpp"
+#include "glyph_segments.hpp"
+#include "parallel_for.hpp"
+
 #if !__has_feature(objc_arc)
 #error "ARC is off"
 #endif
 
 namespace sdf {
 namespace {
-char const * const kFontName = "Helvetica";
-
 glm::vec2 getPointOnQuadBezierCurve(CGPoint const & p1,
                                     CGPoint const & p2,
                                     CGPoint const & p3,
@@ -72,23 +77,13 @@ void subdivideCurve(std::function<glm::vec2(float)> const & getPoint,
   }
 }
 
-GlyphSet::GlyphData buildGlyphData(CTFontRef ctFont, CGFontRef cgFont, uint16_t code, float scale) {
-  CGGlyph g;
-  if (!CTFontGetGlyphsForCharacters(ctFont, &code, &g, 1)) {
-    g = 0x30;
-  }
-  CGRect rect = {};
-  CGFontGetGlyphBBoxes(cgFont, &g, 1, &rect);
-
-  int advanceX = 0;
-  CGFontGetGlyphAdvances(cgFont, &g, 1, &advanceX);
-
-  GlyphSet::GlyphData data;
-  data.m_advance = static_cast<float>(advanceX) * scale;
-  data.m_offset =
-    glm::vec2{static_cast<float>(rect.origin.x) * scale, static_cast<float>(rect.origin.y) * scale};
-  data.m_size = glm::vec2{static_cast<float>(rect.size.width) * scale,
-                          static_cast<float>(rect.size.height) * scale};
+// Sets metrics of a glyph from its bounds (in units of the base font size) and
+// returns the transform from these units to the glyph's pixels in the atlas.
+CGAffineTransform setGlyphBounds(glm::vec2 const & offset,
+                                 glm::vec2 const & size,
+                                 GlyphSet::GlyphData & data) {
+  data.m_offset = offset;
+  data.m_size = size;
   data.m_pixelSize = glm::uvec2{static_cast<uint32_t>(ceil(data.m_size.x)),
                                 static_cast<uint32_t>(ceil(data.m_size.y))};
 
@@ -97,18 +92,16 @@ GlyphSet::GlyphData buildGlyphData(CTFontRef ctFont, CGFontRef cgFont, uint16_t
 
   data.m_pixelSize += 2 * GlyphSet::kBorderInPixels;
 
-  auto glyphTransform = CGAffineTransformMake(
+  return CGAffineTransformMake(
     scaleX,
     0,
     0,
     -scaleY,
     -data.m_offset.x * scaleX + GlyphSet::kBorderInPixels,
     data.m_pixelSize.y + data.m_offset.y * scaleY - GlyphSet::kBorderInPixels);
-  CGPathRef path = CTFontCreatePathForGlyph(ctFont, g, &glyphTransform);
-  if (path == nil) {
-    return data;
-  }
+}
 
+std::vector<glm::vec4> flattenPath(CGPathRef path) {
   __block CGPoint startPoint = {};
   __block CGPoint prevPoint = {};
   __block std::vector<glm::vec4> lines;
@@ -146,24 +139,105 @@ GlyphSet::GlyphData buildGlyphData(CTFontRef ctFont, CGFontRef cgFont, uint16_t
       break;
     }
   });
-  data.m_lines = std::move(lines);
+  return lines;
+}
+
+GlyphSet::GlyphData buildGlyphData(CTFontRef ctFont, CGFontRef cgFont, uint16_t code, float scale) {
+  CGGlyph g;
+  if (!CTFontGetGlyphsForCharacters(ctFont, &code, &g, 1)) {
+    g = 0x30;
+  }
+  CGRect rect = {};
+  CGFontGetGlyphBBoxes(cgFont, &g, 1, &rect);
 
+  int advanceX = 0;
+  CGFontGetGlyphAdvances(cgFont, &g, 1, &advanceX);
+
+  GlyphSet::GlyphData data;
+  data.m_advance = static_cast<float>(advanceX) * scale;
+  auto glyphTransform = setGlyphBounds(
+    glm::vec2{static_cast<float>(rect.origin.x) * scale, static_cast<float>(rect.origin.y) * scale},
+    glm::vec2{static_cast<float>(rect.size.width) * scale,
+              static_cast<float>(rect.size.height) * scale},
+    data);
+  CGPathRef path = CTFontCreatePathForGlyph(ctFont, g, &glyphTransform);
+  if (path == nil) {
+    return data;
+  }
+
+  data.m_lines = flattenPath(path);
+  data.m_segments = makeSegments(data.m_lines);
+
+  CGPathRelease(path);
+  return data;
+}
+
+GlyphSet::GlyphData buildIconData(GlyphSet::Icon const & icon, float scale) {
+  using Command = GlyphSet::Icon::Command;
+
+  GlyphSet::GlyphData data;
+  data.m_advance = icon.m_viewBoxSize.x * scale;
+
+  // The bottom of the view box is on the baseline.
+  auto const toGlyph =
+    CGAffineTransformMake(scale, 0, 0, -scale, 0, icon.m_viewBoxSize.y * scale);
+  CGMutablePathRef path = CGPathCreateMutable();
+  auto const & p = icon.m_points;
+  size_t i = 0;
+  for (auto command : icon.m_commands) {
+    if (command == Command::MoveTo && i + 1 <= p.size()) {
+      CGPathMoveToPoint(path, &toGlyph, p[i].x, p[i].y);
+      i += 1;
+    } else if (command == Command::LineTo && i + 1 <= p.size()) {
+      CGPathAddLineToPoint(path, &toGlyph, p[i].x, p[i].y);
+      i += 1;
+    } else if (command == Command::QuadTo && i + 2 <= p.size()) {
+      CGPathAddQuadCurveToPoint(path, &toGlyph, p[i].x, p[i].y, p[i + 1].x, p[i + 1].y);
+      i += 2;
+    } else if (command == Command::CubicTo && i + 3 <= p.size()) {
+      CGPathAddCurveToPoint(
+        path, &toGlyph, p[i].x, p[i].y, p[i + 1].x, p[i + 1].y, p[i + 2].x, p[i + 2].y);
+      i += 3;
+    } else if (command == Command::Close) {
+      CGPathCloseSubpath(path);
+    }
+  }
+  if (CGPathIsEmpty(path)) {
+    CGPathRelease(path);
+    setGlyphBounds(glm::vec2{0.0f, 0.0f}, glm::vec2{0.0f, 0.0f}, data);
+    return data;
+  }
+
+  auto const rect = CGPathGetPathBoundingBox(path);
+  auto glyphTransform = setGlyphBounds(
+    glm::vec2{static_cast<float>(rect.origin.x), static_cast<float>(rect.origin.y)},
+    glm::vec2{static_cast<float>(rect.size.width), static_cast<float>(rect.size.height)},
+    data);
+  CGPathRef pixelPath = CGPathCreateCopyByTransformingPath(path, &glyphTransform);
   CGPathRelease(path);
+
+  data.m_lines = flattenPath(pixelPath);
+  data.m_segments = makeSegments(data.m_lines);
+
+  CGPathRelease(pixelPath);
   return data;
 }
 
+// Fewer glyphs are packed on the calling thread.
+size_t constexpr kParallelPackingMinGlyphs = 4096;
+
 class AtlasPacker {
 public:
-  explicit AtlasPacker(uint32_t atlasSize) : m_atlasSize(atlasSize) {}
+  AtlasPacker(uint32_t width, uint32_t height) : m_width(width), m_height(height) {}
 
   std::optional<glm::uvec2> pack(glm::uvec2 const & size) {
-    if (m_cursor.x + size.x + 1 > m_atlasSize) {
+    if (m_cursor.x + size.x + 1 > m_width) {
       m_cursor.x = 1;
       m_cursor.y += (m_yStep + 1);
       m_yStep = 0;
     }
 
-    if (m_cursor.y + size.y + 1 > m_atlasSize) return {};
+    if (m_cursor.y + size.y + 1 > m_height) return {};
 
     glm::uvec2 pos = m_cursor;
     m_cursor.x += (size.x + 1);
@@ -171,46 +245,248 @@ public:
     return pos;
   }
 
+  // The bottom of the last shelf.
+  uint32_t getUsedHeight() const { return m_cursor.y + m_yStep; }
+
 private:
-  uint32_t m_atlasSize = 0;
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  // Packing starts at (1, 1), so texel (0, 0) of an atlas is never covered by
+  // glyphs. Generators make it solid (fully inside any outline), so quads can be
+  // filled from the atlas texture, e.g. by ImGui.
   glm::uvec2 m_cursor = glm::uvec2{1, 1};
   uint32_t m_yStep = 0;
 };
+
+// Glyphs which are packed together, in packing order.
+struct AtlasPage {
+  std::vector<uint16_t> m_codes;
+  std::vector<glm::uvec2> m_sizes;
+  // Positions in the page, the page starts at (0, 0).
+  std::vector<glm::uvec2> m_positions;
+  uint32_t m_height = 0;
+};
+
+void packPage(AtlasPage & page, uint32_t width) {
+  AtlasPacker packer(width, std::numeric_limits<uint32_t>::max());
+  page.m_positions.resize(page.m_sizes.size());
+  for (size_t i = 0; i < page.m_sizes.size(); ++i) {
+    // Glyphs are never wider than the atlas, so a page can always grow.
+    page.m_positions[i] = packer.pack(page.m_sizes[i]).value();
+  }
+  page.m_height = packer.getUsedHeight();
+}
+
+void appendUniqueCodes(std::vector<uint16_t> const & codes, std::vector<uint16_t> & order) {
+  std::vector<bool> isAdded(std::numeric_limits<uint16_t>::max() + 1, false);
+  for (auto code : order) {
+    isAdded[code] = true;
+  }
+  for (auto code : codes) {
+    if (!isAdded[code]) {
+      isAdded[code] = true;
+      order.push_back(code);
+    }
+  }
+}
 }  // namespace
 
 GlyphSet::GlyphSet(std::vector<uint16_t> const & unicodeGlyphs,
                    uint32_t baseAtlasSize /* = 256 */,
-                   uint32_t baseFontSize /* = 24 */) {
-  CFStringRef fontName = CFStringCreateWithCString(nullptr, kFontName, CFStringGetSystemEncoding());
-  auto ctFont = CTFontCreateWithName(fontName, baseFontSize, nullptr);
-  CFRelease(fontName);
+                   uint32_t baseFontSize /* = 24 */,
+                   std::string const & fontName /* = kDefaultFontName */,
+                   PackingOrder packingOrder /* = PackingOrder::Sorted */,
+                   std::vector<Icon> const & icons /* = {} */)
+  : m_baseFontSize(baseFontSize), m_fontName(fontName) {
+  buildGlyphs(unicodeGlyphs);
+  buildIcons(icons);
+  setPackingOrder(packingOrder, unicodeGlyphs, icons);
+  packGlyphsToAtlas(baseAtlasSize);
+}
+
+GlyphSet::GlyphSet(FontFile const & fontFile,
+                   std::vector<uint16_t> const & unicodeGlyphs,
+                   uint32_t baseAtlasSize /* = 256 */,
+                   uint32_t baseFontSize /* = 48 */,
+                   PackingOrder packingOrder /* = PackingOrder::Sorted */,
+                   std::vector<Icon> const & icons /* = {} */)
+  : m_glyphs(fontFile.buildGlyphs(unicodeGlyphs, baseFontSize))
+  , m_baseFontSize(baseFontSize)
+  , m_fontName(fontFile.getPath()) {
+  buildIcons(icons);
+  setPackingOrder(packingOrder, unicodeGlyphs, icons);
+  packGlyphsToAtlas(baseAtlasSize);
+}
+
+void GlyphSet::setPackingOrder(PackingOrder packingOrder,
+                               std::vector<uint16_t> const & unicodeGlyphs,
+                               std::vector<Icon> const & icons) {
+  if (packingOrder != PackingOrder::AsGiven) {
+    return;
+  }
+  appendUniqueCodes(unicodeGlyphs, m_packingOrder);
+  std::vector<uint16_t> iconCodes;
+  iconCodes.reserve(icons.size());
+  for (auto const & icon : icons) {
+    iconCodes.push_back(icon.m_code);
+  }
+  appendUniqueCodes(iconCodes, m_packingOrder);
+}
+
+GlyphSet::GlyphSet(std::unordered_map<uint16_t, GlyphData> && glyphs,
+                   glm::uvec2 const & atlasSize,
+                   uint32_t baseFontSize /* = 48 */,
+                   std::string const & fontName /* = kDefaultFontName */)
+  : m_glyphs(std::move(glyphs))
+  , m_atlasSize(atlasSize)
+  , m_baseFontSize(baseFontSize)
+  , m_fontName(fontName) {
+  for (auto & [_, glyphData] : m_glyphs) {
+    if (glyphData.m_segments.size() != glyphData.m_lines.size()) {
+      glyphData.m_segments = makeSegments(glyphData.m_lines);
+    }
+  }
+}
+
+void GlyphSet::buildGlyphs(std::vector<uint16_t> const & unicodeGlyphs) {
+  if (unicodeGlyphs.empty()) {
+    return;
+  }
+
+  CFStringRef cfFontName =
+    CFStringCreateWithCString(nullptr, m_fontName.c_str(), CFStringGetSystemEncoding());
+  auto ctFont = CTFontCreateWithName(cfFontName, m_baseFontSize, nullptr);
+  CFRelease(cfFontName);
 
   // Build glyphs.
   auto cgFont = CTFontCopyGraphicsFont(ctFont, nullptr);
-  auto const scale = static_cast<float>(baseFontSize) / CGFontGetUnitsPerEm(cgFont);
+  auto const scale = static_cast<float>(m_baseFontSize) / CGFontGetUnitsPerEm(cgFont);
   for (auto code : unicodeGlyphs) {
     m_glyphs[code] = buildGlyphData(ctFont, cgFont, code, scale);
   }
 
   CFRelease(cgFont);
   CFRelease(ctFont);
+}
 
-  // Pack glyphs.
-  packGlyphsToAtlas(baseAtlasSize);
+void GlyphSet::buildIcons(std::vector<Icon> const & icons) {
+  // The view box height is the base font size.
+  for (auto const & icon : icons) {
+    auto const scale = static_cast<float>(m_baseFontSize) / icon.m_viewBoxSize.y;
+    m_glyphs[icon.m_code] = buildIconData(icon, scale);
+  }
+}
+
+GlyphSet::Icon & GlyphSet::Icon::moveTo(glm::vec2 const & p) {
+  m_commands.push_back(Command::MoveTo);
+  m_points.push_back(p);
+  return *this;
+}
+
+GlyphSet::Icon & GlyphSet::Icon::lineTo(glm::vec2 const & p) {
+  m_commands.push_back(Command::LineTo);
+  m_points.push_back(p);
+  return *this;
+}
+
+GlyphSet::Icon & GlyphSet::Icon::quadTo(glm::vec2 const & control, glm::vec2 const & p) {
+  m_commands.push_back(Command::QuadTo);
+  m_points.push_back(control);
+  m_points.push_back(p);
+  return *this;
+}
+
+GlyphSet::Icon & GlyphSet::Icon::cubicTo(glm::vec2 const & control1,
+                                         glm::vec2 const & control2,
+                                         glm::vec2 const & p) {
+  m_commands.push_back(Command::CubicTo);
+  m_points.push_back(control1);
+  m_points.push_back(control2);
+  m_points.push_back(p);
+  return *this;
+}
+
+GlyphSet::Icon & GlyphSet::Icon::close() {
+  m_commands.push_back(Command::Close);
+  return *this;
+}
+
+// static
+std::vector<uint16_t> GlyphSet::getSortedCodes(
+  std::unordered_map<uint16_t, GlyphData> const & glyphs) {
+  std::vector<uint16_t> codes;
+  codes.reserve(glyphs.size());
+  for (auto const & [code, _] : glyphs) {
+    codes.push_back(code);
+  }
+  std::sort(codes.begin(), codes.end());
+  return codes;
 }
 
 void GlyphSet::packGlyphsToAtlas(uint32_t atlasSize) {
-  m_atlasSize = glm::uvec2{atlasSize, atlasSize};
-  AtlasPacker packer(atlasSize);
-  for (auto & [code, glyphData] : m_glyphs) {
-    if (auto p = packer.pack(glyphData.m_pixelSize)) {
-      glyphData.m_posInAtlas = p.value();
-    } else {
-      // Not enough space in atlas, extend and try again.
-      packGlyphsToAtlas(atlasSize * 2);
-      return;
+  auto const t = std::chrono::steady_clock::now();
+
+  // Pack in a stable order, so the same glyphs always get the same atlas. Pages
+  // are consecutive runs of that order, so glyphs which are placed next to each
+  // other (e.g. by co-occurrence) stay next to each other.
+  auto const codes = m_packingOrder.empty() ? getSortedCodes() : m_packingOrder;
+  uint64_t glyphsArea = 0;
+  uint32_t maxGlyphWidth = 0;
+  std::vector<AtlasPage> pages;
+  pages.reserve((codes.size() + kPageMaxGlyphs - 1) / kPageMaxGlyphs);
+  for (size_t i = 0; i < codes.size(); ++i) {
+    if (i % kPageMaxGlyphs == 0) {
+      auto & page = pages.emplace_back();
+      page.m_codes.reserve(std::min<size_t>(kPageMaxGlyphs, codes.size() - i));
+      page.m_sizes.reserve(page.m_codes.capacity());
+    }
+    auto const & pixelSize = m_glyphs[codes[i]].m_pixelSize;
+    pages.back().m_codes.push_back(codes[i]);
+    pages.back().m_sizes.push_back(pixelSize);
+    glyphsArea += static_cast<uint64_t>(pixelSize.x + 1) * (pixelSize.y + 1);
+    maxGlyphWidth = std::max(maxGlyphWidth, pixelSize.x);
+  }
+
+  // Start from the smallest atlas which can hold the glyphs area. Shelves of glyphs
+  // of mixed heights fill 1/4 to 2/3 of it, so the atlas is doubled at most once
+  // as a rule and ends up as small as with packing all glyphs in one go.
+  while (atlasSize < maxGlyphWidth + 2 ||
+         static_cast<uint64_t>(atlasSize) * atlasSize < glyphsArea) {
+    atlasSize *= 2;
+  }
+
+  uint32_t retriesCount = 0;
+  uint32_t const threadsCount = codes.size() < kParallelPackingMinGlyphs ? 1 : 0;
+  while (true) {
+    parallelFor(pages.size(), threadsCount, [&](size_t i) { packPage(pages[i], atlasSize); });
+    uint64_t height = 0;
+    for (auto const & page : pages) {
+      height += page.m_height;
     }
+    if (height + 1 <= atlasSize) {
+      break;
+    }
+    // Not enough space in atlas.
+    atlasSize *= 2;
+    retriesCount++;
   }
+
+  // Stack pages.
+  uint32_t pageOffsetY = 0;
+  for (auto const & page : pages) {
+    for (size_t i = 0; i < page.m_codes.size(); ++i) {
+      m_glyphs[page.m_codes[i]].m_posInAtlas = page.m_positions[i] + glm::uvec2(0, pageOffsetY);
+    }
+    pageOffsetY += page.m_height;
+  }
+  m_atlasSize = glm::uvec2{atlasSize, atlasSize};
+
+  auto const duration = std::chrono::steady_clock::now() - t;
+  m_packingStats = PackingStats{
+    .m_timeMs = std::chrono::duration<double, std::milli>(duration).count(),
+    .m_pagesCount = static_cast<uint32_t>(pages.size()),
+    .m_retriesCount = retriesCount,
+  };
 }
 
 }  // namespace sdf
@@ -40,7 +40,8 @@ uint32_t nextPowerOf2(uint32_t v) {
 MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
                                       MTL::CommandQueue * const commandQueue,
                                       MTL::Library * library,
-                                      GlyphSet const & glyphSet) {
+                                      GlyphSet const & glyphSet,
+                                      bool deterministic /* = false */) {
   // Auto-release pool for temporary objects.
   NS::AutoreleasePool * autoreleasePool = NS::AutoreleasePool::alloc()->init();
   METAL_GUARD(autoreleasePool);
@@ -48,6 +49,9 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
   // Initialize shaders.
   MTL::FunctionConstantValues * constantValues = MTL::FunctionConstantValues::alloc()->init();
   METAL_GUARD(constantValues);
+  constantValues->setConstantValue(&deterministic,
+                                   MTL::DataTypeBool,
+                                   SdfFunctionConstantPreciseMath);
 
   NS::Error * error = nullptr;
   MTL::Function * sdfGenerateFunction =
@@ -81,20 +85,21 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
 
   auto const & glyphs = glyphSet.getGlyphs();
 
-  // Calculate line buffer size and offsets.
-  uint32_t linesBufferSize = 0;
-  std::unordered_map<uint16_t, uint32_t> lineOffsets;
+  // Calculate segment buffer size and offsets.
+  uint32_t segmentsBufferSize = 0;
+  std::unordered_map<uint16_t, uint32_t> segmentOffsets;
   for (auto const & [glyph, glyphData] : glyphs) {
-    if (glyphData.m_lines.empty()) {
+    if (glyphData.m_segments.empty()) {
       continue;
     }
-    lineOffsets[glyph] = linesBufferSize;
-    METAL_ASSERT(glyphData.m_lines.size() < std::numeric_limits<uint32_t>::max() - linesBufferSize);
-    linesBufferSize += static_cast<uint32_t>(glyphData.m_lines.size());
+    segmentOffsets[glyph] = segmentsBufferSize;
+    METAL_ASSERT(glyphData.m_segments.size() <
+                 std::numeric_limits<uint32_t>::max() - segmentsBufferSize);
+    segmentsBufferSize += static_cast<uint32_t>(glyphData.m_segments.size());
   }
 
   // Return default 1x1 black texture.
-  if (linesBufferSize == 0) {
+  if (segmentsBufferSize == 0) {
     MTL::TextureDescriptor * descriptor = MTL::TextureDescriptor::alloc()->init();
     descriptor->setTextureType(MTL::TextureType2D);
     descriptor->setPixelFormat(MTL::PixelFormatR8Unorm);
@@ -111,20 +116,20 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
     return t;
   }
 
-  // Create and fill lines buffer.
-  METAL_ASSERT(linesBufferSize < std::numeric_limits<uint32_t>::max() / sizeof(glm::vec4));
-  MTL::Buffer * linesBuffer =
-    device->newBuffer(linesBufferSize * sizeof(glm::vec4), MTL::ResourceStorageModeShared);
-  METAL_GUARD(linesBuffer);
+  // Create and fill segments buffer.
+  METAL_ASSERT(segmentsBufferSize < std::numeric_limits<uint32_t>::max() / sizeof(Segment));
+  MTL::Buffer * segmentsBuffer =
+    device->newBuffer(segmentsBufferSize * sizeof(Segment), MTL::ResourceStorageModeShared);
+  METAL_GUARD(segmentsBuffer);
 
-  auto contentPtr = static_cast<uint8_t *>(linesBuffer->contents());
+  auto contentPtr = static_cast<uint8_t *>(segmentsBuffer->contents());
   for (auto const & [glyph, glyphData] : glyphs) {
-    if (glyphData.m_lines.empty()) {
+    if (glyphData.m_segments.empty()) {
       continue;
     }
-    memcpy(contentPtr + lineOffsets[glyph] * sizeof(glm::vec4),
-           glyphData.m_lines.data(),
-           static_cast<uint32_t>(glyphData.m_lines.size() * sizeof(glm::vec4)));
+    memcpy(contentPtr + segmentOffsets[glyph] * sizeof(Segment),
+           glyphData.m_segments.data(),
+           static_cast<uint32_t>(glyphData.m_segments.size() * sizeof(Segment)));
   }
 
   // Initialize output buffers.
@@ -145,6 +150,9 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
     outMinDistanceContentPtr[i] = std::numeric_limits<int>::max();
     outIntersectionNumberContentPtr[i] = 0;
   }
+  // An odd number of intersections without any outline nearby makes the solid
+  // texel (see GlyphSet) fully inside.
+  outIntersectionNumberContentPtr[0] = 1;
 
   // Initialize textures over output buffers.
   MTL::TextureDescriptor * descriptor = MTL::TextureDescriptor::alloc()->init();
@@ -194,7 +202,7 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
   // Fill indirect buffers.
   uint32_t indirectBufferSize = 0;
   for (auto const & [_, glyphData] : glyphs) {
-    if (glyphData.m_lines.empty()) {
+    if (glyphData.m_segments.empty()) {
       continue;
     }
     indirectBufferSize += glyphData.m_pixelSize.x * glyphData.m_pixelSize.y;
@@ -220,7 +228,7 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
 
   uint32_t indirectBufferIndex = 0;
   for (auto const & [glyph, glyphData] : glyphs) {
-    if (glyphData.m_lines.empty()) {
+    if (glyphData.m_segments.empty()) {
       continue;
     }
     for (uint32_t j = 0; j < glyphData.m_pixelSize.y; ++j) {
@@ -232,12 +240,12 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
         SdfGenParams params;
         params.pointPos.x = static_cast<float>(i) + 0.5f;
         params.pointPos.y = static_cast<float>(j) + 0.5f;
-        params.linesCount = static_cast<uint32_t>(glyphData.m_lines.size());
-        params.lineBufferOffset = lineOffsets[glyph];
+        params.segmentsCount = static_cast<uint32_t>(glyphData.m_segments.size());
+        params.segmentBufferOffset = segmentOffsets[glyph];
         memcpy(&paramsBufferPtr[indirectBufferIndex], &params, sizeof(params));
 
         auto icbCommand = icb->indirectComputeCommand(indirectBufferIndex);
-        icbCommand->setKernelBuffer(linesBuffer, 0, SdfGenBufferLines);
+        icbCommand->setKernelBuffer(segmentsBuffer, 0, SdfGenBufferSegments);
         icbCommand->setKernelBuffer(outMinDistance, offset * sizeof(int), SdfGenBufferMinDistance);
         icbCommand->setKernelBuffer(outIntersectionNumber,
                                     offset * sizeof(uint32_t),
@@ -254,7 +262,7 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
         // We do the first stage of reduction on load, so we need up to 2x less
         // threads.
         auto const threadsCount =
-          std::max(nextPowerOf2(static_cast<uint32_t>(glyphData.m_lines.size()) / 2),
+          std::max(nextPowerOf2(static_cast<uint32_t>(glyphData.m_segments.size()) / 2),
                    simdGroupSize);
         auto const threadsInGroup =
           std::min(utils::getAligned(threadsCount, simdGroupSize), maxThreadsInGroup);
@@ -268,7 +276,7 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
 
   // Run compute shaders for SDF generation.
   encoder->setComputePipelineState(sdfGeneratePipelineState);
-  encoder->useResource(linesBuffer, MTL::ResourceUsageRead);
+  encoder->useResource(segmentsBuffer, MTL::ResourceUsageRead);
   encoder->useResource(paramsBuffer, MTL::ResourceUsageRead);
   encoder->useResource(outMinDistance, MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
   encoder->useResource(outIntersectionNumber, MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
@@ -293,4 +301,91 @@ MTL::Texture * GlyphTexture::generate(MTL::Device * const device,
 
   return outputTexture;
 }
+
+// static
+MTL::Texture * GlyphTexture::createFromTexels(MTL::Device * const device,
+                                              glm::uvec2 const & atlasSize,
+                                              uint8_t const * texels) {
+  MTL::TextureDescriptor * descriptor = MTL::TextureDescriptor::alloc()->init();
+  descriptor->setTextureType(MTL::TextureType2D);
+  descriptor->setPixelFormat(MTL::PixelFormatR8Unorm);
+  descriptor->setWidth(atlasSize.x);
+  descriptor->setHeight(atlasSize.y);
+  descriptor->setMipmapLevelCount(1);
+  descriptor->setStorageMode(MTL::StorageModeShared);
+  descriptor->setUsage(MTL::TextureUsageShaderRead);
+  METAL_GUARD(descriptor);
+
+  MTL::Texture * t = device->newTexture(descriptor);
+  t->setLabel(STR("SDF Glyphs Texture"));
+  t->replaceRegion(MTL::Region::Make2D(0, 0, atlasSize.x, atlasSize.y), 0, 0, texels, atlasSize.x, 0);
+  return t;
+}
+
+// static
+MTL::Texture * GlyphTexture::createNoCopy(MTL::Device * const device,
+                                          glm::uvec2 const & atlasSize,
+                                          uint8_t const * texels,
+                                          size_t bytesPerRow,
+                                          size_t length) {
+  if (bytesPerRow % device->minimumLinearTextureAlignmentForPixelFormat(MTL::PixelFormatR8Unorm) !=
+      0) {
+    return nullptr;
+  }
+  MTL::Buffer * buffer = device->newBuffer(
+    const_cast<uint8_t *>(texels), length, MTL::ResourceStorageModeShared, nullptr);
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+
+  MTL::TextureDescriptor * descriptor = MTL::TextureDescriptor::alloc()->init();
+  descriptor->setTextureType(MTL::TextureType2D);
+  descriptor->setPixelFormat(MTL::PixelFormatR8Unorm);
+  descriptor->setWidth(atlasSize.x);
+  descriptor->setHeight(atlasSize.y);
+  descriptor->setMipmapLevelCount(1);
+  descriptor->setStorageMode(MTL::StorageModeShared);
+  descriptor->setUsage(MTL::TextureUsageShaderRead);
+  METAL_GUARD(descriptor);
+
+  // The texture retains its buffer.
+  MTL::Texture * t = buffer->newTexture(descriptor, 0 /* offset */, bytesPerRow);
+  buffer->release();
+  if (t != nullptr) {
+    t->setLabel(STR("SDF Glyphs Texture"));
+  }
+  return t;
+}
+
+// static
+std::vector<uint8_t> GlyphTexture::readTexels(MTL::Device * const device,
+                                              MTL::CommandQueue * const commandQueue,
+                                              MTL::Texture * texture) {
+  auto const width = static_cast<uint32_t>(texture->width());
+  auto const height = static_cast<uint32_t>(texture->height());
+
+  MTL::Buffer * readbackBuffer =
+    device->newBuffer(width * height * sizeof(uint8_t), MTL::ResourceStorageModeShared);
+  METAL_GUARD(readbackBuffer);
+
+  // Private textures are not accessible from CPU, so copy texels via blit.
+  auto commandBuffer = commandQueue->commandBuffer();
+  auto encoder = commandBuffer->blitCommandEncoder();
+  encoder->setLabel(STR("SDF Texture Readback Command Encoder"));
+  encoder->copyFromTexture(texture,
+                           0 /* sourceSlice */,
+                           0 /* sourceLevel */,
+                           MTL::Origin::Make(0, 0, 0),
+                           MTL::Size::Make(width, height, 1),
+                           readbackBuffer,
+                           0 /* destinationOffset */,
+                           width /* destinationBytesPerRow */,
+                           width * height /* destinationBytesPerImage */);
+  encoder->endEncoding();
+  commandBuffer->commit();
+  commandBuffer->waitUntilCompleted();
+
+  auto const contentPtr = static_cast<uint8_t const *>(readbackBuffer->contents());
+  return std::vector<uint8_t>(contentPtr, contentPtr + width * height);
+}
 }  // namespace sdf::gpu
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <Metal/Metal.hpp>
+#include <vector>
 
 #include "glyph_set.hpp"
 
@@ -22,10 +23,37 @@ namespace sdf::gpu {
 
 class GlyphTexture {
 public:
+  // In deterministic mode the kernel takes precise lengths instead of fast ones,
+  // the largest source of differences between GPUs and cpu::GlyphTexture. The
+  // texture is not guaranteed to be bit-identical though: the rest of the library
+  // is compiled with fast math and FP contraction, so texels near quantization
+  // steps may differ by one. Compare atlas checksums instead of assuming equality.
   static MTL::Texture * generate(MTL::Device * const device,
                                  MTL::CommandQueue * const commandQueue,
                                  MTL::Library * library,
-                                 GlyphSet const & glyphSet);
+                                 GlyphSet const & glyphSet,
+                                 bool deterministic = false);
+
+  // Creates a shader-readable glyph texture from already baked R8 texels.
+  static MTL::Texture * createFromTexels(MTL::Device * const device,
+                                         glm::uvec2 const & atlasSize,
+                                         uint8_t const * texels);
+
+  // Creates a glyph texture which samples R8 texels in place, without a copy.
+  // `texels` must be page-aligned, `length` a whole number of pages, and the
+  // memory must outlive the texture. Returns nullptr if the device can't sample
+  // rows `bytesPerRow` apart.
+  static MTL::Texture * createNoCopy(MTL::Device * const device,
+                                     glm::uvec2 const & atlasSize,
+                                     uint8_t const * texels,
+                                     size_t bytesPerRow,
+                                     size_t length);
+
+  // Reads back texels of a glyph texture (R8, tightly packed rows). Blocks until
+  // the GPU copy is completed.
+  static std::vector<uint8_t> readTexels(MTL::Device * const device,
+                                         MTL::CommandQueue * const commandQueue,
+                                         MTL::Texture * texture);
 };
 
 }  // namespace sdf::gpu
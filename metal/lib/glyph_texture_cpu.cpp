@@ -0,0 +1,202 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glyph_texture_cpu.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "parallel_for.hpp"
+#include "sdf_text_types.h"
+
+namespace sdf::cpu {
+namespace {
+// The math below mirrors sdfGenerate and sdfWriteTexture kernels in sdf_text.metal.
+
+float calculateMinDistance(Segment const & s, glm::vec2 const & pt) {
+  auto const direction = glm::vec2(s.direction.x, s.direction.y);
+  auto const v1 = pt - glm::vec2(s.from.x, s.from.y);
+  auto const t = glm::dot(direction, v1) * s.invLengthSq;
+  if (t <= 0.0f) {
+    return glm::length(v1);
+  }
+  if (t >= 1.0f) {
+    return glm::length(v1 - direction);
+  }
+  return std::abs(v1.y * direction.x - v1.x * direction.y) * s.invLength;
+}
+
+// The lower end of a segment is inclusive and the upper one is exclusive (see Segment).
+uint32_t getIntersection(Segment const & s, glm::vec2 const & pt) {
+  if (pt.y < s.minY || pt.y >= s.maxY) {
+    return 0;
+  }
+  return (s.from.x + (pt.y - s.from.y) * s.dxdy >= pt.x) ? 1 : 0;
+}
+
+// The generator math before segments were precomputed, kept as is for
+// measureSegmentCost: a general ray/line solve with two divides per line.
+float calculateLineMinDistance(glm::vec2 const & from, glm::vec2 const & to, glm::vec2 const & pt) {
+  auto const v = to - from;
+
+  auto const v1 = pt - from;
+  auto const d1 = glm::dot(v, v1);
+  if (d1 < 0) {
+    return glm::length(v1);
+  }
+
+  auto const v2 = pt - to;
+  auto const d2 = glm::dot(v, v2);
+  if (d2 > 0) {
+    return glm::length(v2);
+  }
+
+  return std::abs(v1.y * v.x - v1.x * v.y) / glm::length(v);
+}
+
+uint32_t getLineIntersection(glm::vec2 const & rayOrigin,
+                             glm::vec2 const & rayDir,
+                             glm::vec2 const & from,
+                             glm::vec2 const & to) {
+  auto const v = to - from;
+  auto const v1 = glm::vec2(-rayDir.y, rayDir.x);
+  auto const d = glm::dot(v, v1);
+  // A ray and a line are collinear, no intersection between them.
+  if (d == 0.0f) {
+    return 0;
+  }
+
+  auto const v2 = rayOrigin - from;
+  auto const t1 = (v2.y * v.x - v2.x * v.y) / d;
+  if (t1 < 0.0f) {
+    return 0;
+  }
+
+  auto const t2 = glm::dot(v1, v2) / d;
+  return (t2 >= 0.0f && t2 < 1.0f) ? 1 : 0;
+}
+
+uint8_t calculateTexel(std::vector<Segment> const & segments, glm::vec2 const & pt) {
+  int minDistInt = std::numeric_limits<int>::max();
+  uint32_t iNum = 0;
+  for (auto const & s : segments) {
+    minDistInt =
+      std::min(minDistInt, static_cast<int>(calculateMinDistance(s, pt) * SDF_DISTANCE_SCALE));
+    iNum += getIntersection(s, pt);
+  }
+
+  auto minDist = static_cast<float>(minDistInt) / SDF_DISTANCE_SCALE;
+  if (iNum % 2 != 0) {
+    minDist = -minDist;
+  }
+
+  float constexpr kMinRange = SDF_DISTANCE_MIN_RANGE;
+  float constexpr kMaxRange = SDF_DISTANCE_MAX_RANGE;
+  auto const v =
+    1.0f - (std::clamp(minDist, kMinRange, kMaxRange) - kMinRange) / (kMaxRange - kMinRange);
+  // Same conversion as a write of a float to R8Unorm texture.
+  return static_cast<uint8_t>(v * 255.0f + 0.5f);
+}
+
+template <typename Func>
+double measureNanoseconds(Func const & func) {
+  auto const t = std::chrono::steady_clock::now();
+  func();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t).count();
+}
+}  // namespace
+
+// static
+std::vector<uint8_t> GlyphTexture::generate(GlyphSet const & glyphSet, uint32_t threadsCount) {
+  auto const & atlasSize = glyphSet.getAtlasSize();
+  std::vector<uint8_t> texels(static_cast<size_t>(atlasSize.x) * atlasSize.y, 0);
+
+  std::vector<GlyphSet::GlyphData const *> glyphs;
+  glyphs.reserve(glyphSet.getGlyphs().size());
+  for (auto const & [_, glyphData] : glyphSet.getGlyphs()) {
+    if (!glyphData.m_segments.empty()) {
+      glyphs.push_back(&glyphData);
+    }
+  }
+
+  // Glyphs don't overlap in the atlas, so every worker writes its own texels.
+  parallelFor(glyphs.size(), threadsCount, [&](size_t index) {
+    auto const & glyphData = *glyphs[index];
+    for (uint32_t j = 0; j < glyphData.m_pixelSize.y; ++j) {
+      auto row = texels.data() + static_cast<size_t>(glyphData.m_posInAtlas.y + j) * atlasSize.x +
+                 glyphData.m_posInAtlas.x;
+      for (uint32_t i = 0; i < glyphData.m_pixelSize.x; ++i) {
+        auto const pt = glm::vec2(static_cast<float>(i) + 0.5f, static_cast<float>(j) + 0.5f);
+        row[i] = calculateTexel(glyphData.m_segments, pt);
+      }
+    }
+  });
+
+  // The solid texel, see GlyphSet.
+  texels[0] = 255;
+  return texels;
+}
+
+// static
+GlyphTexture::SegmentCost GlyphTexture::measureSegmentCost(GlyphSet const & glyphSet) {
+  // Both variants evaluate every segment of every glyph for every texel.
+  uint64_t evaluationsCount = 0;
+  int lineSink = 0;
+  int segmentSink = 0;
+  SegmentCost cost;
+  for (auto const & [_, glyphData] : glyphSet.getGlyphs()) {
+    if (glyphData.m_segments.empty()) {
+      continue;
+    }
+    evaluationsCount += static_cast<uint64_t>(glyphData.m_pixelSize.x) *
+                        glyphData.m_pixelSize.y * glyphData.m_segments.size();
+    auto forEachTexel = [&](auto const & func) {
+      for (uint32_t j = 0; j < glyphData.m_pixelSize.y; ++j) {
+        for (uint32_t i = 0; i < glyphData.m_pixelSize.x; ++i) {
+          func(glm::vec2(static_cast<float>(i) + 0.5f, static_cast<float>(j) + 0.5f));
+        }
+      }
+    };
+    cost.m_linesNs += measureNanoseconds([&]() {
+      forEachTexel([&](glm::vec2 const & pt) {
+        for (auto const & l : glyphData.m_lines) {
+          auto const from = glm::vec2(l.x, l.y);
+          auto const to = glm::vec2(l.z, l.w);
+          lineSink += static_cast<int>(calculateLineMinDistance(from, to, pt)) +
+                      static_cast<int>(getLineIntersection(pt, glm::vec2(1.0f, 0.0f), from, to));
+        }
+      });
+    });
+    cost.m_segmentsNs += measureNanoseconds([&]() {
+      forEachTexel([&](glm::vec2 const & pt) {
+        for (auto const & s : glyphData.m_segments) {
+          segmentSink += static_cast<int>(calculateMinDistance(s, pt)) +
+                         static_cast<int>(getIntersection(s, pt));
+        }
+      });
+    });
+  }
+  if (evaluationsCount != 0) {
+    cost.m_linesNs /= static_cast<double>(evaluationsCount);
+    cost.m_segmentsNs /= static_cast<double>(evaluationsCount);
+  }
+  // Keeps the loops from being optimized out.
+  volatile int sink = lineSink ^ segmentSink;
+  (void)sink;
+  return cost;
+}
+
+}  // namespace sdf::cpu
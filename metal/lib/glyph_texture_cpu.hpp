@@ -0,0 +1,44 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glyph_set.hpp"
+
+namespace sdf::cpu {
+
+// CPU counterpart of gpu::GlyphTexture. Produces the same R8 atlas texels
+// (tightly packed rows) without a Metal device, e.g. for headless baking.
+class GlyphTexture {
+public:
+  // If `threadsCount` is 0, the number of hardware threads is used.
+  static std::vector<uint8_t> generate(GlyphSet const & glyphSet, uint32_t threadsCount = 0);
+
+  struct SegmentCost {
+    // Average time of one distance and crossing evaluation for one texel.
+    double m_linesNs = 0.0;
+    double m_segmentsNs = 0.0;
+  };
+  // Single-threaded microbenchmark of the distance kernel with raw outline lines
+  // (the general ray solve the generators used before) against precomputed
+  // segments (Segment) over all texels of the glyph set. With fast math the
+  // compiler turns the divides of the old math into multiplies and the gap
+  // mostly closes, so this says little about the GPU kernel.
+  static SegmentCost measureSegmentCost(GlyphSet const & glyphSet);
+};
+
+}  // namespace sdf::cpu
@@ -0,0 +1,130 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "glyph_usage_stats.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace sdf {
+namespace {
+std::atomic<uint64_t> g_nextInstanceId = 1;
+
+struct ThreadCountersCache {
+  uint64_t m_instanceId = 0;
+  void * m_counters = nullptr;
+};
+thread_local ThreadCountersCache g_threadCountersCache;
+}  // namespace
+
+GlyphUsageStats::GlyphUsageStats()
+  : m_instanceId(g_nextInstanceId.fetch_add(1, std::memory_order_relaxed))
+  , m_totals(kCodesCount, 0) {}
+
+GlyphUsageStats::ThreadCounters & GlyphUsageStats::getThreadCounters() {
+  auto & cache = g_threadCountersCache;
+  if (cache.m_instanceId == m_instanceId) {
+    return *static_cast<ThreadCounters *>(cache.m_counters);
+  }
+
+  // The first call on this thread (or after using another instance).
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto const threadId = std::this_thread::get_id();
+  auto it = std::find_if(m_threadCounters.begin(),
+                         m_threadCounters.end(),
+                         [&](auto const & counters) { return counters->m_threadId == threadId; });
+  if (it == m_threadCounters.end()) {
+    auto counters = std::make_unique<ThreadCounters>();
+    counters->m_counts = std::make_unique<std::atomic<uint32_t>[]>(kCodesCount);
+    counters->m_threadId = threadId;
+    m_threadCounters.push_back(std::move(counters));
+    it = m_threadCounters.end() - 1;
+  }
+  cache.m_instanceId = m_instanceId;
+  cache.m_counters = it->get();
+  return **it;
+}
+
+void GlyphUsageStats::count(uint16_t code, uint32_t n /* = 1 */) {
+  // Uncontended, the cache line stays in the core of the counting thread.
+  getThreadCounters().m_counts[code].fetch_add(n, std::memory_order_relaxed);
+}
+
+void GlyphUsageStats::merge() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto const & counters : m_threadCounters) {
+    for (size_t code = 0; code < kCodesCount; ++code) {
+      // Cheap check first, most of the codes are never used.
+      if (counters->m_counts[code].load(std::memory_order_relaxed) != 0) {
+        m_totals[code] += counters->m_counts[code].exchange(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+void GlyphUsageStats::reset() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto const & counters : m_threadCounters) {
+    for (size_t code = 0; code < kCodesCount; ++code) {
+      counters->m_counts[code].store(0, std::memory_order_relaxed);
+    }
+  }
+  std::fill(m_totals.begin(), m_totals.end(), 0);
+}
+
+uint64_t GlyphUsageStats::getCount(uint16_t code) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_totals[code];
+}
+
+std::vector<GlyphUsageStats::Entry> GlyphUsageStats::getHistogram() const {
+  std::vector<Entry> histogram;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t code = 0; code < kCodesCount; ++code) {
+      if (m_totals[code] != 0) {
+        histogram.push_back(Entry{static_cast<uint16_t>(code), m_totals[code]});
+      }
+    }
+  }
+  std::sort(histogram.begin(), histogram.end(), [](Entry const & a, Entry const & b) {
+    return a.m_count != b.m_count ? a.m_count > b.m_count : a.m_code < b.m_code;
+  });
+  return histogram;
+}
+
+std::vector<uint16_t> GlyphUsageStats::getUnusedCodes(GlyphSet const & glyphSet) const {
+  std::vector<uint16_t> unusedCodes;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto code : glyphSet.getSortedCodes()) {
+    if (m_totals[code] == 0) {
+      unusedCodes.push_back(code);
+    }
+  }
+  return unusedCodes;
+}
+
+bool GlyphUsageStats::exportHistogram(std::string const & path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file << "code,count\n";
+  for (auto const & entry : getHistogram()) {
+    file << entry.m_code << ',' << entry.m_count << '\n';
+  }
+  return static_cast<bool>(file);
+}
+
+}  // namespace sdf
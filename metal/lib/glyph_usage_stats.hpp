@@ -0,0 +1,84 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "glyph_set.hpp"
+
+namespace sdf {
+
+// Counts how many times every glyph is drawn. Every thread counts into its own
+// table, so counting never locks or contends. Tables are merged into the totals
+// at frame end. The histogram shows which glyphs are worth baking, keeping in the
+// atlas or generating first.
+class GlyphUsageStats {
+public:
+  struct Entry {
+    uint16_t m_code = 0;
+    uint64_t m_count = 0;
+  };
+
+  GlyphUsageStats();
+
+  GlyphUsageStats(GlyphUsageStats const &) = delete;
+  GlyphUsageStats & operator=(GlyphUsageStats const &) = delete;
+
+  // Can be called from any thread, lock-free after the first call on a thread.
+  void count(uint16_t code, uint32_t n = 1);
+
+  // Adds counters of all threads to the totals. Counting can go on meanwhile.
+  void merge();
+  void reset();
+
+  // Merged totals.
+  uint64_t getCount(uint16_t code) const;
+  // Glyphs which were drawn at least once, the most used first.
+  std::vector<Entry> getHistogram() const;
+  // Glyphs of the set which were never drawn, in ascending order.
+  std::vector<uint16_t> getUnusedCodes(GlyphSet const & glyphSet) const;
+
+  // Writes the histogram as CSV lines "code,count".
+  bool exportHistogram(std::string const & path) const;
+
+private:
+  static size_t constexpr kCodesCount = std::numeric_limits<uint16_t>::max() + 1;
+
+  struct ThreadCounters {
+    // Written only by the owning thread, read and reset by merge.
+    std::unique_ptr<std::atomic<uint32_t>[]> m_counts;
+    std::thread::id m_threadId;
+  };
+
+  ThreadCounters & getThreadCounters();
+
+  // Distinguishes instances in the per-thread cache, even if one is allocated
+  // at the address of a destroyed one.
+  uint64_t const m_instanceId;
+
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<ThreadCounters>> m_threadCounters;
+  std::vector<uint64_t> m_totals;
+};
+
+}  // namespace sdf
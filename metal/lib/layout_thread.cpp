@@ -0,0 +1,96 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "layout_thread.hpp"
+
+#include <chrono>
+
+namespace sdf::gpu {
+
+LayoutThread::LayoutThread(LayoutFunction layoutFunction)
+  : m_layoutFunction(std::move(layoutFunction)) {
+  m_thread = std::thread([this]() { run(); });
+}
+
+LayoutThread::~LayoutThread() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_condition.notify_one();
+  m_thread.join();
+}
+
+void LayoutThread::requestFrame(TextRenderer::Recorder::Settings settings) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pendingSettings = std::move(settings);
+  }
+  m_condition.notify_one();
+}
+
+TextRenderer::Recorder const * LayoutThread::acquireFrame() {
+  if ((m_middle.load(std::memory_order_relaxed) & kFreshBit) != 0) {
+    auto const middle = m_middle.exchange(m_frontIndex, std::memory_order_acq_rel);
+    m_frontIndex = middle & kIndexMask;
+    m_hasFrontFrame = true;
+  }
+  return m_hasFrontFrame ? &m_frames[m_frontIndex] : nullptr;
+}
+
+LayoutThread::Timings LayoutThread::getTimings() const {
+  return Timings{
+    .m_layoutMs = m_layoutMs.load(std::memory_order_relaxed),
+    .m_waitMs = m_waitMs.load(std::memory_order_relaxed),
+    .m_framesCount = m_framesCount.load(std::memory_order_relaxed),
+    .m_droppedFramesCount = m_droppedFramesCount.load(std::memory_order_relaxed),
+  };
+}
+
+void LayoutThread::run() {
+  while (true) {
+    auto const waitStart = std::chrono::steady_clock::now();
+    TextRenderer::Recorder::Settings settings;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_isStopping || m_pendingSettings.has_value(); });
+      if (m_isStopping) {
+        return;
+      }
+      settings = std::move(m_pendingSettings.value());
+      m_pendingSettings.reset();
+    }
+
+    auto const layoutStart = std::chrono::steady_clock::now();
+    auto & frame = m_frames[m_backIndex];
+    frame.reset(std::move(settings));
+    m_layoutFunction(frame);
+    auto const layoutEnd = std::chrono::steady_clock::now();
+
+    // Publish the frame and take the middle one for the next frame.
+    auto const middle = m_middle.exchange(m_backIndex | kFreshBit, std::memory_order_acq_rel);
+    m_backIndex = middle & kIndexMask;
+    if ((middle & kFreshBit) != 0) {
+      m_droppedFramesCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_layoutMs.store(std::chrono::duration<double, std::milli>(layoutEnd - layoutStart).count(),
+                     std::memory_order_relaxed);
+    m_waitMs.store(std::chrono::duration<double, std::milli>(layoutStart - waitStart).count(),
+                   std::memory_order_relaxed);
+    m_framesCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace sdf::gpu
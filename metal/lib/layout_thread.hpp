@@ -0,0 +1,96 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "text_renderer.hpp"
+
+namespace sdf::gpu {
+
+// Lays out text on a dedicated thread, so layout of the next frame overlaps with
+// encoding of the current one on the render thread. Finished frames are handed
+// over through a lock-free triple buffer: the render thread always takes the
+// newest finished frame and the layout thread never waits for it. A frame is
+// drawn only with the glyph atlas it was laid out with (see
+// TextRenderer::addRecorded), so after an atlas swap the text is missing until
+// the layout thread catches up, usually for one frame.
+class LayoutThread {
+public:
+  // Called on the layout thread, records one frame.
+  using LayoutFunction = std::function<void(TextRenderer::Recorder & recorder)>;
+
+  struct Timings {
+    // Of the last finished frame.
+    double m_layoutMs = 0.0;
+    // Time the layout thread waited for the request of the last finished frame.
+    double m_waitMs = 0.0;
+    uint64_t m_framesCount = 0;
+    // Finished frames which were replaced by newer ones before the render thread took them.
+    uint64_t m_droppedFramesCount = 0;
+  };
+
+  explicit LayoutThread(LayoutFunction layoutFunction);
+  ~LayoutThread();
+
+  // Called on the render thread after TextRenderer::beginLayouting, e.g. with
+  // TextRenderer::getRecorderSettings. A request which was not started yet is
+  // replaced.
+  void requestFrame(TextRenderer::Recorder::Settings settings);
+
+  // Called on the render thread. Returns the newest finished frame, or the one
+  // returned last time if there is nothing new (nullptr before the first frame).
+  // The frame stays unchanged until the next call.
+  TextRenderer::Recorder const * acquireFrame();
+
+  // Can be called from any thread.
+  Timings getTimings() const;
+
+private:
+  void run();
+
+  LayoutFunction const m_layoutFunction;
+
+  // The layout thread records into m_frames[m_backIndex], the render thread reads
+  // m_frames[m_frontIndex]. m_middle holds the index of the third frame and
+  // kFreshBit if it was finished after the last acquireFrame.
+  static uint8_t constexpr kFreshBit = 4;
+  static uint8_t constexpr kIndexMask = 3;
+  std::array<TextRenderer::Recorder, 3> m_frames;
+  uint8_t m_backIndex = 0;
+  uint8_t m_frontIndex = 1;
+  std::atomic<uint8_t> m_middle = 2;
+  bool m_hasFrontFrame = false;
+
+  std::atomic<double> m_layoutMs = 0.0;
+  std::atomic<double> m_waitMs = 0.0;
+  std::atomic<uint64_t> m_framesCount = 0;
+  std::atomic<uint64_t> m_droppedFramesCount = 0;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::optional<TextRenderer::Recorder::Settings> m_pendingSettings;
+  bool m_isStopping = false;
+};
+
+}  // namespace sdf::gpu
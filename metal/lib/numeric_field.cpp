@@ -0,0 +1,266 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "numeric_field.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "common/utils.hpp"
+#include "text_pipeline.hpp"
+
+namespace sdf::gpu {
+
+NumericField::NumericField(uint32_t integerDigitsCount,
+                           uint32_t fractionDigitsCount /* = 0 */,
+                           float pixelSize /* = 24.0f */)
+  : m_integerDigitsCount(std::max(integerDigitsCount, 1u))
+  , m_fractionDigitsCount(fractionDigitsCount)
+  , m_pixelSize(pixelSize) {
+  auto const digitsCount = m_integerDigitsCount + m_fractionDigitsCount;
+  METAL_ASSERT(digitsCount <= 18);
+  m_maxMagnitude = 1;
+  for (uint32_t i = 0; i < digitsCount; ++i) {
+    m_maxMagnitude *= 10;
+  }
+  m_maxMagnitude--;
+
+  // The sign slot, the integer digits, the point and the fraction digits.
+  auto const slotsCount = 1 + digitsCount + (m_fractionDigitsCount > 0 ? 1 : 0);
+  m_slotSymbols.resize(slotsCount, kBlank);
+  if (m_fractionDigitsCount > 0) {
+    m_slotSymbols[1 + m_integerDigitsCount] = kPoint;
+  }
+  m_slotPens.resize(slotsCount, 0.0f);
+  m_glyphs.resize(slotsCount, Glyph{});
+  setScaledValue(0);
+}
+
+NumericField::~NumericField() {
+  for (auto & frameBuffer : m_frameBuffers) {
+    if (frameBuffer.m_buffer) {
+      frameBuffer.m_buffer->release();
+    }
+  }
+
+  if (m_pipelineState) {
+    m_pipelineState->release();
+  }
+}
+
+bool NumericField::initialize(MTL::Device * const device,
+                              MTL::Library * library,
+                              uint32_t maxFramesInFlight /* = 3 */) {
+  // The number of slots is fixed, so buffers are never reallocated.
+  m_frameBuffers.resize(maxFramesInFlight);
+  for (auto & frameBuffer : m_frameBuffers) {
+    frameBuffer.m_buffer =
+      device->newBuffer(m_glyphs.size() * sizeof(Glyph), MTL::ResourceStorageModeShared);
+    frameBuffer.m_buffer->setLabel(STR("Numeric Field Glyphs Buffer"));
+    frameBuffer.m_dirtyBegin = 0;
+    frameBuffer.m_dirtyEnd = m_glyphs.size();
+  }
+
+  // Initialize shaders.
+  MTL::FunctionConstantValues * constantValues = MTL::FunctionConstantValues::alloc()->init();
+  METAL_GUARD(constantValues);
+
+  NS::Error * error = nullptr;
+  MTL::Function * vsFunction = library->newFunction(STR("vertexText"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(vsFunction);
+
+  MTL::Function * fsFunction = library->newFunction(STR("fragmentText"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(fsFunction);
+
+  // Initialize pipeline state.
+  m_pipelineState = createTextPipelineState(device,
+                                            vsFunction,
+                                            fsFunction,
+                                            STR("Numeric Field Render Pipeline State"),
+                                            false /* premultipliedAlpha */,
+                                            &error);
+  CHECK_AND_RETURN(error, false);
+
+  return true;
+}
+
+void NumericField::setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas) {
+  m_glyphAtlas = std::move(glyphAtlas);
+  layoutSlots();
+}
+
+void NumericField::setColor(glm::vec4 const & color) {
+  m_color = color;
+  layoutSlots();
+}
+
+void NumericField::setValue(double value) {
+  auto scale = 1.0;
+  for (uint32_t i = 0; i < m_fractionDigitsCount; ++i) {
+    scale *= 10.0;
+  }
+  auto const maxValue = static_cast<double>(m_maxMagnitude);
+  setScaledValue(std::llround(std::clamp(value * scale, -maxValue, maxValue)));
+}
+
+void NumericField::setScaledValue(int64_t scaledValue) {
+  bool const isNegative = scaledValue < 0;
+  auto magnitude = isNegative ? uint64_t(0) - static_cast<uint64_t>(scaledValue)
+                              : static_cast<uint64_t>(scaledValue);
+  magnitude = std::min(magnitude, m_maxMagnitude);
+
+  // Digits are written from the last slot. Leading zeros of the integer part are
+  // blank, the sign is right before the first digit.
+  auto slot = m_slotSymbols.size();
+  for (uint32_t i = 0; i < m_fractionDigitsCount; ++i) {
+    setSlot(--slot, static_cast<uint8_t>(magnitude % 10));
+    magnitude /= 10;
+  }
+  if (m_fractionDigitsCount > 0) {
+    --slot;
+  }
+  do {
+    setSlot(--slot, static_cast<uint8_t>(magnitude % 10));
+    magnitude /= 10;
+  } while (magnitude > 0);
+  setSlot(--slot, isNegative ? kMinus : kBlank);
+  while (slot > 0) {
+    setSlot(--slot, kBlank);
+  }
+}
+
+void NumericField::layoutSlots() {
+  if (m_glyphAtlas == nullptr) {
+    return;
+  }
+  auto const & glyphSet = m_glyphAtlas->getGlyphSet();
+  auto const & glyphs = glyphSet.getGlyphs();
+  auto const scale = m_pixelSize / static_cast<float>(glyphSet.getBaseFontSize());
+  auto const atlasSize = glm::vec2(glyphSet.getAtlasSize());
+  auto const border = glm::vec2(GlyphSet::kBorderInPixels, GlyphSet::kBorderInPixels) / atlasSize;
+  auto findGlyph = [&glyphs](char c) {
+    auto it = glyphs.find(c);
+    if (it == glyphs.end()) {
+      it = glyphs.find(' ');
+      METAL_ASSERT(it != glyphs.end());
+    }
+    return it;
+  };
+
+  // Digits and the sign are centered in cells as wide as the widest digit.
+  float cellWidth = 0.0f;
+  for (char c = '0'; c <= '9'; ++c) {
+    cellWidth = std::max(cellWidth, findGlyph(c)->second.m_advance * scale);
+  }
+  auto const pointWidth = findGlyph('.')->second.m_advance * scale;
+  auto prepareSymbol = [&](uint8_t symbol, char c, float width) {
+    auto const & glyphData = findGlyph(c)->second;
+    auto const pen = glm::vec2((width - glyphData.m_advance * scale) * 0.5f, 0.0f);
+    auto const halfSize = glyphData.m_size * 0.5f;
+    auto const uvHalfSize = glm::vec2(glyphData.m_pixelSize) * 0.5f / atlasSize;
+    m_symbolGlyphs[symbol] = Glyph{
+      .center = make_packed_float2(pen + (glyphData.m_offset + halfSize) * scale),
+      .halfSize = make_packed_float2(halfSize * scale),
+      .uvCenter = make_packed_float2(glm::vec2(glyphData.m_posInAtlas) / atlasSize + uvHalfSize),
+      .uvHalfSize = make_packed_float2(uvHalfSize - border),
+      .color = make_packed_float4(m_color),
+    };
+  };
+  for (uint8_t digit = 0; digit < 10; ++digit) {
+    prepareSymbol(digit, static_cast<char>('0' + digit), cellWidth);
+  }
+  prepareSymbol(kBlank, ' ', cellWidth);
+  prepareSymbol(kMinus, '-', cellWidth);
+  prepareSymbol(kPoint, '.', pointWidth);
+
+  float pen = 0.0f;
+  for (size_t slot = 0; slot < m_slotSymbols.size(); ++slot) {
+    m_slotPens[slot] = pen;
+    pen += m_slotSymbols[slot] == kPoint ? pointWidth : cellWidth;
+    m_glyphs[slot] = m_symbolGlyphs[m_slotSymbols[slot]];
+    m_glyphs[slot].center.x += m_slotPens[slot];
+  }
+  m_width = pen;
+  markDirty(0, m_glyphs.size());
+}
+
+void NumericField::setSlot(size_t slot, uint8_t symbol) {
+  if (m_slotSymbols[slot] == symbol) {
+    return;
+  }
+  m_slotSymbols[slot] = symbol;
+  m_glyphs[slot] = m_symbolGlyphs[symbol];
+  m_glyphs[slot].center.x += m_slotPens[slot];
+  markDirty(slot, slot + 1);
+}
+
+void NumericField::markDirty(size_t begin, size_t end) {
+  for (auto & frameBuffer : m_frameBuffers) {
+    if (frameBuffer.m_dirtyBegin >= frameBuffer.m_dirtyEnd) {
+      frameBuffer.m_dirtyBegin = begin;
+      frameBuffer.m_dirtyEnd = end;
+    } else {
+      frameBuffer.m_dirtyBegin = std::min(frameBuffer.m_dirtyBegin, begin);
+      frameBuffer.m_dirtyEnd = std::max(frameBuffer.m_dirtyEnd, end);
+    }
+  }
+}
+
+void NumericField::update() {
+  m_uploadedGlyphsCount = 0;
+  if (m_frameBuffers.empty()) {
+    return;
+  }
+  m_frameIndex++;
+  auto & frameBuffer = m_frameBuffers[m_frameIndex % m_frameBuffers.size()];
+  if (frameBuffer.m_dirtyBegin < frameBuffer.m_dirtyEnd) {
+    auto const contentPtr = static_cast<Glyph *>(frameBuffer.m_buffer->contents());
+    memcpy(contentPtr + frameBuffer.m_dirtyBegin,
+           m_glyphs.data() + frameBuffer.m_dirtyBegin,
+           (frameBuffer.m_dirtyEnd - frameBuffer.m_dirtyBegin) * sizeof(Glyph));
+    m_uploadedGlyphsCount = frameBuffer.m_dirtyEnd - frameBuffer.m_dirtyBegin;
+  }
+  frameBuffer.m_dirtyBegin = 0;
+  frameBuffer.m_dirtyEnd = 0;
+}
+
+void NumericField::render(glm::vec2 const & screenSize,
+                          MTL::RenderCommandEncoder * commandEncoder) {
+  if (m_glyphAtlas == nullptr || m_frameBuffers.empty()) {
+    return;
+  }
+  auto const & frameBuffer = m_frameBuffers[m_frameIndex % m_frameBuffers.size()];
+
+  // Instances are relative to the origin, it's applied by the projection.
+  FrameData frameData;
+  auto const m = glm::ortho(-m_origin.x,
+                            screenSize.x - m_origin.x,
+                            -m_origin.y,
+                            screenSize.y - m_origin.y);
+  memcpy(&frameData.projection, glm::value_ptr(m), sizeof(m));
+
+  commandEncoder->setRenderPipelineState(m_pipelineState);
+  commandEncoder->setVertexBytes(&frameData, sizeof(frameData), TextRenderBufferFrame);
+  commandEncoder->setVertexBuffer(frameBuffer.m_buffer, 0, TextRenderBufferGlyphs);
+  commandEncoder->setFragmentTexture(m_glyphAtlas->getTexture(), TextRenderTextureGlyphs);
+  commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
+                                 0 /* vertexStart */,
+                                 4 /* vertexCount */,
+                                 static_cast<uint32_t>(m_glyphs.size()));
+}
+
+}  // namespace sdf::gpu
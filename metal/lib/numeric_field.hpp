@@ -0,0 +1,110 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "glyph_atlas.hpp"
+#include "sdf_text_types.h"
+
+namespace sdf::gpu {
+
+// A number which changes every frame (a counter, a timer, a frame time readout).
+// Every char has a fixed slot: the sign, the integer digits, the point and the
+// fraction digits. Digits are tabular (as wide as the widest digit), so slots never
+// move and a new value writes only the instances of the changed digits, without
+// formatting a string or laying the text out. Instances persist between frames and
+// only the changed ones are uploaded, as in EditableText.
+class NumericField {
+public:
+  // At least one integer digit is shown, the point is shown only with fraction digits.
+  explicit NumericField(uint32_t integerDigitsCount,
+                        uint32_t fractionDigitsCount = 0,
+                        float pixelSize = 24.0f);
+  ~NumericField();
+
+  // Every frame in flight has its own instance buffer, so an upload never
+  // touches instances which GPU may still read.
+  bool initialize(MTL::Device * const device,
+                  MTL::Library * library,
+                  uint32_t maxFramesInFlight = 3);
+
+  // Prepares digit instances and rebuilds all slots.
+  void setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas);
+
+  // Values which don't fit are clamped to the largest magnitude the field shows.
+  void setValue(double value);
+  // Value multiplied by 10^fractionDigitsCount, e.g. 1667 shows 16.67 with two
+  // fraction digits.
+  void setScaledValue(int64_t scaledValue);
+
+  void setColor(glm::vec4 const & color);
+  // Left end of the baseline on the screen, in pixels. Moving is free.
+  void setOrigin(glm::vec2 const & origin) { m_origin = origin; }
+  // Width of all slots in pixels, it doesn't depend on the value.
+  float getWidth() const { return m_width; }
+
+  // Number of instances uploaded by the last update.
+  size_t getUploadedGlyphsCount() const { return m_uploadedGlyphsCount; }
+  size_t getGlyphsCount() const { return m_glyphs.size(); }
+
+  // Uploads changed instances to the buffer of the next frame.
+  void update();
+  void render(glm::vec2 const & screenSize, MTL::RenderCommandEncoder * commandEncoder);
+
+private:
+  // Symbols 0-9 are digits.
+  static uint8_t constexpr kBlank = 10;
+  static uint8_t constexpr kMinus = 11;
+  static uint8_t constexpr kPoint = 12;
+  static size_t constexpr kSymbolsCount = 13;
+
+  struct FrameBuffer {
+    MTL::Buffer * m_buffer = nullptr;
+    // Instances [begin; end) changed since this buffer was updated.
+    size_t m_dirtyBegin = 0;
+    size_t m_dirtyEnd = 0;
+  };
+
+  void layoutSlots();
+  void setSlot(size_t slot, uint8_t symbol);
+  void markDirty(size_t begin, size_t end);
+
+  uint32_t m_integerDigitsCount;
+  uint32_t m_fractionDigitsCount;
+  float m_pixelSize;
+  uint64_t m_maxMagnitude = 0;
+  glm::vec4 m_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec2 m_origin = glm::vec2(0.0f, 0.0f);
+  std::shared_ptr<GlyphAtlas const> m_glyphAtlas;
+
+  // Instances of the symbols relative to the pen of their slot.
+  std::array<Glyph, kSymbolsCount> m_symbolGlyphs = {};
+  // One instance per slot, instances are relative to the origin.
+  std::vector<uint8_t> m_slotSymbols;
+  std::vector<float> m_slotPens;
+  std::vector<Glyph> m_glyphs;
+  float m_width = 0.0f;
+
+  MTL::RenderPipelineState * m_pipelineState = nullptr;
+  std::vector<FrameBuffer> m_frameBuffers;
+  size_t m_frameIndex = 0;
+  size_t m_uploadedGlyphsCount = 0;
+};
+
+}  // namespace sdf::gpu
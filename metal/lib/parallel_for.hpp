@@ -0,0 +1,59 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace sdf {
+
+// Calls `func(i)` for every i in [0; count) on up to `threadsCount` threads
+// (the calling thread included). Items are handed out one by one, so uneven
+// items are balanced. If `threadsCount` is 0, the number of hardware threads is used.
+template <typename Func>
+void parallelFor(size_t count, uint32_t threadsCount, Func const & func) {
+  if (threadsCount == 0) {
+    threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  threadsCount = static_cast<uint32_t>(std::min<size_t>(threadsCount, count));
+  if (threadsCount <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (auto i = next++; i < count; i = next++) {
+      func(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(threadsCount - 1);
+  for (uint32_t i = 1; i < threadsCount; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto & t : threads) {
+    t.join();
+  }
+}
+
+}  // namespace sdf
@@ -18,47 +18,37 @@ using namespace metal;
 
 #include "sdf_text_types.h"
 
-// Calculates minimal distance between a point `pt` and a line [`from`; `to`].
-float calculateMinDistance(float2 from, float2 to, float2 pt) {
-  float2 v = to - from;
-  
-  float2 v1 = pt - from;
-  float d1 = dot(v, v1);
-  if (d1 < 0) {
-    return length(v1);
+// Set for deterministic bakes (see GlyphTexture::generate). Only lengths are switched
+// to precise math, other operations follow the fast-math settings of the library.
+constant bool kPreciseMathValue [[function_constant(SdfFunctionConstantPreciseMath)]];
+constant bool kPreciseMath = is_function_constant_defined(kPreciseMathValue) && kPreciseMathValue;
+
+float sdfLength(float2 v) {
+  return kPreciseMath ? precise::length(v) : length(v);
+}
+
+// Calculates minimal distance between a point `pt` and a segment.
+float calculateMinDistance(Segment s, float2 pt) {
+  float2 v1 = pt - float2(s.from);
+  float t = dot(float2(s.direction), v1) * s.invLengthSq;
+  if (t <= 0.0) {
+    return sdfLength(v1);
   }
-  
-  float2 v2 = pt - to;
-  float d2 = dot(v, v2);
-  if (d2 > 0) {
-    return length(v2);
+  if (t >= 1.0) {
+    return sdfLength(v1 - float2(s.direction));
   }
-  
-  return abs(v1.y * v.x - v1.x * v.y) / length(v);
+  return abs(v1.y * s.direction.x - v1.x * s.direction.y) * s.invLength;
 }
 
-// Returns 1 if there is an intersection between a ray and a line [`from`; `to`].
-uint getIntersection(float2 rayOrigin, float2 rayDir, float2 from, float2 to) {
-  float2 v = to - from;
-  float2 v1 = float2(-rayDir.y, rayDir.x);
-  float d = dot(v, v1);
-  // A ray and a line are collinear, no intersection between them.
-  if (d == 0.0) {
-    return 0;
-  }
-  
-  float2 v2 = rayOrigin - from;
-  float t1 = (v2.y * v.x - v2.x * v.y) / d;
-  if (t1 < 0.0) {
+// Returns 1 if a ray emitted from `pt` in +X direction crosses a segment, the lower
+// end of the segment is inclusive (see Segment).
+uint getIntersection(Segment s, float2 pt) {
+  if (pt.y < s.minY || pt.y >= s.maxY) {
     return 0;
   }
-  
-  float t2 = dot(v1, v2) / d;
-  return (t2 >= 0.0 && t2 < 1.0) ? 1 : 0;
+  return (s.from.x + (pt.y - s.from.y) * s.dxdy >= pt.x) ? 1 : 0;
 }
 
-constant float kFloatScalar = 100.0;
-
 // Kernel for calculation the distance from some point to the closest glyph's outline
 // and number of intersections between a ray emitted from some point and the glyph's outline.
 // The kernel is executed for every pixel of SDF gliph, aformentioned point is a center of pixel.
@@ -66,8 +56,8 @@ kernel void sdfGenerate(
   // Generation parameters.
   device SdfGenParams & params [[buffer(SdfGenBufferParams)]],
                         
-  // List of lines from which glyph's outline consists of.
-  device Line * lines [[buffer(SdfGenBufferLines)]],
+  // List of segments from which glyph's outline consists of.
+  device Segment * segments [[buffer(SdfGenBufferSegments)]],
                         
   // Threadgroup (shared) memory to implement parallel reduction.
   // Number of elements in each is equal to number of threads in SIMD group (simdSize).
@@ -88,27 +78,24 @@ kernel void sdfGenerate(
   uint simdGroupId [[simdgroup_index_in_threadgroup]]
 ) {
   // We do the first reduction step on load.
-  // Overall thread number is equal to max(nextPowerOf2(linesCount / 2), simdSize).
-  // Every thread takes i-th line and (i + threadGroupSize)-th line if it exists.
-  uint i = threadGroupId * (threadGroupSize * 2) + threadId + params.lineBufferOffset;
+  // Overall thread number is equal to max(nextPowerOf2(segmentsCount / 2), simdSize).
+  // Every thread takes i-th segment and (i + threadGroupSize)-th segment if it exists.
+  uint i = threadGroupId * (threadGroupSize * 2) + threadId + params.segmentBufferOffset;
   
   float minDist = 1000000.0; // very big (unreachable) value.
   uint iNum = 0;
   
   // Useful threads number can be less than simdSize.
-  if (i < params.lineBufferOffset + params.linesCount) {
-    minDist = calculateMinDistance(lines[i].from, lines[i].to, params.pointPos);
-    // NOTE: ray direction can be arbitrary.
-    // For a real graphics engine it's worth to optimize the math in getIntersection
-    // using the fact one of component in ray direction is 0.
-    iNum = getIntersection(params.pointPos, float2(1, 0), lines[i].from, lines[i].to);
+  if (i < params.segmentBufferOffset + params.segmentsCount) {
+    minDist = calculateMinDistance(segments[i], params.pointPos);
+    iNum = getIntersection(segments[i], params.pointPos);
   }
   
   uint i2 = i + threadGroupSize;
-  if (i2 < params.lineBufferOffset + params.linesCount) {
-    float d = calculateMinDistance(lines[i2].from, lines[i2].to, params.pointPos);
+  if (i2 < params.segmentBufferOffset + params.segmentsCount) {
+    float d = calculateMinDistance(segments[i2], params.pointPos);
     minDist = min(minDist, d);
-    iNum += getIntersection(params.pointPos, float2(1, 0), lines[i2].from, lines[i2].to);
+    iNum += getIntersection(segments[i2], params.pointPos);
   }
   
   // Wait for completion of on-load reduction.
@@ -139,10 +126,11 @@ kernel void sdfGenerate(
   minDist = simd_min(minDist);
   iNum = simd_sum(iNum);
   
-  // Atomically update the reduction result.
+  // Atomically update the reduction result. Integer min and sum are exact,
+  // so the result doesn't depend on the order in which threadgroups finish.
   if (threadId == 0) {
     // NOTE: atomic_float in Metal 3 support only add and sub operations.
-    atomic_fetch_min_explicit(outMinDistance, int(minDist * kFloatScalar), memory_order_relaxed);
+    atomic_fetch_min_explicit(outMinDistance, int(minDist * SDF_DISTANCE_SCALE), memory_order_relaxed);
     atomic_fetch_add_explicit(outIntersectionNumber, iNum, memory_order_relaxed);
   }
 }
@@ -159,7 +147,7 @@ kernel void sdfWriteTexture(
     return;
   }
   
-  float minDist = float(inMinDistance.read(gid).r) / kFloatScalar;
+  float minDist = float(inMinDistance.read(gid).r) / SDF_DISTANCE_SCALE;
 
   // Distances inside glyph are negative. Odd number of intersections defines pixels inside gliph.
   uint iNum = inIntersectionNumber.read(gid).r;
@@ -168,10 +156,14 @@ kernel void sdfWriteTexture(
   }
 
   // Normalize before writing to the texture. Glyph's outline will be 0.75 in the texture.
-  float constexpr kMinRange = -10.0;
-  float constexpr kMaxRange = 30.0;
+  float constexpr kMinRange = SDF_DISTANCE_MIN_RANGE;
+  float constexpr kMaxRange = SDF_DISTANCE_MAX_RANGE;
   float v = 1.0 - (clamp(minDist, kMinRange, kMaxRange) - kMinRange) / (kMaxRange - kMinRange);
 
+  // Round explicitly (as the CPU generator does) instead of relying on
+  // the float to unorm conversion of the hardware.
+  v = floor(v * 255.0 + 0.5) * (1.0 / 255.0);
+
   outTexture.write(float4(v, v, v, 1.0), gid);
 }
 
@@ -201,6 +193,24 @@ vertex FragmentInputText vertexText(uint vertexID [[vertex_id]],
   return out;
 }
 
+// Template glyphs are laid out relative to the pen origin once. Every instance is
+// one glyph of one stamp, so a template is drawn at all its stamps by one draw call.
+vertex FragmentInputText vertexStampedText(uint vertexID [[vertex_id]],
+                                           uint instanceId [[instance_id]],
+                                           constant FrameData & frameData [[buffer(TextRenderBufferFrame)]],
+                                           const device Glyph * glyphs [[buffer(TextRenderBufferGlyphs)]],
+                                           const device Stamp * stamps [[buffer(TextRenderBufferStamps)]],
+                                           constant uint & glyphsCount [[buffer(TextRenderBufferTemplateGlyphsCount)]]) {
+  FragmentInputText out;
+  Glyph g = glyphs[instanceId % glyphsCount];
+  Stamp s = stamps[instanceId / glyphsCount];
+  float2 center = g.center + s.origin;
+  out.position = frameData.projection * float4(verticesQuad[vertexID] * g.halfSize + center, 0.0, 1.0);
+  out.color = s.color;
+  out.uv = float2(1.0, -1.0) * verticesQuad[vertexID] * g.uvHalfSize + g.uvCenter;
+  return out;
+}
+
 constexpr sampler kLinearSampler(filter::linear);
 
 fragment float4 fragmentText(FragmentInputText in [[stage_in]],
@@ -212,3 +222,55 @@ fragment float4 fragmentText(FragmentInputText in [[stage_in]],
   out = float4(in.color.rgb, in.color.a * alpha);
   return out;
 }
+
+constexpr sampler kNearestSampler(filter::nearest);
+
+// Coverage bitmaps are placed at whole pixels, so every fragment reads exactly one texel.
+fragment float4 fragmentTextCoverage(FragmentInputText in [[stage_in]],
+                                     texture2d<float> coverageTex [[texture(TextRenderTextureGlyphs)]]) {
+  float coverage = coverageTex.sample(kNearestSampler, in.uv).r;
+  return float4(in.color.rgb, in.color.a * coverage);
+}
+
+vertex FragmentInputText vertexLayer(uint vertexID [[vertex_id]],
+                                     constant FrameData & frameData [[buffer(TextRenderBufferFrame)]],
+                                     constant Glyph & quad [[buffer(TextRenderBufferGlyphs)]]) {
+  FragmentInputText out;
+  out.position = frameData.projection * float4(verticesQuad[vertexID] * quad.halfSize + quad.center, 0.0, 1.0);
+  out.color = quad.color;
+  out.uv = float2(1.0, -1.0) * verticesQuad[vertexID] * quad.uvHalfSize + quad.uvCenter;
+  return out;
+}
+
+// Layers are rendered with premultiplied alpha and composited 1:1 with the screen.
+fragment float4 fragmentLayer(FragmentInputText in [[stage_in]],
+                              texture2d<float> layerTex [[texture(TextRenderTextureGlyphs)]]) {
+  return layerTex.sample(kNearestSampler, in.uv) * in.color.a;
+}
+
+// ImDrawVert as it's described by the vertex descriptor of the ImGui Metal backend.
+struct ImGuiVertex {
+  float2 position [[attribute(ImGuiVertexAttributePosition)]];
+  float2 uv [[attribute(ImGuiVertexAttributeUV)]];
+  float4 color [[attribute(ImGuiVertexAttributeColor)]];
+};
+
+vertex FragmentInputText vertexImGui(ImGuiVertex in [[stage_in]],
+                                     constant float4x4 & projection [[buffer(ImGuiBufferUniforms)]]) {
+  FragmentInputText out;
+  out.position = projection * float4(in.position, 0.0, 1.0);
+  out.color = in.color;
+  out.uv = in.uv;
+  return out;
+}
+
+// ImGui fills shapes with the solid texel of the atlas and draws text with SDF
+// glyphs, so both go through the same threshold.
+fragment float4 fragmentImGuiSdf(FragmentInputText in [[stage_in]],
+                                 texture2d<float> glyphTex [[texture(TextRenderTextureGlyphs)]]) {
+  float dist = glyphTex.sample(kLinearSampler, in.uv).r;
+  // Shapes sample one texel, so there is no gradient to smooth over.
+  float edgeWidth = max(length(float2(dfdx(dist), dfdy(dist))), 0.001);
+  float alpha = smoothstep(0.75 - edgeWidth, 0.75 + edgeWidth, dist);
+  return float4(in.color.rgb, in.color.a * alpha);
+}
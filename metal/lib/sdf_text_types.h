@@ -17,19 +17,47 @@
 
 #include <simd/simd.h>
 
-typedef struct Line {
+// Distances are accumulated as integers with this fixed-point scale.
+#define SDF_DISTANCE_SCALE 100.0f
+
+// Range of distances (in pixels) stored in the SDF texture.
+#define SDF_DISTANCE_MIN_RANGE -10.0f
+#define SDF_DISTANCE_MAX_RANGE 30.0f
+
+typedef enum SdfFunctionConstant {
+  // If true, SDF generation doesn't use fast math, so its result doesn't depend
+  // on the GPU and matches the CPU generator.
+  SdfFunctionConstantPreciseMath = 0
+} SdfFunctionConstant;
+
+// A line of a glyph outline together with the values which the distance kernel
+// would otherwise recompute for every pixel. Built once per glyph (see makeSegment).
+typedef struct Segment {
   packed_float2 from;
-  packed_float2 to;
-} Line;
+  // to - from.
+  packed_float2 direction;
+  // 1 / dot(direction, direction) and 1 / length(direction), 0 if the segment is a point.
+  float invLengthSq;
+  float invLength;
+  // A ray in +X direction crosses the segment if minY <= y < maxY. Horizontal
+  // segments are never crossed, a vertex which the outline passes through in y is
+  // counted once and a vertex at a local y extremum is counted 0 or 2 times. Lines
+  // used to be crossed if from.y <= y < to.y or to.y < y <= from.y, which counts
+  // an extremum once and flips the sign of texels whose rays pass through it.
+  float minY;
+  float maxY;
+  // dx / dy, x of the segment at y is from.x + (y - from.y) * dxdy.
+  float dxdy;
+} Segment;
 
 typedef struct SdfGenParams {
   packed_float2 pointPos;
-  uint linesCount;
-  uint lineBufferOffset;
+  uint segmentsCount;
+  uint segmentBufferOffset;
 } SdfGenParams;
 
 typedef enum SdfGenBuffer {
-  SdfGenBufferLines = 0,
+  SdfGenBufferSegments = 0,
   SdfGenBufferParams,
   SdfGenBufferMinDistance,
   SdfGenBufferIntersectionNumber
@@ -54,13 +82,35 @@ typedef struct Glyph {
   packed_float4 color;
 } Glyph;
 
+// One copy of a label template (see TextRenderer::addLabelTemplate).
+typedef struct Stamp {
+  // Pen position of the first glyph.
+  packed_float2 origin;
+  packed_float4 color;
+} Stamp;
+
 typedef enum TextRenderBuffer {
   TextRenderBufferFrame = 0,
-  TextRenderBufferGlyphs
+  TextRenderBufferGlyphs,
+  TextRenderBufferStamps,
+  TextRenderBufferTemplateGlyphsCount
 } TextRenderBuffer;
 
 typedef enum TextRenderTexture { TextRenderTextureGlyphs = 0 } TextRenderTexture;
 
+// Bindings of the ImGui Metal backend, which pipelines used for ImGui draw
+// lists must follow.
+typedef enum ImGuiBuffer {
+  ImGuiBufferVertices = 0,
+  ImGuiBufferUniforms
+} ImGuiBuffer;
+
+typedef enum ImGuiVertexAttribute {
+  ImGuiVertexAttributePosition = 0,
+  ImGuiVertexAttributeUV,
+  ImGuiVertexAttributeColor
+} ImGuiVertexAttribute;
+
 typedef struct FrameData {
   matrix_float4x4 projection;
 } FrameData;
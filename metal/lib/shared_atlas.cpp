@@ -0,0 +1,270 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shared_atlas.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <new>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "baked_atlas.hpp"
+
+namespace sdf {
+namespace {
+uint32_t constexpr kStateBuilding = 0;
+uint32_t constexpr kStateReady = 1;
+
+struct SharedAtlasHeader {
+  uint32_t m_magic;
+  uint32_t m_version;
+  // Written last by the publisher, readers must not touch anything else until
+  // it becomes kStateReady.
+  std::atomic<uint32_t> m_state;
+  uint32_t m_glyphsCount;
+  uint32_t m_atlasWidth;
+  uint32_t m_atlasHeight;
+  uint32_t m_baseFontSize;
+  // The font name follows the header, it is not null-terminated.
+  uint32_t m_fontNameLength;
+  uint64_t m_key;
+  uint64_t m_checksum;
+  uint64_t m_bytesPerRow;
+  uint64_t m_glyphsOffset;
+  uint64_t m_texelsOffset;
+  uint64_t m_totalSize;
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "Atomic state in shared memory must be lock-free");
+
+size_t getAligned(size_t v, size_t alignment) { return (v + alignment - 1) / alignment * alignment; }
+
+// Publishers of one name are serialized by an advisory lock on a file, which the
+// system releases when the publisher exits or dies. While the lock is held, a
+// segment which is not ready was left by a dead publisher, even if it was never
+// sized. Lock files are not removed, removing them would let two publishers lock
+// different files.
+class PublishLock {
+public:
+  explicit PublishLock(std::string const & name) {
+    auto fileName = "sdf-shared-atlas-" + name.substr(1) + ".lock";
+    std::replace(fileName.begin(), fileName.end(), '/', '_');
+    std::error_code ec;
+    auto const path = std::filesystem::temp_directory_path(ec) / fileName;
+    if (ec) {
+      return;
+    }
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (m_fd >= 0 && flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  ~PublishLock() {
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  PublishLock(PublishLock const &) = delete;
+  PublishLock & operator=(PublishLock const &) = delete;
+
+  bool isLocked() const { return m_fd >= 0; }
+
+private:
+  int m_fd = -1;
+};
+
+bool isReady(std::string const & name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st = {};
+  bool ready = false;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(SharedAtlasHeader)) {
+    void * p = mmap(nullptr, sizeof(SharedAtlasHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      auto const header = static_cast<SharedAtlasHeader const *>(p);
+      ready = header->m_state.load(std::memory_order_acquire) == kStateReady;
+      munmap(p, sizeof(SharedAtlasHeader));
+    }
+  }
+  close(fd);
+  return ready;
+}
+}  // namespace
+
+// static
+std::string SharedAtlas::makeName(std::string const & prefix, uint64_t key) {
+  // The header keeps the whole key, the name only needs to make collisions rare.
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".%08" PRIx32, static_cast<uint32_t>(key ^ (key >> 32)));
+  return prefix + suffix;
+}
+
+// static
+bool SharedAtlas::publish(std::string const & name,
+                          uint64_t key,
+                          GlyphSet const & glyphSet,
+                          std::vector<uint8_t> const & texels) {
+  auto const & atlasSize = glyphSet.getAtlasSize();
+  if (texels.size() != static_cast<size_t>(atlasSize.x) * atlasSize.y) {
+    return false;
+  }
+
+  PublishLock lock(name);
+  if (!lock.isLocked()) {
+    return false;
+  }
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0 && errno == EEXIST && !isReady(name)) {
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  }
+  if (fd < 0) {
+    return false;
+  }
+
+  auto const & glyphs = glyphSet.getGlyphs();
+  auto const & fontName = glyphSet.getFontName();
+  auto const pageSize = static_cast<size_t>(getpagesize());
+  auto const bytesPerRow = getAligned(atlasSize.x, kRowAlignment);
+  auto const glyphsOffset =
+    getAligned(sizeof(SharedAtlasHeader) + fontName.size(), alignof(BakedGlyphRecord));
+  auto const texelsOffset =
+    getAligned(glyphsOffset + glyphs.size() * sizeof(BakedGlyphRecord), pageSize);
+  auto const totalSize = getAligned(texelsOffset + bytesPerRow * atlasSize.y, pageSize);
+
+  if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  void * p = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  auto bytes = static_cast<uint8_t *>(p);
+  auto header = new (bytes) SharedAtlasHeader{};
+  header->m_magic = kMagic;
+  header->m_version = kVersion;
+  header->m_glyphsCount = static_cast<uint32_t>(glyphs.size());
+  header->m_atlasWidth = atlasSize.x;
+  header->m_atlasHeight = atlasSize.y;
+  header->m_baseFontSize = glyphSet.getBaseFontSize();
+  header->m_fontNameLength = static_cast<uint32_t>(fontName.size());
+  header->m_key = key;
+  header->m_checksum = computeAtlasChecksum(glyphs, atlasSize, texels.data());
+  header->m_bytesPerRow = bytesPerRow;
+  header->m_glyphsOffset = glyphsOffset;
+  header->m_texelsOffset = texelsOffset;
+  header->m_totalSize = totalSize;
+
+  memcpy(bytes + sizeof(SharedAtlasHeader), fontName.data(), fontName.size());
+  auto records = reinterpret_cast<BakedGlyphRecord *>(bytes + glyphsOffset);
+  for (auto const & [code, glyphData] : glyphs) {
+    *records++ = BakedGlyphRecord::make(code, glyphData);
+  }
+  for (uint32_t y = 0; y < atlasSize.y; ++y) {
+    memcpy(bytes + texelsOffset + y * bytesPerRow,
+           texels.data() + static_cast<size_t>(y) * atlasSize.x,
+           atlasSize.x);
+  }
+
+  header->m_state.store(kStateReady, std::memory_order_release);
+  munmap(p, totalSize);
+  return true;
+}
+
+// static
+void SharedAtlas::unpublish(std::string const & name) { shm_unlink(name.c_str()); }
+
+// static
+std::unique_ptr<SharedAtlas> SharedAtlas::open(std::string const & name, uint64_t key) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st = {};
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SharedAtlasHeader)) {
+    close(fd);
+    return nullptr;
+  }
+  auto const mappingSize = static_cast<size_t>(st.st_size);
+  void * p = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::unique_ptr<SharedAtlas> atlas(new SharedAtlas());
+  atlas->m_mapping = p;
+  atlas->m_mappingSize = mappingSize;
+
+  auto const bytes = static_cast<uint8_t const *>(p);
+  auto const header = reinterpret_cast<SharedAtlasHeader const *>(bytes);
+  auto const pageSize = static_cast<uint64_t>(getpagesize());
+  if (header->m_state.load(std::memory_order_acquire) != kStateReady ||
+      header->m_magic != kMagic || header->m_version != kVersion || header->m_key != key ||
+      header->m_totalSize != mappingSize || header->m_baseFontSize == 0 ||
+      header->m_fontNameLength == 0 ||
+      sizeof(SharedAtlasHeader) + header->m_fontNameLength > header->m_glyphsOffset ||
+      header->m_texelsOffset % pageSize != 0 ||
+      header->m_bytesPerRow < header->m_atlasWidth ||
+      header->m_bytesPerRow % kRowAlignment != 0 ||
+      header->m_glyphsOffset + header->m_glyphsCount * sizeof(BakedGlyphRecord) >
+        header->m_texelsOffset ||
+      header->m_texelsOffset + header->m_bytesPerRow * header->m_atlasHeight > mappingSize) {
+    return nullptr;
+  }
+
+  std::unordered_map<uint16_t, GlyphSet::GlyphData> glyphs;
+  glyphs.reserve(header->m_glyphsCount);
+  auto const records = reinterpret_cast<BakedGlyphRecord const *>(bytes + header->m_glyphsOffset);
+  for (uint32_t i = 0; i < header->m_glyphsCount; ++i) {
+    glyphs[records[i].m_code] = records[i].toGlyphData();
+  }
+  atlas->m_atlasSize = glm::uvec2{header->m_atlasWidth, header->m_atlasHeight};
+  std::string const fontName(reinterpret_cast<char const *>(bytes + sizeof(SharedAtlasHeader)),
+                             header->m_fontNameLength);
+  atlas->m_glyphSet = std::make_unique<GlyphSet>(std::move(glyphs), atlas->m_atlasSize,
+                                                 header->m_baseFontSize, fontName);
+  atlas->m_checksum = header->m_checksum;
+  atlas->m_texels = bytes + header->m_texelsOffset;
+  atlas->m_bytesPerRow = header->m_bytesPerRow;
+  atlas->m_texelsSize = mappingSize - header->m_texelsOffset;
+  return atlas;
+}
+
+SharedAtlas::~SharedAtlas() {
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_mappingSize);
+  }
+}
+
+}  // namespace sdf
@@ -0,0 +1,95 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glyph_set.hpp"
+
+namespace sdf {
+
+// Glyph metrics and SDF atlas texels published in a named POSIX shared memory
+// segment. One process bakes the atlas and publishes it, other processes on the
+// same machine map the segment read-only instead of rebuilding the glyph set.
+//
+// Segment layout: header, font name, glyph records, atlas texels (R8, rows
+// kRowAlignment bytes apart). Texels start at a page boundary and the segment size
+// is a whole number of pages, so a GPU texture can sample the mapping in place.
+class SharedAtlas {
+public:
+  static uint32_t constexpr kMagic = 0x53444641;  // 'SDFA'
+  // 4: the header keeps the base font size and the font name.
+  static uint32_t constexpr kVersion = 4;
+  // Not less than the linear texture alignment of R8 textures on any Metal GPU.
+  static size_t constexpr kRowAlignment = 256;
+
+  // Segment name of an atlas baked with `key` (see BakeParams::getKey), so processes
+  // which use different glyphs or fonts don't pick up each other's atlas. `prefix`
+  // must start with '/', macOS limits names to 31 characters in total.
+  static std::string makeName(std::string const & prefix, uint64_t key);
+
+  // Publishes the glyph set and its atlas texels (R8, tightly packed rows) under
+  // `name` (see makeName). Returns false if the segment is already published or
+  // is being published by another process.
+  static bool publish(std::string const & name,
+                      uint64_t key,
+                      GlyphSet const & glyphSet,
+                      std::vector<uint8_t> const & texels);
+
+  // Removes the segment name. Processes which have already mapped the segment
+  // keep using it until they close it.
+  static void unpublish(std::string const & name);
+
+  // Maps a published segment read-only. Returns nullptr if there is no such
+  // segment, it is not ready yet, it was published by an incompatible version
+  // or baked with another key.
+  static std::unique_ptr<SharedAtlas> open(std::string const & name, uint64_t key);
+
+  ~SharedAtlas();
+
+  SharedAtlas(SharedAtlas const &) = delete;
+  SharedAtlas & operator=(SharedAtlas const &) = delete;
+
+  glm::uvec2 const & getAtlasSize() const { return m_atlasSize; }
+  // computeAtlasChecksum of the atlas, calculated by the publisher.
+  uint64_t getChecksum() const { return m_checksum; }
+
+  // Moves the glyph set out, e.g. to a GlyphAtlas. Texels stay in the mapping.
+  std::unique_ptr<GlyphSet> releaseGlyphSet() { return std::move(m_glyphSet); }
+
+  // Texels live in the shared mapping, no per-process copy is made. The pointer
+  // is page-aligned and stays valid for the lifetime of the object.
+  uint8_t const * getTexels() const { return m_texels; }
+  size_t getBytesPerRow() const { return m_bytesPerRow; }
+  // Size of the texels block, a whole number of pages.
+  size_t getTexelsSize() const { return m_texelsSize; }
+
+private:
+  SharedAtlas() = default;
+
+  void * m_mapping = nullptr;
+  size_t m_mappingSize = 0;
+  uint8_t const * m_texels = nullptr;
+  size_t m_bytesPerRow = 0;
+  size_t m_texelsSize = 0;
+  glm::uvec2 m_atlasSize = glm::uvec2{0, 0};
+  uint64_t m_checksum = 0;
+  std::unique_ptr<GlyphSet> m_glyphSet;
+};
+
+}  // namespace sdf
@@ -0,0 +1,136 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_document.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "common/utils.hpp"
+
+namespace sdf::gpu {
+
+TextDocument::TextDocument(float pixelSize /* = 16.0f */, float lineSpacing /* = 1.25f */)
+  : m_pixelSize(pixelSize), m_lineHeight(std::ceil(pixelSize * lineSpacing)) {}
+
+void TextDocument::setGlyphSet(GlyphSet const & glyphSet) {
+  m_measurer.emplace(glyphSet);
+  m_scale = m_pixelSize / static_cast<float>(m_measurer->getBaseFontSize());
+  updateLineMetrics(0);
+}
+
+void TextDocument::append(std::string_view text) {
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    auto end = text.find('\n', begin);
+    if (end == std::string_view::npos) {
+      end = text.size();
+    }
+    appendLine(text.substr(begin, end - begin));
+    begin = end + 1;
+  }
+}
+
+void TextDocument::appendLine(std::string_view line) {
+  m_text.append(line);
+  m_lineOffsets.push_back(m_text.size());
+  updateLineMetrics(getLinesCount() - 1);
+}
+
+void TextDocument::clear() {
+  m_text.clear();
+  m_lineOffsets.assign(1, 0);
+  m_lineWidths.clear();
+  m_lineTops.assign(1, 0.0);
+  m_maxLineWidth = 0.0f;
+}
+
+std::string_view TextDocument::getLine(size_t index) const {
+  return std::string_view(m_text).substr(m_lineOffsets[index],
+                                         m_lineOffsets[index + 1] - m_lineOffsets[index]);
+}
+
+void TextDocument::updateLineMetrics(size_t firstLine) {
+  METAL_ASSERT(m_measurer.has_value());
+  auto const linesCount = getLinesCount();
+  m_lineWidths.resize(linesCount);
+  m_lineTops.resize(linesCount + 1);
+  if (firstLine == 0) {
+    m_maxLineWidth = 0.0f;
+  }
+  for (auto i = firstLine; i < linesCount; ++i) {
+    m_lineWidths[i] = m_measurer->getAdvance(getLine(i)) * m_scale;
+    m_maxLineWidth = std::max(m_maxLineWidth, m_lineWidths[i]);
+    m_lineTops[i + 1] = m_lineTops[i] + m_lineHeight;
+  }
+}
+
+glm::vec2 TextDocument::getContentSize() const {
+  return glm::vec2(m_maxLineWidth, static_cast<float>(m_lineTops.back()));
+}
+
+std::pair<size_t, size_t> TextDocument::getLinesInRange(double top, double bottom) const {
+  // Line i intersects the range if its bottom is below `top` and its top is above `bottom`.
+  auto const first = std::upper_bound(m_lineTops.begin() + 1, m_lineTops.end(), top);
+  auto const last = std::lower_bound(m_lineTops.begin(), m_lineTops.end() - 1, bottom);
+  auto const firstLine = static_cast<size_t>(first - (m_lineTops.begin() + 1));
+  auto const lastLine = static_cast<size_t>(last - m_lineTops.begin());
+  return {firstLine, std::max(firstLine, lastLine)};
+}
+
+size_t TextDocument::layout(TextRenderer & renderer,
+                            glm::vec2 const & viewportPosition,
+                            glm::vec2 const & viewportSize,
+                            glm::dvec2 const & scroll,
+                            glm::vec4 const & color) const {
+  if (!m_measurer.has_value()) {
+    return 0;
+  }
+  auto const [firstLine, lastLine] = getLinesInRange(scroll.y, scroll.y + viewportSize.y);
+  auto const viewportTop = viewportPosition.y + viewportSize.y;
+  auto const baselineOffset = (m_lineHeight + m_pixelSize) * 0.5f;
+  auto const left = static_cast<float>(scroll.x) / m_scale;
+  auto const right = static_cast<float>(scroll.x + viewportSize.x) / m_scale;
+
+  thread_local std::vector<float> advances;
+  std::string visibleText;
+  size_t laidOutCount = 0;
+  for (auto i = firstLine; i < lastLine; ++i) {
+    if (m_lineWidths[i] <= scroll.x) {
+      continue;
+    }
+    // Only the visible part of a line is laid out.
+    auto const line = getLine(i);
+    m_measurer->getPrefixAdvances(line, advances);
+    auto const begin = static_cast<size_t>(
+      std::upper_bound(advances.begin() + 1, advances.end(), left) - (advances.begin() + 1));
+    auto const end = static_cast<size_t>(
+      std::lower_bound(advances.begin(), advances.end() - 1, right) - advances.begin());
+    if (begin >= end) {
+      continue;
+    }
+    // The trailing space makes addText fit the advance of the last visible char.
+    visibleText.assign(line.substr(begin, end - begin));
+    visibleText.push_back(' ');
+
+    auto const lineTop = static_cast<float>(m_lineTops[i] - scroll.y);
+    auto const baseline = glm::vec2(
+      viewportPosition.x + (advances[begin] - left) * m_scale, viewportTop - lineTop - baselineOffset);
+    renderer.addText(visibleText, baseline, m_measurer->getLayoutSize(visibleText) * m_scale, color);
+    laidOutCount++;
+  }
+  return laidOutCount;
+}
+
+}  // namespace sdf::gpu
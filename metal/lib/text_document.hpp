@@ -0,0 +1,81 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "glyph_set.hpp"
+#include "text_measurer.hpp"
+#include "text_renderer.hpp"
+
+namespace sdf::gpu {
+
+// Long text (e.g. a log) drawn line by line with a fixed font size. Line widths
+// and prefix sums of line heights are kept up to date on append, so layout
+// touches only lines which intersect the viewport, whatever the document size is.
+class TextDocument {
+public:
+  explicit TextDocument(float pixelSize = 16.0f, float lineSpacing = 1.25f);
+
+  // Line widths are measured with the glyph set, so they are recomputed when it
+  // changes. Must be called before appending.
+  void setGlyphSet(GlyphSet const & glyphSet);
+
+  // Appends lines separated with '\n'.
+  void append(std::string_view text);
+  void appendLine(std::string_view line);
+  void clear();
+
+  size_t getLinesCount() const { return m_lineOffsets.size() - 1; }
+  std::string_view getLine(size_t index) const;
+  float getPixelSize() const { return m_pixelSize; }
+
+  // Size of the whole document in pixels.
+  glm::vec2 getContentSize() const;
+  // Lines [first; last) which intersect the vertical range [top; bottom), y goes down.
+  std::pair<size_t, size_t> getLinesInRange(double top, double bottom) const;
+
+  // Lays out visible lines into the renderer. `scroll` is the offset of the
+  // viewport from the left-top corner of the document (y goes down), the
+  // viewport is given by its left-bottom corner on the screen and its size.
+  // Returns the number of laid out lines.
+  size_t layout(TextRenderer & renderer,
+                glm::vec2 const & viewportPosition,
+                glm::vec2 const & viewportSize,
+                glm::dvec2 const & scroll,
+                glm::vec4 const & color) const;
+
+private:
+  void updateLineMetrics(size_t firstLine);
+
+  float m_pixelSize;
+  float m_lineHeight;
+  float m_scale = 1.0f;
+  std::optional<TextMeasurer> m_measurer;
+
+  // All lines are stored in one buffer, line i is [m_lineOffsets[i]; m_lineOffsets[i + 1]).
+  std::string m_text;
+  std::vector<size_t> m_lineOffsets = {0};
+  // Widths in pixels and tops of lines, m_lineTops[i + 1] is the bottom of line i.
+  // Doubles keep the precision for millions of lines.
+  std::vector<float> m_lineWidths;
+  std::vector<double> m_lineTops = {0.0};
+  float m_maxLineWidth = 0.0f;
+};
+
+}  // namespace sdf::gpu
@@ -0,0 +1,197 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sdf {
+namespace {
+// Limits memory of the grid for sparse layouts.
+int32_t constexpr kMaxGridDimension = 1024;
+}  // namespace
+
+void TextIndex::clear() {
+  m_runs.clear();
+  m_carets.clear();
+  m_gridSize = glm::ivec2{0, 0};
+  m_cellOffsets.clear();
+  m_cellRuns.clear();
+}
+
+void TextIndex::addRun(uint32_t runIndex,
+                       float minY,
+                       float maxY,
+                       float const * carets,
+                       size_t caretsCount) {
+  if (caretsCount < 2) {
+    return;
+  }
+  Run run;
+  run.m_runIndex = runIndex;
+  run.m_min = glm::vec2(carets[0], minY);
+  run.m_max = glm::vec2(carets[caretsCount - 1], maxY);
+  run.m_caretsOffset = static_cast<uint32_t>(m_carets.size());
+  run.m_caretsCount = static_cast<uint32_t>(caretsCount);
+  m_runs.push_back(run);
+  m_carets.insert(m_carets.end(), carets, carets + caretsCount);
+}
+
+glm::ivec2 TextIndex::getCell(glm::vec2 const & p) const {
+  auto const c = (p - m_gridOrigin) / m_cellSize;
+  return glm::ivec2{std::clamp(static_cast<int32_t>(std::floor(c.x)), 0, m_gridSize.x - 1),
+                    std::clamp(static_cast<int32_t>(std::floor(c.y)), 0, m_gridSize.y - 1)};
+}
+
+void TextIndex::build() {
+  m_cellOffsets.clear();
+  m_cellRuns.clear();
+  if (m_runs.empty()) {
+    m_gridSize = glm::ivec2{0, 0};
+    return;
+  }
+
+  // Cells are about the size of an average run, so every run falls into a few cells.
+  glm::vec2 minCorner(std::numeric_limits<float>::max());
+  glm::vec2 maxCorner(std::numeric_limits<float>::lowest());
+  glm::vec2 averageSize(0.0f, 0.0f);
+  for (auto const & run : m_runs) {
+    minCorner = glm::min(minCorner, run.m_min);
+    maxCorner = glm::max(maxCorner, run.m_max);
+    averageSize += run.m_max - run.m_min;
+  }
+  averageSize /= static_cast<float>(m_runs.size());
+  auto const extent = glm::max(maxCorner - minCorner, glm::vec2(1.0f, 1.0f));
+  m_gridOrigin = minCorner;
+  m_cellSize = glm::max(glm::max(averageSize, extent / static_cast<float>(kMaxGridDimension)),
+                        glm::vec2(1.0f, 1.0f));
+  m_gridSize = glm::ivec2{
+    std::clamp(static_cast<int32_t>(std::ceil(extent.x / m_cellSize.x)), 1, kMaxGridDimension),
+    std::clamp(static_cast<int32_t>(std::ceil(extent.y / m_cellSize.y)), 1, kMaxGridDimension)};
+
+  // Counting sort of runs into cells.
+  auto const cellsCount = static_cast<size_t>(m_gridSize.x) * m_gridSize.y;
+  m_cellOffsets.assign(cellsCount + 1, 0);
+  auto forEachCell = [this](Run const & run, auto const & func) {
+    auto const c0 = getCell(run.m_min);
+    auto const c1 = getCell(run.m_max);
+    for (int32_t y = c0.y; y <= c1.y; ++y) {
+      for (int32_t x = c0.x; x <= c1.x; ++x) {
+        func(static_cast<size_t>(y) * m_gridSize.x + x);
+      }
+    }
+  };
+  for (auto const & run : m_runs) {
+    forEachCell(run, [this](size_t cell) { m_cellOffsets[cell + 1]++; });
+  }
+  for (size_t i = 0; i < cellsCount; ++i) {
+    m_cellOffsets[i + 1] += m_cellOffsets[i];
+  }
+  m_cellRuns.resize(m_cellOffsets[cellsCount]);
+  std::vector<uint32_t> cursors(m_cellOffsets.begin(), m_cellOffsets.end() - 1);
+  for (uint32_t i = 0; i < static_cast<uint32_t>(m_runs.size()); ++i) {
+    forEachCell(m_runs[i], [&](size_t cell) { m_cellRuns[cursors[cell]++] = i; });
+  }
+}
+
+std::optional<uint32_t> TextIndex::findRun(glm::vec2 const & p) const {
+  if (m_gridSize.x == 0 || p.x < m_gridOrigin.x || p.y < m_gridOrigin.y) {
+    return std::nullopt;
+  }
+  auto const cell = getCell(p);
+  auto const cellIndex = static_cast<size_t>(cell.y) * m_gridSize.x + cell.x;
+  // Runs in a cell are in the order of addition, the last one is on top.
+  std::optional<uint32_t> result;
+  for (auto i = m_cellOffsets[cellIndex]; i < m_cellOffsets[cellIndex + 1]; ++i) {
+    auto const & run = m_runs[m_cellRuns[i]];
+    if (p.x >= run.m_min.x && p.x <= run.m_max.x && p.y >= run.m_min.y && p.y <= run.m_max.y) {
+      result = m_cellRuns[i];
+    }
+  }
+  return result;
+}
+
+std::optional<TextIndex::Hit> TextIndex::hitTest(glm::vec2 const & p) const {
+  auto const runIndex = findRun(p);
+  if (!runIndex) {
+    return std::nullopt;
+  }
+  auto const & run = m_runs[*runIndex];
+  auto const begin = m_carets.begin() + run.m_caretsOffset;
+  auto const end = begin + run.m_caretsCount;
+  // The first caret which is to the right of the point ends the character.
+  auto const it = std::upper_bound(begin, end, p.x);
+  auto const charIndex = std::clamp(static_cast<uint32_t>(it - begin), 1u, run.m_caretsCount - 1) - 1;
+  return Hit{run.m_runIndex, charIndex};
+}
+
+std::optional<TextIndex::Hit> TextIndex::hitTestCaret(glm::vec2 const & p) const {
+  auto const runIndex = findRun(p);
+  if (!runIndex) {
+    return std::nullopt;
+  }
+  auto const & run = m_runs[*runIndex];
+  auto const begin = m_carets.begin() + run.m_caretsOffset;
+  auto const end = begin + run.m_caretsCount;
+  auto it = std::lower_bound(begin, end, p.x);
+  if (it == end || (it != begin && p.x - *(it - 1) < *it - p.x)) {
+    --it;
+  }
+  return Hit{run.m_runIndex, static_cast<uint32_t>(it - begin)};
+}
+
+std::vector<TextIndex::RunRange> TextIndex::queryRect(glm::vec2 const & minCorner,
+                                                      glm::vec2 const & maxCorner) const {
+  std::vector<RunRange> result;
+  if (m_gridSize.x == 0) {
+    return result;
+  }
+  auto const c0 = getCell(minCorner);
+  auto const c1 = getCell(maxCorner);
+  std::vector<uint32_t> runs;
+  for (int32_t y = c0.y; y <= c1.y; ++y) {
+    for (int32_t x = c0.x; x <= c1.x; ++x) {
+      auto const cellIndex = static_cast<size_t>(y) * m_gridSize.x + x;
+      runs.insert(runs.end(),
+                  m_cellRuns.begin() + m_cellOffsets[cellIndex],
+                  m_cellRuns.begin() + m_cellOffsets[cellIndex + 1]);
+    }
+  }
+  // A run can span several cells.
+  std::sort(runs.begin(), runs.end());
+  runs.erase(std::unique(runs.begin(), runs.end()), runs.end());
+
+  for (auto i : runs) {
+    auto const & run = m_runs[i];
+    if (run.m_max.x < minCorner.x || run.m_min.x > maxCorner.x || run.m_max.y < minCorner.y ||
+        run.m_min.y > maxCorner.y) {
+      continue;
+    }
+    auto const begin = m_carets.begin() + run.m_caretsOffset;
+    auto const end = begin + run.m_caretsCount;
+    // Characters [i; i + 1) intersect if caret[i + 1] > min.x and caret[i] < max.x.
+    auto const first = std::upper_bound(begin + 1, end, minCorner.x) - (begin + 1);
+    auto const last = std::lower_bound(begin, end - 1, maxCorner.x) - begin;
+    if (first < last) {
+      result.push_back(RunRange{run.m_runIndex,
+                                static_cast<uint32_t>(first),
+                                static_cast<uint32_t>(last)});
+    }
+  }
+  return result;
+}
+
+}  // namespace sdf
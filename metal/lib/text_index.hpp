@@ -0,0 +1,86 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "common/glm_math.hpp"
+
+namespace sdf {
+
+// Spatial index of laid out runs for hit testing and selection. Runs are
+// bucketed into a uniform grid by their bounding boxes, characters inside a run
+// are found by binary search over caret positions.
+class TextIndex {
+public:
+  struct Hit {
+    uint32_t m_runIndex = 0;
+    // Index of the character under the point, or the closest caret position
+    // (0..charsCount) for caret placement.
+    uint32_t m_charIndex = 0;
+  };
+
+  struct RunRange {
+    uint32_t m_runIndex = 0;
+    // Characters [begin; end) which intersect the rect horizontally.
+    uint32_t m_charBegin = 0;
+    uint32_t m_charEnd = 0;
+  };
+
+  void clear();
+
+  // `carets` are x coordinates of character boundaries in ascending order, one
+  // more than the number of characters. The box spans the carets horizontally.
+  void addRun(uint32_t runIndex, float minY, float maxY, float const * carets, size_t caretsCount);
+
+  // Must be called after all runs are added and before queries.
+  void build();
+
+  size_t getRunsCount() const { return m_runs.size(); }
+
+  // Returns the character which contains the point.
+  std::optional<Hit> hitTest(glm::vec2 const & p) const;
+  // Returns the closest caret position in the run which contains the point.
+  std::optional<Hit> hitTestCaret(glm::vec2 const & p) const;
+  // Returns all runs which intersect the rect, in the order they were added.
+  std::vector<RunRange> queryRect(glm::vec2 const & minCorner, glm::vec2 const & maxCorner) const;
+
+private:
+  struct Run {
+    uint32_t m_runIndex;
+    glm::vec2 m_min;
+    glm::vec2 m_max;
+    uint32_t m_caretsOffset;
+    uint32_t m_caretsCount;
+  };
+
+  std::optional<uint32_t> findRun(glm::vec2 const & p) const;
+  glm::ivec2 getCell(glm::vec2 const & p) const;
+
+  std::vector<Run> m_runs;
+  std::vector<float> m_carets;
+
+  // Grid in compressed rows: runs of the cell (x, y) are
+  // m_cellRuns[m_cellOffsets[y * w + x], m_cellOffsets[y * w + x + 1]).
+  glm::vec2 m_gridOrigin = glm::vec2(0.0f, 0.0f);
+  glm::vec2 m_cellSize = glm::vec2(1.0f, 1.0f);
+  glm::ivec2 m_gridSize = glm::ivec2{0, 0};
+  std::vector<uint32_t> m_cellOffsets;
+  std::vector<uint32_t> m_cellRuns;
+};
+
+}  // namespace sdf
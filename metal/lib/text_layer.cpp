@@ -0,0 +1,221 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_layer.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "common/utils.hpp"
+
+namespace sdf::gpu {
+
+TextLayer::~TextLayer() {
+  if (m_texture) {
+    m_texture->release();
+  }
+
+  if (m_compositePipelineState) {
+    m_compositePipelineState->release();
+  }
+}
+
+bool TextLayer::initialize(MTL::Device * const device,
+                           MTL::Library * library,
+                           uint32_t maxFramesInFlight /* = 3 */) {
+  if (!m_renderer.initialize(device, library, maxFramesInFlight, true /* premultipliedAlpha */)) {
+    return false;
+  }
+
+  // Initialize shaders.
+  MTL::FunctionConstantValues * constantValues = MTL::FunctionConstantValues::alloc()->init();
+  METAL_GUARD(constantValues);
+
+  NS::Error * error = nullptr;
+  MTL::Function * vsFunction = library->newFunction(STR("vertexLayer"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(vsFunction);
+
+  MTL::Function * fsFunction = library->newFunction(STR("fragmentLayer"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(fsFunction);
+
+  // Initialize pipeline state, the layer texture has premultiplied alpha.
+  auto pipelineStateDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
+  pipelineStateDescriptor->setLabel(STR("Text Layer Composite Pipeline State"));
+  METAL_GUARD(pipelineStateDescriptor);
+  pipelineStateDescriptor->setVertexFunction(vsFunction);
+  pipelineStateDescriptor->setFragmentFunction(fsFunction);
+  pipelineStateDescriptor->setSampleCount(1);
+  auto colorAttachment = pipelineStateDescriptor->colorAttachments()->object(0);
+  colorAttachment->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
+  colorAttachment->setBlendingEnabled(true);
+  colorAttachment->setRgbBlendOperation(MTL::BlendOperationAdd);
+  colorAttachment->setAlphaBlendOperation(MTL::BlendOperationAdd);
+  colorAttachment->setSourceRGBBlendFactor(MTL::BlendFactorOne);
+  colorAttachment->setSourceAlphaBlendFactor(MTL::BlendFactorOne);
+  colorAttachment->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
+  colorAttachment->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
+
+  m_compositePipelineState = device->newRenderPipelineState(pipelineStateDescriptor, &error);
+  CHECK_AND_RETURN(error, false);
+
+  return true;
+}
+
+void TextLayer::setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas) {
+  m_renderer.setGlyphAtlas(glyphAtlas);
+  m_glyphAtlas = std::move(glyphAtlas);
+}
+
+void TextLayer::clear() {
+  m_runs.clear();
+  m_runsHash = 0;
+}
+
+void TextLayer::addText(std::string const & s,
+                        glm::vec2 const & leftTop,
+                        glm::vec2 const & size,
+                        glm::vec4 const & color) {
+  utils::hashCombine(m_runsHash,
+                     s,
+                     leftTop.x,
+                     leftTop.y,
+                     size.x,
+                     size.y,
+                     color.r,
+                     color.g,
+                     color.b,
+                     color.a);
+  m_runs.push_back(Run{s, leftTop, size, color});
+}
+
+glm::uvec2 TextLayer::getTextureSize() const {
+  return glm::uvec2{std::max(static_cast<uint32_t>(std::ceil(m_size.x * m_scale)), 1u),
+                    std::max(static_cast<uint32_t>(std::ceil(m_size.y * m_scale)), 1u)};
+}
+
+size_t TextLayer::getContentHash() const {
+  size_t hash = m_runsHash;
+  utils::hashCombine(hash, m_size.x, m_size.y, m_scale, m_glyphAtlas.get());
+  return hash;
+}
+
+void TextLayer::update(MTL::Device * const device, MTL::CommandBuffer * commandBuffer) {
+  if (m_glyphAtlas == nullptr) {
+    return;
+  }
+  auto const hash = getContentHash();
+  if (m_texture != nullptr && hash == m_renderedHash) {
+    return;
+  }
+
+  auto const textureSize = getTextureSize();
+  if (m_texture == nullptr || m_texture->width() != textureSize.x ||
+      m_texture->height() != textureSize.y) {
+    // Command buffers retain textures they use, in-flight frames keep the old one alive.
+    if (m_texture != nullptr) {
+      m_texture->release();
+    }
+    MTL::TextureDescriptor * descriptor = MTL::TextureDescriptor::alloc()->init();
+    descriptor->setTextureType(MTL::TextureType2D);
+    descriptor->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
+    descriptor->setWidth(textureSize.x);
+    descriptor->setHeight(textureSize.y);
+    descriptor->setMipmapLevelCount(1);
+    descriptor->setStorageMode(MTL::StorageModePrivate);
+    descriptor->setUsage(MTL::TextureUsageRenderTarget | MTL::TextureUsageShaderRead);
+    METAL_GUARD(descriptor);
+
+    m_texture = device->newTexture(descriptor);
+    m_texture->setLabel(STR("Text Layer Texture"));
+  }
+
+  m_renderer.beginLayouting();
+  for (auto const & run : m_runs) {
+    m_renderer.addText(run.m_text, run.m_leftTop * m_scale, run.m_size * m_scale, run.m_color);
+  }
+  m_renderer.endLayouting(device);
+
+  auto renderPassDescriptor = MTL::RenderPassDescriptor::renderPassDescriptor();
+  auto colorAttachment = renderPassDescriptor->colorAttachments()->object(0);
+  colorAttachment->setTexture(m_texture);
+  colorAttachment->setClearColor(MTL::ClearColor::Make(0.0, 0.0, 0.0, 0.0));
+  colorAttachment->setLoadAction(MTL::LoadAction::LoadActionClear);
+  colorAttachment->setStoreAction(MTL::StoreAction::StoreActionStore);
+
+  MTL::RenderCommandEncoder * encoder = commandBuffer->renderCommandEncoder(renderPassDescriptor);
+  encoder->setLabel(STR("Text Layer Command Encoder"));
+  m_renderer.render(glm::vec2(textureSize), encoder);
+  encoder->endEncoding();
+
+  m_renderedHash = hash;
+  m_rendersCount++;
+}
+
+void TextLayer::render(glm::vec2 const & screenSize, MTL::RenderCommandEncoder * commandEncoder) {
+  if (m_texture == nullptr) {
+    return;
+  }
+  FrameData frameData;
+  auto const m = glm::ortho(0.0f, screenSize.x, 0.0f, screenSize.y);
+  memcpy(&frameData.projection, glm::value_ptr(m), sizeof(m));
+
+  // Texels are mapped 1:1 to pixels, so the quad is placed at whole pixels.
+  auto const halfSize = glm::vec2(getTextureSize()) * 0.5f;
+  auto const position = glm::vec2(std::round(m_position.x), std::round(m_position.y));
+  Glyph quad{
+    .center = make_packed_float2(position + halfSize),
+    .halfSize = make_packed_float2(halfSize),
+    .uvCenter = make_packed_float2(glm::vec2(0.5f, 0.5f)),
+    .uvHalfSize = make_packed_float2(glm::vec2(0.5f, 0.5f)),
+    .color = make_packed_float4(glm::vec4(1.0f, 1.0f, 1.0f, m_opacity)),
+  };
+
+  commandEncoder->setRenderPipelineState(m_compositePipelineState);
+  commandEncoder->setVertexBytes(&frameData, sizeof(frameData), TextRenderBufferFrame);
+  commandEncoder->setVertexBytes(&quad, sizeof(quad), TextRenderBufferGlyphs);
+  commandEncoder->setFragmentTexture(m_texture, TextRenderTextureGlyphs);
+  commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
+                                 0 /* vertexStart */,
+                                 4 /* vertexCount */);
+}
+
+std::vector<uint8_t> TextLayer::rasterize(GlyphSet const & glyphSet,
+                                          cpu::TextRasterizer::Atlas const & sdfAtlas) const {
+  // Renderer which is not initialized can still lay out text.
+  TextRenderer renderer;
+  renderer.beginLayouting();
+  for (auto const & run : m_runs) {
+    renderer.addText(run.m_text,
+                     run.m_leftTop * m_scale,
+                     run.m_size * m_scale,
+                     run.m_color,
+                     glyphSet);
+  }
+
+  auto const textureSize = getTextureSize();
+  std::vector<uint8_t> image(static_cast<size_t>(textureSize.x) * textureSize.y * 4, 0);
+  cpu::TextRasterizer::drawSdfGlyphs(renderer.getSdfGlyphs(), sdfAtlas, textureSize, image.data());
+
+  auto const & coverageAtlas = renderer.getCoverageAtlas();
+  cpu::TextRasterizer::drawCoverageGlyphs(
+    renderer.getCoverageGlyphs(),
+    cpu::TextRasterizer::Atlas{coverageAtlas.getTexels().data(), coverageAtlas.getAtlasSize()},
+    textureSize,
+    image.data());
+  return image;
+}
+
+}  // namespace sdf::gpu
@@ -0,0 +1,95 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glyph_atlas.hpp"
+#include "text_rasterizer_cpu.hpp"
+#include "text_renderer.hpp"
+
+namespace sdf::gpu {
+
+// A group of static runs which is rendered once into an offscreen texture and
+// then composited as a single quad. The texture is re-rendered only when runs,
+// size, scale or glyph atlas change; moving the layer is free.
+class TextLayer {
+public:
+  ~TextLayer();
+
+  // The inner text renderer keeps its instances for `maxFramesInFlight` updates.
+  bool initialize(MTL::Device * const device,
+                  MTL::Library * library,
+                  uint32_t maxFramesInFlight = 3);
+
+  void setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas);
+
+  // Runs are in layer coordinates, (0, 0) is the left-bottom corner of the layer.
+  void clear();
+  void addText(std::string const & s,
+               glm::vec2 const & leftTop,
+               glm::vec2 const & size,
+               glm::vec4 const & color);
+
+  // Size in layer coordinates, the texture is `size * scale` pixels.
+  void setSize(glm::vec2 const & size) { m_size = size; }
+  void setScale(float scale) { m_scale = scale; }
+  // Left-bottom corner of the layer on the screen, in pixels.
+  void setPosition(glm::vec2 const & position) { m_position = position; }
+  void setOpacity(float opacity) { m_opacity = opacity; }
+
+  uint32_t getRendersCount() const { return m_rendersCount; }
+
+  // Re-renders the layer texture if it's out of date. Must be called before
+  // render encoders of the frame which draws the layer are created.
+  void update(MTL::Device * const device, MTL::CommandBuffer * commandBuffer);
+  void render(glm::vec2 const & screenSize, MTL::RenderCommandEncoder * commandEncoder);
+
+  // Renders the layer on CPU with the same layout, no Metal device is needed.
+  // Returns premultiplied RGBA8 pixels, the top row first.
+  std::vector<uint8_t> rasterize(GlyphSet const & glyphSet,
+                                 cpu::TextRasterizer::Atlas const & sdfAtlas) const;
+
+private:
+  struct Run {
+    std::string m_text;
+    glm::vec2 m_leftTop;
+    glm::vec2 m_size;
+    glm::vec4 m_color;
+  };
+
+  glm::uvec2 getTextureSize() const;
+  size_t getContentHash() const;
+
+  TextRenderer m_renderer;
+  std::shared_ptr<GlyphAtlas const> m_glyphAtlas;
+  std::vector<Run> m_runs;
+  size_t m_runsHash = 0;
+
+  glm::vec2 m_size = glm::vec2(0.0f, 0.0f);
+  float m_scale = 1.0f;
+  glm::vec2 m_position = glm::vec2(0.0f, 0.0f);
+  float m_opacity = 1.0f;
+
+  MTL::Texture * m_texture = nullptr;
+  MTL::RenderPipelineState * m_compositePipelineState = nullptr;
+  size_t m_renderedHash = 0;
+  uint32_t m_rendersCount = 0;
+};
+
+}  // namespace sdf::gpu
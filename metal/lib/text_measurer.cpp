@@ -0,0 +1,160 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_measurer.hpp"
+
+#include <algorithm>
+
+namespace sdf {
+
+TextMeasurer::TextMeasurer(GlyphSet const & glyphSet) : m_baseFontSize(glyphSet.getBaseFontSize()) {
+  auto const & glyphs = glyphSet.getGlyphs();
+  auto const spaceIt = glyphs.find(' ');
+  for (size_t i = 0; i < kTableSize; ++i) {
+    // The same lookup as in TextRenderer::addText, missing chars are drawn as spaces.
+    auto it = glyphs.find(static_cast<char>(i));
+    if (it == glyphs.end()) {
+      it = spaceIt;
+    }
+    if (it == glyphs.end()) {
+      continue;
+    }
+    auto const & glyphData = it->second;
+    m_advances[i] = glyphData.m_advance;
+    m_left[i] = glyphData.m_offset.x;
+    m_right[i] = glyphData.m_offset.x + glyphData.m_size.x;
+    m_bottom[i] = glyphData.m_offset.y;
+    m_top[i] = glyphData.m_offset.y + glyphData.m_size.y;
+  }
+}
+
+TextMeasurer::Metrics TextMeasurer::measure(std::string_view s) const {
+  Metrics metrics;
+  if (s.empty()) {
+    return metrics;
+  }
+
+  // Vertical bounds don't depend on the pen, so they are reduced independently
+  // in 4 lanes which the compiler can keep in vector registers.
+  size_t constexpr kLanes = 4;
+  std::array<float, kLanes> advance = {};
+  std::array<float, kLanes> bottom;
+  std::array<float, kLanes> top;
+  bottom.fill(m_bottom[getIndex(s[0])]);
+  top.fill(m_top[getIndex(s[0])]);
+  size_t i = 0;
+  for (; i + kLanes <= s.size(); i += kLanes) {
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      auto const c = getIndex(s[i + lane]);
+      advance[lane] += m_advances[c];
+      bottom[lane] = std::min(bottom[lane], m_bottom[c]);
+      top[lane] = std::max(top[lane], m_top[c]);
+    }
+  }
+  for (; i < s.size(); ++i) {
+    auto const c = getIndex(s[i]);
+    advance[0] += m_advances[c];
+    bottom[0] = std::min(bottom[0], m_bottom[c]);
+    top[0] = std::max(top[0], m_top[c]);
+  }
+  metrics.m_advance = (advance[0] + advance[1]) + (advance[2] + advance[3]);
+  metrics.m_min.y = std::min(std::min(bottom[0], bottom[1]), std::min(bottom[2], bottom[3]));
+  metrics.m_max.y = std::max(std::max(top[0], top[1]), std::max(top[2], top[3]));
+
+  // Horizontal bounds depend on the pen position, glyphs can overhang their advances.
+  float penX = 0.0f;
+  metrics.m_min.x = m_left[getIndex(s[0])];
+  metrics.m_max.x = m_right[getIndex(s[0])];
+  for (auto ch : s) {
+    auto const c = getIndex(ch);
+    metrics.m_min.x = std::min(metrics.m_min.x, penX + m_left[c]);
+    metrics.m_max.x = std::max(metrics.m_max.x, penX + m_right[c]);
+    penX += m_advances[c];
+  }
+  return metrics;
+}
+
+float TextMeasurer::getAdvance(std::string_view s) const {
+  size_t constexpr kLanes = 4;
+  std::array<float, kLanes> advance = {};
+  size_t i = 0;
+  for (; i + kLanes <= s.size(); i += kLanes) {
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      advance[lane] += m_advances[getIndex(s[i + lane])];
+    }
+  }
+  for (; i < s.size(); ++i) {
+    advance[0] += m_advances[getIndex(s[i])];
+  }
+  return (advance[0] + advance[1]) + (advance[2] + advance[3]);
+}
+
+void TextMeasurer::measure(std::vector<std::string> const & strings,
+                           std::vector<Metrics> & metrics) const {
+  metrics.resize(strings.size());
+  for (size_t i = 0; i < strings.size(); ++i) {
+    metrics[i] = measure(strings[i]);
+  }
+}
+
+glm::vec2 TextMeasurer::getLayoutSize(std::string_view s) const {
+  // addText fits advances and tops of all chars but the last one.
+  glm::vec2 size(0.0f, 0.0f);
+  for (size_t i = 0; i + 1 < s.size(); ++i) {
+    auto const c = getIndex(s[i]);
+    size.x += m_advances[c];
+    size.y = std::max(size.y, m_top[c]);
+  }
+  return size;
+}
+
+void TextMeasurer::getPrefixAdvances(std::string_view s, std::vector<float> & advances) const {
+  advances.resize(s.size() + 1);
+  advances[0] = 0.0f;
+  for (size_t i = 0; i < s.size(); ++i) {
+    advances[i + 1] = advances[i] + m_advances[getIndex(s[i])];
+  }
+}
+
+size_t TextMeasurer::getFittingCharsCount(std::string_view s, float width) const {
+  thread_local std::vector<float> advances;
+  getPrefixAdvances(s, advances);
+  // Advances are non-decreasing, the first one which exceeds the width ends the prefix.
+  auto const it = std::upper_bound(advances.begin(), advances.end(), width);
+  if (it == advances.begin()) {
+    return 0;
+  }
+  return static_cast<size_t>(it - advances.begin()) - 1;
+}
+
+std::string TextMeasurer::truncate(std::string_view s,
+                                   float width,
+                                   std::string_view ellipsis /* = "..." */) const {
+  thread_local std::vector<float> advances;
+  getPrefixAdvances(s, advances);
+  if (advances.back() <= width) {
+    return std::string(s);
+  }
+  auto const ellipsisWidth = measure(ellipsis).m_advance;
+  auto const it = std::upper_bound(advances.begin(), advances.end(), width - ellipsisWidth);
+  if (it == advances.begin()) {
+    return std::string();
+  }
+  auto const count = static_cast<size_t>(it - advances.begin()) - 1;
+  std::string result(s.substr(0, count));
+  result.append(ellipsis);
+  return result;
+}
+
+}  // namespace sdf
@@ -0,0 +1,74 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/glm_math.hpp"
+#include "glyph_set.hpp"
+
+namespace sdf {
+
+// Measures strings without laying them out. Metrics of all chars are copied to
+// flat tables, so measuring is a loop of table lookups. All sizes are in base
+// font units of the glyph set, multiply by (font size / base font size) to get pixels.
+class TextMeasurer {
+public:
+  struct Metrics {
+    // Sum of advances of all chars.
+    float m_advance = 0.0f;
+    // Ink bounds relative to the pen origin, y goes up.
+    glm::vec2 m_min = glm::vec2(0.0f, 0.0f);
+    glm::vec2 m_max = glm::vec2(0.0f, 0.0f);
+  };
+
+  explicit TextMeasurer(GlyphSet const & glyphSet);
+
+  uint32_t getBaseFontSize() const { return m_baseFontSize; }
+
+  Metrics measure(std::string_view s) const;
+  // Sum of advances only, cheaper than measure.
+  float getAdvance(std::string_view s) const;
+  void measure(std::vector<std::string> const & strings, std::vector<Metrics> & metrics) const;
+
+  // Size of the box TextRenderer::addText fits the string into. addText with
+  // size = getLayoutSize(s) * scale draws the string with exactly this scale.
+  glm::vec2 getLayoutSize(std::string_view s) const;
+
+  // Pen positions before each char and after the last one (s.size() + 1 values).
+  void getPrefixAdvances(std::string_view s, std::vector<float> & advances) const;
+  // Number of leading chars whose advances fit into `width`.
+  size_t getFittingCharsCount(std::string_view s, float width) const;
+  // Returns `s` if it fits into `width`, otherwise the longest prefix which
+  // fits together with the ellipsis.
+  std::string truncate(std::string_view s, float width, std::string_view ellipsis = "...") const;
+
+private:
+  static size_t constexpr kTableSize = 256;
+
+  static uint8_t getIndex(char c) { return static_cast<uint8_t>(c); }
+
+  uint32_t m_baseFontSize = 0;
+  std::array<float, kTableSize> m_advances = {};
+  std::array<float, kTableSize> m_left = {};
+  std::array<float, kTableSize> m_right = {};
+  std::array<float, kTableSize> m_bottom = {};
+  std::array<float, kTableSize> m_top = {};
+};
+
+}  // namespace sdf
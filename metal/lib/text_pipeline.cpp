@@ -0,0 +1,48 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_pipeline.hpp"
+
+#include "common/utils.hpp"
+
+namespace sdf::gpu {
+
+MTL::RenderPipelineState * createTextPipelineState(MTL::Device * const device,
+                                                   MTL::Function * vsFunction,
+                                                   MTL::Function * fsFunction,
+                                                   NS::String * label,
+                                                   bool premultipliedAlpha,
+                                                   NS::Error ** error) {
+  auto pipelineStateDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
+  pipelineStateDescriptor->setLabel(label);
+  METAL_GUARD(pipelineStateDescriptor);
+  pipelineStateDescriptor->setVertexFunction(vsFunction);
+  pipelineStateDescriptor->setFragmentFunction(fsFunction);
+  pipelineStateDescriptor->setSampleCount(1);
+  auto colorAttachment = pipelineStateDescriptor->colorAttachments()->object(0);
+  colorAttachment->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
+  colorAttachment->setBlendingEnabled(true);
+  colorAttachment->setRgbBlendOperation(MTL::BlendOperationAdd);
+  colorAttachment->setAlphaBlendOperation(MTL::BlendOperationAdd);
+  colorAttachment->setSourceRGBBlendFactor(MTL::BlendFactorSourceAlpha);
+  // Premultiplied output keeps coverage in alpha: a + dst.a * (1 - a).
+  colorAttachment->setSourceAlphaBlendFactor(premultipliedAlpha ? MTL::BlendFactorOne
+                                                                : MTL::BlendFactorSourceAlpha);
+  colorAttachment->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
+  colorAttachment->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
+
+  return device->newRenderPipelineState(pipelineStateDescriptor, error);
+}
+
+}  // namespace sdf::gpu
@@ -0,0 +1,31 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <Metal/Metal.hpp>
+
+namespace sdf::gpu {
+
+// Pipeline state which draws glyph instances (see sdf_text.metal) with alpha blending
+// into a BGRA8 target. Premultiplied output is suitable for offscreen layers which
+// are composited later (see TextLayer).
+MTL::RenderPipelineState * createTextPipelineState(MTL::Device * const device,
+                                                   MTL::Function * vsFunction,
+                                                   MTL::Function * fsFunction,
+                                                   NS::String * label,
+                                                   bool premultipliedAlpha,
+                                                   NS::Error ** error);
+
+}  // namespace sdf::gpu
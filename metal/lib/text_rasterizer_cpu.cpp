@@ -0,0 +1,131 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_rasterizer_cpu.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sdf::cpu {
+namespace {
+float sampleLinear(TextRasterizer::Atlas const & atlas, glm::vec2 const & uv) {
+  // Clamp to edge, texel centers are at half-integer coordinates.
+  auto const x = std::clamp(uv.x * static_cast<float>(atlas.m_size.x) - 0.5f,
+                            0.0f,
+                            static_cast<float>(atlas.m_size.x - 1));
+  auto const y = std::clamp(uv.y * static_cast<float>(atlas.m_size.y) - 0.5f,
+                            0.0f,
+                            static_cast<float>(atlas.m_size.y - 1));
+  auto const x0 = static_cast<uint32_t>(x);
+  auto const y0 = static_cast<uint32_t>(y);
+  auto const x1 = std::min(x0 + 1, atlas.m_size.x - 1);
+  auto const y1 = std::min(y0 + 1, atlas.m_size.y - 1);
+  auto const fx = x - static_cast<float>(x0);
+  auto const fy = y - static_cast<float>(y0);
+  auto texel = [&](uint32_t i, uint32_t j) {
+    return static_cast<float>(atlas.m_texels[static_cast<size_t>(j) * atlas.m_size.x + i]) / 255.0f;
+  };
+  auto const top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * fx;
+  auto const bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * fx;
+  return top + (bottom - top) * fy;
+}
+
+float sampleNearest(TextRasterizer::Atlas const & atlas, glm::vec2 const & uv) {
+  auto const x = std::min(static_cast<uint32_t>(std::max(uv.x * atlas.m_size.x, 0.0f)),
+                          atlas.m_size.x - 1);
+  auto const y = std::min(static_cast<uint32_t>(std::max(uv.y * atlas.m_size.y, 0.0f)),
+                          atlas.m_size.y - 1);
+  return static_cast<float>(atlas.m_texels[static_cast<size_t>(y) * atlas.m_size.x + x]) / 255.0f;
+}
+
+float smoothstep(float edge0, float edge1, float x) {
+  auto const t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+  return t * t * (3.0f - 2.0f * t);
+}
+
+// Calls `shade(uv, screenPos)` for every pixel whose center is inside the glyph
+// quad and blends the returned alpha with the glyph color.
+template <typename Shade>
+void drawGlyphs(std::vector<Glyph> const & glyphs,
+                glm::uvec2 const & imageSize,
+                uint8_t * image,
+                Shade const & shade) {
+  for (auto const & g : glyphs) {
+    auto const center = glm::vec2(g.center.x, g.center.y);
+    auto const halfSize = glm::vec2(g.halfSize.x, g.halfSize.y);
+    if (halfSize.x <= 0.0f || halfSize.y <= 0.0f) {
+      continue;
+    }
+    auto const uvCenter = glm::vec2(g.uvCenter.x, g.uvCenter.y);
+    auto const uvHalfSize = glm::vec2(g.uvHalfSize.x, g.uvHalfSize.y);
+    // Same interpolation as in vertexText, texture v goes down.
+    auto const getUv = [&](glm::vec2 const & p) {
+      auto const q = (p - center) / halfSize;
+      return uvCenter + glm::vec2(q.x * uvHalfSize.x, -q.y * uvHalfSize.y);
+    };
+
+    auto const minX = std::max(static_cast<int>(std::ceil(center.x - halfSize.x - 0.5f)), 0);
+    auto const maxX = std::min(static_cast<int>(std::ceil(center.x + halfSize.x - 0.5f)),
+                               static_cast<int>(imageSize.x));
+    auto const minY = std::max(static_cast<int>(std::ceil(center.y - halfSize.y - 0.5f)), 0);
+    auto const maxY = std::min(static_cast<int>(std::ceil(center.y + halfSize.y - 0.5f)),
+                               static_cast<int>(imageSize.y));
+    for (int y = minY; y < maxY; ++y) {
+      auto row = image + static_cast<size_t>(imageSize.y - 1 - y) * imageSize.x * 4;
+      for (int x = minX; x < maxX; ++x) {
+        auto const p = glm::vec2(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+        auto const alpha = g.color.w * shade(getUv, p);
+        // Premultiplied "over".
+        auto pixel = row + x * 4;
+        float const color[4] = {g.color.x * alpha, g.color.y * alpha, g.color.z * alpha, alpha};
+        for (int c = 0; c < 4; ++c) {
+          auto const dst = static_cast<float>(pixel[c]) / 255.0f;
+          auto const v = color[c] + dst * (1.0f - alpha);
+          pixel[c] = static_cast<uint8_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+      }
+    }
+  }
+}
+}  // namespace
+
+// static
+void TextRasterizer::drawSdfGlyphs(std::vector<Glyph> const & glyphs,
+                                   Atlas const & sdfAtlas,
+                                   glm::uvec2 const & imageSize,
+                                   uint8_t * image) {
+  drawGlyphs(glyphs, imageSize, image, [&](auto const & getUv, glm::vec2 const & p) {
+    auto const dist = sampleLinear(sdfAtlas, getUv(p));
+    // Forward differences instead of dfdx/dfdy.
+    auto const dx = sampleLinear(sdfAtlas, getUv(p + glm::vec2(1.0f, 0.0f))) - dist;
+    auto const dy = sampleLinear(sdfAtlas, getUv(p + glm::vec2(0.0f, 1.0f))) - dist;
+    auto const edgeWidth = std::sqrt(dx * dx + dy * dy);
+    if (edgeWidth == 0.0f) {
+      return dist < 0.75f ? 0.0f : 1.0f;
+    }
+    return smoothstep(0.75f - edgeWidth, 0.75f + edgeWidth, dist);
+  });
+}
+
+// static
+void TextRasterizer::drawCoverageGlyphs(std::vector<Glyph> const & glyphs,
+                                        Atlas const & coverageAtlas,
+                                        glm::uvec2 const & imageSize,
+                                        uint8_t * image) {
+  drawGlyphs(glyphs, imageSize, image, [&](auto const & getUv, glm::vec2 const & p) {
+    return sampleNearest(coverageAtlas, getUv(p));
+  });
+}
+
+}  // namespace sdf::cpu
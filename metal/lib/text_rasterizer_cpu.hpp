@@ -0,0 +1,47 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common/glm_math.hpp"
+#include "sdf_text_types.h"
+
+namespace sdf::cpu {
+
+// Reference rasterizer of glyph instances, the CPU counterpart of vertexText,
+// fragmentText and fragmentTextCoverage shaders. Useful for headless rendering
+// and for checking GPU output. Produces premultiplied RGBA8 pixels, the first
+// row is the top one (screen y goes up, as in the shaders' projection).
+class TextRasterizer {
+public:
+  struct Atlas {
+    uint8_t const * m_texels = nullptr;
+    glm::uvec2 m_size = glm::uvec2{0, 0};
+  };
+
+  // Glyphs are drawn over `image` (imageSize.x * imageSize.y * 4 bytes).
+  static void drawSdfGlyphs(std::vector<Glyph> const & glyphs,
+                            Atlas const & sdfAtlas,
+                            glm::uvec2 const & imageSize,
+                            uint8_t * image);
+  static void drawCoverageGlyphs(std::vector<Glyph> const & glyphs,
+                                 Atlas const & coverageAtlas,
+                                 glm::uvec2 const & imageSize,
+                                 uint8_t * image);
+};
+
+}  // namespace sdf::cpu
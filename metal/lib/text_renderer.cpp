@@ -15,28 +15,394 @@
 #include "text_renderer.hpp"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 #include "common/utils.hpp"
+#include "parallel_for.hpp"
+#include "text_pipeline.hpp"
 
 namespace sdf::gpu {
 
 uint32_t constexpr kGlyphBufferDefaultSize = 1000;
+uint32_t constexpr kStampBufferDefaultSize = 256;
+// Fewer recorded instances are merged on the calling thread, starting threads costs more.
+size_t constexpr kParallelMergeMinGlyphs = 16384;
+
+namespace {
+// Position of laid out text.
+struct TextPlacement {
+  // Pen position of the first glyph.
+  glm::vec2 m_origin = glm::vec2(0.0f, 0.0f);
+  float m_scale = 1.0f;
+  // Font size in pixels.
+  uint32_t m_pixelSize = 0;
+};
+
+// Places every glyph directly into its instance and scales instances in a second
+// pass. It's faster than placeText for short runs, which have few repeated glyphs.
+TextPlacement placeTextInterleaved(std::string const & s,
+                                   glm::vec2 const & leftTop,
+                                   glm::vec2 const & size,
+                                   glm::vec4 const & color,
+                                   GlyphSet const & glyphSet,
+                                   std::vector<Glyph> & outGlyphs) {
+  auto const & glyphs = glyphSet.getGlyphs();
+
+  // Place glyphs.
+  outGlyphs.reserve(outGlyphs.size() + s.size());
+  auto const startIndex = outGlyphs.size();
+  float offsetX = 0.0f;
+  float maxY = 0.0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    auto it = glyphs.find(s[i]);
+    if (it == glyphs.end()) {
+      it = glyphs.find(' ');
+      METAL_ASSERT(it != glyphs.end());
+    }
+    auto const & glyphData = it->second;
+
+    auto const atlasSize = glm::vec2(glyphSet.getAtlasSize());
+    auto const halfSize = glyphData.m_size * 0.5f;
+    auto const uvHalfSize = glm::vec2(glyphData.m_pixelSize) * 0.5f / atlasSize;
+
+    Glyph g{
+      .center = make_packed_float2(glm::vec2(offsetX, 0.0f) + glyphData.m_offset + halfSize),
+      .halfSize = make_packed_float2(halfSize),
+      .uvCenter = make_packed_float2(glm::vec2(glyphData.m_posInAtlas) / atlasSize + uvHalfSize),
+      .uvHalfSize = make_packed_float2(
+        uvHalfSize - glm::vec2(GlyphSet::kBorderInPixels, GlyphSet::kBorderInPixels) / atlasSize),
+      .color = make_packed_float4(color),
+    };
+    outGlyphs.push_back(g);
+
+    if (i + 1 < s.size()) {
+      offsetX += glyphData.m_advance;
+      maxY = std::max(maxY, g.center.y + g.halfSize.y);
+    }
+  }
+
+  // Do simple layouting.
+  float const scale = std::min(size.x / offsetX, size.y / maxY);
+  float const layoutOffsetX = (size.x - offsetX * scale) * 0.5f;
+  float const layoutOffsetY = (size.y - maxY * scale) * 0.5f;
+  for (size_t i = startIndex; i < outGlyphs.size(); ++i) {
+    outGlyphs[i].center.x = leftTop.x + outGlyphs[i].center.x * scale + layoutOffsetX;
+    outGlyphs[i].center.y = leftTop.y + outGlyphs[i].center.y * scale + layoutOffsetY;
+    outGlyphs[i].halfSize.x *= scale;
+    outGlyphs[i].halfSize.y *= scale;
+  }
+
+  return TextPlacement{
+    .m_origin = glm::vec2(leftTop.x + layoutOffsetX, leftTop.y + layoutOffsetY),
+    .m_scale = scale,
+    .m_pixelSize =
+      static_cast<uint32_t>(std::lround(static_cast<float>(glyphSet.getBaseFontSize()) * scale)),
+  };
+}
+
+// Shorter runs are placed with placeTextInterleaved.
+size_t constexpr kPreparedGlyphsMinRunLength = 64;
+
+// Glyph data in the form placeText needs it, prepared once per distinct glyph of a run.
+struct PreparedGlyph {
+  float m_advance = 0.0f;
+  glm::vec2 m_center = glm::vec2(0.0f, 0.0f);
+  glm::vec2 m_halfSize = glm::vec2(0.0f, 0.0f);
+  packed_float2 m_uvCenter;
+  packed_float2 m_uvHalfSize;
+};
+
+// Structure of arrays which placeText computes instances in. Recorders lay out
+// text on many threads, so every thread has its own.
+struct LayoutScratch {
+  LayoutScratch() { m_preparedIndices.fill(-1); }
+
+  std::vector<PreparedGlyph> m_preparedGlyphs;
+  // Indices of prepared glyphs by character, -1 if not prepared yet. Only the
+  // entries of the previous run are cleared, which matters for short runs.
+  std::array<int16_t, 256> m_preparedIndices;
+  std::vector<uint8_t> m_preparedChars;
+  std::vector<uint8_t> m_glyphs;
+  std::vector<float> m_x;
+  std::vector<float> m_y;
+  std::vector<float> m_halfWidth;
+  std::vector<float> m_halfHeight;
+};
+thread_local LayoutScratch tLayoutScratch;
+
+// values[i] = values[i] * scale + offset, 4 values at a time.
+void transformValues(std::vector<float> & values, float scale, float offset) {
+  auto const v = values.data();
+  auto const count = values.size();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    simd_float4 x;
+    memcpy(&x, v + i, sizeof(x));
+    x = x * scale + offset;
+    memcpy(v + i, &x, sizeof(x));
+  }
+  for (; i < count; ++i) {
+    v[i] = v[i] * scale + offset;
+  }
+}
+
+// Appends instances of the glyphs of `s`, scaled to fit into the layout box and
+// centered in it. Glyphs are placed into separate arrays of coordinates, which
+// are transformed to the layout box with SIMD vectors and interleaved into
+// instances in one pass.
+TextPlacement placeText(std::string const & s,
+                        glm::vec2 const & leftTop,
+                        glm::vec2 const & size,
+                        glm::vec4 const & color,
+                        GlyphSet const & glyphSet,
+                        std::vector<Glyph> & outGlyphs) {
+  if (s.size() < kPreparedGlyphsMinRunLength) {
+    return placeTextInterleaved(s, leftTop, size, color, glyphSet, outGlyphs);
+  }
+
+  auto const & glyphs = glyphSet.getGlyphs();
+  auto const count = s.size();
+  auto & scratch = tLayoutScratch;
+  for (auto c : scratch.m_preparedChars) {
+    scratch.m_preparedIndices[c] = -1;
+  }
+  scratch.m_preparedChars.clear();
+  scratch.m_preparedGlyphs.clear();
+  scratch.m_glyphs.resize(count);
+  scratch.m_x.resize(count);
+  scratch.m_y.resize(count);
+  scratch.m_halfWidth.resize(count);
+  scratch.m_halfHeight.resize(count);
+
+  auto const invAtlasSize = glm::vec2(1.0f, 1.0f) / glm::vec2(glyphSet.getAtlasSize());
+  auto const border =
+    glm::vec2(GlyphSet::kBorderInPixels, GlyphSet::kBorderInPixels) * invAtlasSize;
+  auto prepareGlyph = [&](char c) {
+    auto it = glyphs.find(c);
+    if (it == glyphs.end()) {
+      it = glyphs.find(' ');
+      METAL_ASSERT(it != glyphs.end());
+    }
+    auto const & glyphData = it->second;
+    auto const halfSize = glyphData.m_size * 0.5f;
+    auto const uvHalfSize = glm::vec2(glyphData.m_pixelSize) * 0.5f * invAtlasSize;
+    scratch.m_preparedGlyphs.push_back(PreparedGlyph{
+      .m_advance = glyphData.m_advance,
+      .m_center = glyphData.m_offset + halfSize,
+      .m_halfSize = halfSize,
+      .m_uvCenter =
+        make_packed_float2(glm::vec2(glyphData.m_posInAtlas) * invAtlasSize + uvHalfSize),
+      .m_uvHalfSize = make_packed_float2(uvHalfSize - border),
+    });
+    return static_cast<int16_t>(scratch.m_preparedGlyphs.size() - 1);
+  };
+
+  // Place glyphs.
+  float offsetX = 0.0f;
+  float maxY = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    auto & index = scratch.m_preparedIndices[static_cast<uint8_t>(s[i])];
+    if (index < 0) {
+      index = prepareGlyph(s[i]);
+      scratch.m_preparedChars.push_back(static_cast<uint8_t>(s[i]));
+    }
+    auto const & prepared = scratch.m_preparedGlyphs[index];
+    scratch.m_glyphs[i] = static_cast<uint8_t>(index);
+    scratch.m_x[i] = offsetX + prepared.m_center.x;
+    scratch.m_y[i] = prepared.m_center.y;
+    scratch.m_halfWidth[i] = prepared.m_halfSize.x;
+    scratch.m_halfHeight[i] = prepared.m_halfSize.y;
+
+    if (i + 1 < count) {
+      offsetX += prepared.m_advance;
+      maxY = std::max(maxY, prepared.m_center.y + prepared.m_halfSize.y);
+    }
+  }
+
+  // Do simple layouting.
+  float const scale = std::min(size.x / offsetX, size.y / maxY);
+  float const originX = leftTop.x + (size.x - offsetX * scale) * 0.5f;
+  float const originY = leftTop.y + (size.y - maxY * scale) * 0.5f;
+
+  transformValues(scratch.m_x, scale, originX);
+  transformValues(scratch.m_y, scale, originY);
+  transformValues(scratch.m_halfWidth, scale, 0.0f);
+  transformValues(scratch.m_halfHeight, scale, 0.0f);
+
+  // Interleave into instances in place, in one pass.
+  auto const packedColor = make_packed_float4(color);
+  auto const startIndex = outGlyphs.size();
+  outGlyphs.resize(startIndex + count);
+  auto const out = outGlyphs.data() + startIndex;
+  for (size_t i = 0; i < count; ++i) {
+    auto const & prepared = scratch.m_preparedGlyphs[scratch.m_glyphs[i]];
+    out[i] = Glyph{
+      .center = packed_float2{scratch.m_x[i], scratch.m_y[i]},
+      .halfSize = packed_float2{scratch.m_halfWidth[i], scratch.m_halfHeight[i]},
+      .uvCenter = prepared.m_uvCenter,
+      .uvHalfSize = prepared.m_uvHalfSize,
+      .color = packedColor,
+    };
+  }
+
+  return TextPlacement{
+    .m_origin = glm::vec2(originX, originY),
+    .m_scale = scale,
+    .m_pixelSize =
+      static_cast<uint32_t>(std::lround(static_cast<float>(glyphSet.getBaseFontSize()) * scale)),
+  };
+}
+
+// Appends one bar per word of `s`, drawn from the solid texel at `barUv`.
+void addGreekedText(std::string const & s,
+                    GlyphSet const & glyphSet,
+                    glm::vec2 const & origin,
+                    float scale,
+                    glm::vec4 const & color,
+                    glm::vec2 const & barUv,
+                    std::vector<Glyph> & outBars) {
+  auto const & glyphs = glyphSet.getGlyphs();
+
+  // Bars are as high as lowercase letters and half transparent, which is close
+  // to the ink density of real text.
+  auto const xIt = glyphs.find('x');
+  auto const barHeight = xIt != glyphs.end()
+                           ? xIt->second.m_offset.y + xIt->second.m_size.y
+                           : static_cast<float>(glyphSet.getBaseFontSize()) * 0.5f;
+  auto const barColor = make_packed_float4(glm::vec4(color.r, color.g, color.b, color.a * 0.5f));
+  auto const uv = make_packed_float2(barUv);
+
+  auto addBar = [&](float x0, float x1) {
+    auto const halfSize = glm::vec2((x1 - x0) * scale, std::max(barHeight * scale, 1.0f)) * 0.5f;
+    Glyph g{
+      .center = make_packed_float2(origin + glm::vec2(x0 * scale, 0.0f) + halfSize),
+      .halfSize = make_packed_float2(halfSize),
+      .uvCenter = uv,
+      .uvHalfSize = make_packed_float2(glm::vec2(0.0f, 0.0f)),
+      .color = barColor,
+    };
+    outBars.push_back(g);
+  };
+
+  // One bar per word, from the left of its first glyph to the right of its last one.
+  float penX = 0.0f;
+  float wordBegin = 0.0f;
+  float wordEnd = 0.0f;
+  bool isInWord = false;
+  for (auto c : s) {
+    auto it = glyphs.find(c);
+    if (it == glyphs.end()) {
+      it = glyphs.find(' ');
+    }
+    auto const & glyphData = it->second;
+    if (c == ' ' || glyphData.m_size.x <= 0.0f) {
+      if (isInWord) {
+        addBar(wordBegin, wordEnd);
+        isInWord = false;
+      }
+    } else {
+      auto const x0 = penX + glyphData.m_offset.x;
+      if (!isInWord) {
+        wordBegin = x0;
+        wordEnd = x0;
+        isInWord = true;
+      }
+      wordEnd = std::max(wordEnd, x0 + glyphData.m_size.x);
+    }
+    penX += glyphData.m_advance;
+  }
+  if (isInWord) {
+    addBar(wordBegin, wordEnd);
+  }
+}
+
+void countUsage(GlyphUsageStats & usageStats, std::string const & s, GlyphSet const & glyphSet) {
+  auto const & glyphs = glyphSet.getGlyphs();
+  for (auto c : s) {
+    auto const it = glyphs.find(c);
+    usageStats.count(it != glyphs.end() ? it->first : static_cast<uint16_t>(' '));
+  }
+}
+
+// Places the glyph with its pen position (the left-bottom corner of the view box
+// for icons) at `origin`.
+Glyph makeGlyph(GlyphSet const & glyphSet,
+                GlyphSet::GlyphData const & glyphData,
+                glm::vec2 const & origin,
+                float pixelSize,
+                glm::vec4 const & color) {
+  auto const scale = pixelSize / static_cast<float>(glyphSet.getBaseFontSize());
+  auto const atlasSize = glm::vec2(glyphSet.getAtlasSize());
+  auto const halfSize = glyphData.m_size * 0.5f;
+  auto const uvHalfSize = glm::vec2(glyphData.m_pixelSize) * 0.5f / atlasSize;
+  return Glyph{
+    .center = make_packed_float2(origin + (glyphData.m_offset + halfSize) * scale),
+    .halfSize = make_packed_float2(halfSize * scale),
+    .uvCenter = make_packed_float2(glm::vec2(glyphData.m_posInAtlas) / atlasSize + uvHalfSize),
+    .uvHalfSize = make_packed_float2(
+      uvHalfSize - glm::vec2(GlyphSet::kBorderInPixels, GlyphSet::kBorderInPixels) / atlasSize),
+    .color = make_packed_float4(color),
+  };
+}
+}  // namespace
 
 TextRenderer::~TextRenderer() {
-  if (m_glyphBuffer) {
-    m_glyphBuffer->release();
+  for (auto & frameBuffer : m_frameBuffers) {
+    if (frameBuffer.m_glyphBuffer) {
+      frameBuffer.m_glyphBuffer->release();
+    }
+    if (frameBuffer.m_stampBuffer) {
+      frameBuffer.m_stampBuffer->release();
+    }
   }
 
   if (m_pipelineState) {
     m_pipelineState->release();
   }
+
+  if (m_coveragePipelineState) {
+    m_coveragePipelineState->release();
+  }
+
+  if (m_stampedPipelineState) {
+    m_stampedPipelineState->release();
+  }
+
+  if (m_templateGlyphBuffer) {
+    m_templateGlyphBuffer->release();
+  }
+  for (auto & [_, buffer] : m_retiredTemplateGlyphBuffers) {
+    buffer->release();
+  }
+
+  if (m_coverageTexture) {
+    m_coverageTexture->release();
+  }
+  for (auto & [_, texture] : m_retiredCoverageTextures) {
+    texture->release();
+  }
 }
 
-bool TextRenderer::initialize(MTL::Device * const device, MTL::Library * library) {
-  // Initialize glyph buffer.
-  m_glyphBufferSize = kGlyphBufferDefaultSize;
-  m_glyphBuffer =
-    device->newBuffer(m_glyphBufferSize * sizeof(Glyph), MTL::ResourceStorageModeShared);
+bool TextRenderer::initialize(MTL::Device * const device,
+                              MTL::Library * library,
+                              uint32_t maxFramesInFlight /* = 3 */,
+                              bool premultipliedAlpha /* = false */) {
+  m_maxFramesInFlight = maxFramesInFlight;
+
+  // Initialize glyph buffers.
+  m_frameBuffers.resize(maxFramesInFlight);
+  for (auto & frameBuffer : m_frameBuffers) {
+    frameBuffer.m_glyphBufferSize = kGlyphBufferDefaultSize;
+    frameBuffer.m_glyphBuffer = device->newBuffer(frameBuffer.m_glyphBufferSize * sizeof(Glyph),
+                                                  MTL::ResourceStorageModeShared);
+    frameBuffer.m_stampBufferSize = kStampBufferDefaultSize;
+    frameBuffer.m_stampBuffer = device->newBuffer(frameBuffer.m_stampBufferSize * sizeof(Stamp),
+                                                  MTL::ResourceStorageModeShared);
+  }
 
   // Initialize shaders.
   MTL::FunctionConstantValues * constantValues = MTL::FunctionConstantValues::alloc()->init();
@@ -51,33 +417,155 @@ bool TextRenderer::initialize(MTL::Device * const device, MTL::Library * library
   CHECK_AND_RETURN(error, false);
   METAL_GUARD(fsFunction);
 
-  // Initialize pipeline state.
-  auto pipelineStateDescriptor = MTL::RenderPipelineDescriptor::alloc()->init();
-  pipelineStateDescriptor->setLabel(STR("Text Render Pipeline State"));
-  METAL_GUARD(pipelineStateDescriptor);
-  pipelineStateDescriptor->setVertexFunction(vsFunction);
-  pipelineStateDescriptor->setFragmentFunction(fsFunction);
-  pipelineStateDescriptor->setSampleCount(1);
-  auto colorAttachment = pipelineStateDescriptor->colorAttachments()->object(0);
-  colorAttachment->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
-  colorAttachment->setBlendingEnabled(true);
-  colorAttachment->setRgbBlendOperation(MTL::BlendOperationAdd);
-  colorAttachment->setAlphaBlendOperation(MTL::BlendOperationAdd);
-  colorAttachment->setSourceRGBBlendFactor(MTL::BlendFactorSourceAlpha);
-  colorAttachment->setSourceAlphaBlendFactor(MTL::BlendFactorSourceAlpha);
-  colorAttachment->setDestinationRGBBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-  colorAttachment->setDestinationAlphaBlendFactor(MTL::BlendFactorOneMinusSourceAlpha);
-
-  m_pipelineState = device->newRenderPipelineState(pipelineStateDescriptor, &error);
+  MTL::Function * fsCoverageFunction =
+    library->newFunction(STR("fragmentTextCoverage"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(fsCoverageFunction);
+
+  MTL::Function * vsStampedFunction =
+    library->newFunction(STR("vertexStampedText"), constantValues, &error);
+  CHECK_AND_RETURN(error, false);
+  METAL_GUARD(vsStampedFunction);
+
+  // Initialize pipeline states.
+  m_pipelineState = createTextPipelineState(device,
+                                            vsFunction,
+                                            fsFunction,
+                                            STR("Text Render Pipeline State"),
+                                            premultipliedAlpha,
+                                            &error);
   CHECK_AND_RETURN(error, false);
 
+  m_coveragePipelineState = createTextPipelineState(device,
+                                                    vsFunction,
+                                                    fsCoverageFunction,
+                                                    STR("Text Coverage Render Pipeline State"),
+                                                    premultipliedAlpha,
+                                                    &error);
+  CHECK_AND_RETURN(error, false);
+
+  m_stampedPipelineState = createTextPipelineState(device,
+                                                   vsStampedFunction,
+                                                   fsFunction,
+                                                   STR("Stamped Text Render Pipeline State"),
+                                                   premultipliedAlpha,
+                                                   &error);
+  CHECK_AND_RETURN(error, false);
+
+  return true;
+}
+
+void TextRenderer::setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas) {
+  std::lock_guard<std::mutex> lock(m_pendingGlyphAtlasMutex);
+  m_pendingGlyphAtlas = std::move(glyphAtlas);
+}
+
+TextRenderer::Recorder & TextRenderer::createRecorder() {
+  m_recorders.push_back(std::make_unique<Recorder>());
+  m_recorders.back()->reset(getRecorderSettings());
+  return *m_recorders.back();
+}
+
+TextRenderer::Recorder::Settings TextRenderer::getRecorderSettings() const {
+  return Recorder::Settings{
+    .m_glyphAtlas = m_glyphAtlas,
+    .m_greekingPixelSize = m_greekingPixelSize,
+    .m_barUv = m_coverageAtlas.getSolidTexelUv(),
+    .m_usageStats = m_usageStats,
+  };
+}
+
+bool TextRenderer::addRecorded(Recorder const & recorder) {
+  if (recorder.getGlyphAtlas() != m_glyphAtlas.get()) {
+    return false;
+  }
+  m_detachedRecorders.push_back(&recorder);
   return true;
 }
 
 void TextRenderer::beginLayouting() {
+  m_frameIndex++;
+
+  // Swap glyph atlas at the frame boundary.
+  std::shared_ptr<GlyphAtlas const> pendingGlyphAtlas;
+  {
+    std::lock_guard<std::mutex> lock(m_pendingGlyphAtlasMutex);
+    pendingGlyphAtlas = std::move(m_pendingGlyphAtlas);
+  }
+  bool const isGlyphAtlasSwapped = pendingGlyphAtlas != nullptr;
+  if (isGlyphAtlasSwapped) {
+    if (m_glyphAtlas != nullptr) {
+      m_retiredGlyphAtlases.emplace_back(m_frameIndex + m_maxFramesInFlight,
+                                         std::move(m_glyphAtlas));
+    }
+    m_glyphAtlas = std::move(pendingGlyphAtlas);
+    m_glyphAtlasGeneration++;
+  }
+
+  // Coverage bitmaps are keyed by glyph set, so they go away with the atlas. A full
+  // coverage atlas is kept: glyphs which don't fit are drawn from SDF, resetting it
+  // would rasterize and upload the whole working set again every frame.
+  if (isGlyphAtlasSwapped) {
+    m_coverageAtlas.reset();
+    if (m_coverageTexture != nullptr) {
+      m_retiredCoverageTextures.emplace_back(m_frameIndex + m_maxFramesInFlight,
+                                             m_coverageTexture);
+      m_coverageTexture = nullptr;
+    }
+    m_coverageAtlasGeneration++;
+  }
+  if (isGlyphAtlasSwapped && !m_labelTemplates.empty()) {
+    m_labelTemplatesChanged = true;
+  }
+
+  // Release atlases which are not used by in-flight frames anymore.
+  m_retiredGlyphAtlases.erase(
+    std::remove_if(m_retiredGlyphAtlases.begin(),
+                   m_retiredGlyphAtlases.end(),
+                   [this](auto const & retired) { return retired.first <= m_frameIndex; }),
+    m_retiredGlyphAtlases.end());
+  m_retiredCoverageTextures.erase(
+    std::remove_if(m_retiredCoverageTextures.begin(),
+                   m_retiredCoverageTextures.end(),
+                   [this](auto const & retired) {
+                     if (retired.first > m_frameIndex) {
+                       return false;
+                     }
+                     retired.second->release();
+                     return true;
+                   }),
+    m_retiredCoverageTextures.end());
+  m_retiredTemplateGlyphBuffers.erase(
+    std::remove_if(m_retiredTemplateGlyphBuffers.begin(),
+                   m_retiredTemplateGlyphBuffers.end(),
+                   [this](auto const & retired) {
+                     if (retired.first > m_frameIndex) {
+                       return false;
+                     }
+                     retired.second->release();
+                     return true;
+                   }),
+    m_retiredTemplateGlyphBuffers.end());
+
   m_screenGlyphs.clear();
-  m_prevScreenGlyphsHash = m_screenGlyphsHash;
+  m_screenCoverageGlyphs.clear();
+  m_textIndex.clear();
+  m_runsCount = 0;
   m_screenGlyphsHash = 0;
+  // Texture coordinates of glyphs change with the atlases.
+  utils::hashCombine(m_screenGlyphsHash,
+                     m_glyphAtlasGeneration,
+                     m_coverageAtlasGeneration,
+                     m_smallTextCoverageEnabled,
+                     m_greekingPixelSize);
+
+  auto const recorderSettings = getRecorderSettings();
+  for (auto & recorder : m_recorders) {
+    recorder->reset(recorderSettings);
+  }
+  m_detachedRecorders.clear();
+  m_labels.clear();
+  m_stampsHash = 0;
 }
 
 void TextRenderer::addText(std::string const & s,
@@ -85,6 +573,7 @@ void TextRenderer::addText(std::string const & s,
                            glm::vec2 const & size,
                            glm::vec4 const & color,
                            GlyphSet const & glyphSet) {
+  auto const runIndex = m_runsCount++;
   if (s.empty()) {
     return;
   }
@@ -102,92 +591,587 @@ void TextRenderer::addText(std::string const & s,
                      color.a);
 
   auto const & glyphs = glyphSet.getGlyphs();
-
-  // Place glyphs.
-  m_screenGlyphs.reserve(m_screenGlyphs.size() + s.size());
   auto const startIndex = m_screenGlyphs.size();
-  float offsetX = 0.0f;
-  float maxY = 0.0;
+  auto const placement = placeText(s, leftTop, size, color, glyphSet, m_screenGlyphs);
+  auto const scale = placement.m_scale;
+
+  if (m_textIndexEnabled) {
+    // Caret positions are at pen positions, the run occupies its whole layout box
+    // vertically.
+    m_carets.resize(s.size() + 1);
+    float penX = placement.m_origin.x;
+    m_carets[0] = penX;
+    for (size_t i = 0; i < s.size(); ++i) {
+      auto it = glyphs.find(s[i]);
+      if (it == glyphs.end()) {
+        it = glyphs.find(' ');
+      }
+      penX += it->second.m_advance * scale;
+      m_carets[i + 1] = penX;
+    }
+    m_textIndex.addRun(runIndex, leftTop.y, leftTop.y + size.y, m_carets.data(), m_carets.size());
+  }
+
+  auto const pixelSize = placement.m_pixelSize;
+  if (pixelSize < m_greekingPixelSize) {
+    m_screenGlyphs.resize(startIndex);
+    addGreekedText(s,
+                   glyphSet,
+                   placement.m_origin,
+                   scale,
+                   color,
+                   m_coverageAtlas.getSolidTexelUv(),
+                   m_screenCoverageGlyphs);
+    return;
+  }
+
+  if (m_usageStats != nullptr) {
+    countUsage(*m_usageStats, s, glyphSet);
+  }
+
+  // Tiny text is drawn from coverage bitmaps. Glyphs without a bitmap
+  // (e.g. spaces) stay in the SDF list.
+  if (!m_smallTextCoverageEnabled || pixelSize == 0 || pixelSize >= kCoverageMaxPixelSize) {
+    return;
+  }
+  auto sdfGlyphsEnd = startIndex;
+  float penX = 0.0f;
   for (size_t i = 0; i < s.size(); ++i) {
     auto it = glyphs.find(s[i]);
     if (it == glyphs.end()) {
       it = glyphs.find(' ');
-      METAL_ASSERT(it != glyphs.end());
     }
-    auto const & glyphData = it->second;
+    auto const pen = placement.m_origin + glm::vec2(penX * scale, 0.0f);
+    if (!addCoverageGlyph(glyphSet, it->first, pixelSize, pen, color)) {
+      m_screenGlyphs[sdfGlyphsEnd++] = m_screenGlyphs[startIndex + i];
+    }
+    penX += it->second.m_advance;
+  }
+  m_screenGlyphs.resize(sdfGlyphsEnd);
+}
 
-    auto const atlasSize = glm::vec2(glyphSet.getAtlasSize());
-    auto const halfSize = glyphData.m_size * 0.5f;
-    auto const uvHalfSize = glm::vec2(glyphData.m_pixelSize) * 0.5f / atlasSize;
+bool TextRenderer::addCoverageGlyph(GlyphSet const & glyphSet,
+                                    uint16_t code,
+                                    uint32_t pixelSize,
+                                    glm::vec2 const & pen,
+                                    glm::vec4 const & color) {
+  // Bitmaps are placed at whole pixels, horizontal subpixel position is baked
+  // into the bitmap.
+  auto const subpixels = static_cast<float>(CoverageAtlas::kSubpixelPositions);
+  auto const penX = std::round(pen.x * subpixels) / subpixels;
+  auto const penXFloor = std::floor(penX);
+  auto const subpixelPosition = static_cast<uint32_t>(std::lround((penX - penXFloor) * subpixels));
+  auto const entry = m_coverageAtlas.getEntry(glyphSet, code, pixelSize, subpixelPosition);
+  if (entry == nullptr) {
+    return false;
+  }
 
-    Glyph g{
-      .center = make_packed_float2(glm::vec2(offsetX, 0.0f) + glyphData.m_offset + halfSize),
-      .halfSize = make_packed_float2(halfSize),
-      .uvCenter = make_packed_float2(glm::vec2(glyphData.m_posInAtlas) / atlasSize + uvHalfSize),
-      .uvHalfSize = make_packed_float2(
-        uvHalfSize - glm::vec2(GlyphSet::kBorderInPixels, GlyphSet::kBorderInPixels) / atlasSize),
-      .color = make_packed_float4(color),
-    };
-    m_screenGlyphs.push_back(g);
+  auto const atlasSize = glm::vec2(m_coverageAtlas.getAtlasSize());
+  auto const halfSize = glm::vec2(entry->m_size) * 0.5f;
+  auto const leftBottom = glm::vec2(penXFloor, std::round(pen.y)) + glm::vec2(entry->m_origin);
+  Glyph g{
+    .center = make_packed_float2(leftBottom + halfSize),
+    .halfSize = make_packed_float2(halfSize),
+    .uvCenter = make_packed_float2((glm::vec2(entry->m_posInAtlas) + halfSize) / atlasSize),
+    .uvHalfSize = make_packed_float2(halfSize / atlasSize),
+    .color = make_packed_float4(color),
+  };
+  m_screenCoverageGlyphs.push_back(g);
+  return true;
+}
 
-    if (i + 1 < s.size()) {
-      offsetX += glyphData.m_advance;
-      maxY = std::max(maxY, g.center.y + g.halfSize.y);
-    }
+void TextRenderer::addText(std::string const & s,
+                           glm::vec2 const & leftTop,
+                           glm::vec2 const & size,
+                           glm::vec4 const & color) {
+  METAL_ASSERT(m_glyphAtlas != nullptr);
+  addText(s, leftTop, size, color, m_glyphAtlas->getGlyphSet());
+}
+
+void TextRenderer::addIcon(uint16_t code,
+                           glm::vec2 const & origin,
+                           float pixelSize,
+                           glm::vec4 const & color,
+                           GlyphSet const & glyphSet) {
+  auto const it = glyphSet.getGlyphs().find(code);
+  if (it == glyphSet.getGlyphs().end()) {
+    return;
   }
+  utils::hashCombine(m_screenGlyphsHash,
+                     code,
+                     origin.x,
+                     origin.y,
+                     pixelSize,
+                     color.r,
+                     color.g,
+                     color.b,
+                     color.a);
 
-  // Do simple layouting.
-  float const scale = std::min(size.x / offsetX, size.y / maxY);
-  float const layoutOffsetX = (size.x - offsetX * scale) * 0.5f;
-  float const layoutOffsetY = (size.y - maxY * scale) * 0.5f;
-  for (size_t i = startIndex; i < m_screenGlyphs.size(); ++i) {
-    m_screenGlyphs[i].center.x = leftTop.x + m_screenGlyphs[i].center.x * scale + layoutOffsetX;
-    m_screenGlyphs[i].center.y = leftTop.y + m_screenGlyphs[i].center.y * scale + layoutOffsetY;
-    m_screenGlyphs[i].halfSize.x *= scale;
-    m_screenGlyphs[i].halfSize.y *= scale;
+  m_screenGlyphs.push_back(makeGlyph(glyphSet, it->second, origin, pixelSize, color));
+
+  if (m_usageStats != nullptr) {
+    m_usageStats->count(code);
   }
 }
 
+void TextRenderer::addIcon(uint16_t code,
+                           glm::vec2 const & origin,
+                           float pixelSize,
+                           glm::vec4 const & color) {
+  METAL_ASSERT(m_glyphAtlas != nullptr);
+  addIcon(code, origin, pixelSize, color, m_glyphAtlas->getGlyphSet());
+}
+
+TextRenderer::LabelTemplateId TextRenderer::addLabelTemplate(std::string const & s,
+                                                             float pixelSize) {
+  m_labelTemplates.push_back(LabelTemplate{.m_text = s, .m_pixelSize = pixelSize});
+  m_labelTemplatesChanged = true;
+  return static_cast<LabelTemplateId>(m_labelTemplates.size() - 1);
+}
+
+void TextRenderer::addLabel(LabelTemplateId templateId,
+                            glm::vec2 const & origin,
+                            glm::vec4 const & color) {
+  METAL_ASSERT(templateId < m_labelTemplates.size());
+  utils::hashCombine(
+    m_stampsHash, templateId, origin.x, origin.y, color.r, color.g, color.b, color.a);
+  m_labels.emplace_back(templateId,
+                        Stamp{
+                          .origin = make_packed_float2(origin),
+                          .color = make_packed_float4(color),
+                        });
+}
+
 void TextRenderer::endLayouting(MTL::Device * const device) {
-  // In theory hash-based solution can suffer from collisions (it's highly
-  // unlikely though). Consider to improve it for production code.
-  if (m_screenGlyphsHash == m_prevScreenGlyphsHash) {
+  mergeRecordedRuns();
+  updateCoverageTexture(device);
+  layoutLabelTemplates(device);
+  updateStamps(device);
+  if (m_textIndexEnabled) {
+    m_textIndex.build();
+  }
+  if (m_usageStats != nullptr) {
+    m_usageStats->merge();
+  }
+
+  // The buffer of this frame was last written maxFramesInFlight frames ago. In theory
+  // hash-based solution can suffer from collisions (it's highly unlikely though).
+  // Consider to improve it for production code.
+  if (m_frameBuffers.empty()) {
+    return;
+  }
+  auto & frameBuffer = getFrameBuffer();
+  if (frameBuffer.m_glyphsHash == m_screenGlyphsHash) {
     return;
   }
+  frameBuffer.m_glyphsHash = m_screenGlyphsHash;
 
   // Update data buffer.
-  auto newGlyphBufferSize = m_glyphBufferSize;
-  while (m_screenGlyphs.size() > newGlyphBufferSize) {
+  auto const glyphsCount = m_screenGlyphs.size() + m_screenCoverageGlyphs.size();
+  auto newGlyphBufferSize = frameBuffer.m_glyphBufferSize;
+  while (glyphsCount > newGlyphBufferSize) {
     newGlyphBufferSize *= 2;
   }
-  if (newGlyphBufferSize != m_glyphBufferSize) {
+  if (newGlyphBufferSize != frameBuffer.m_glyphBufferSize) {
     // Reallocate buffer.
-    m_glyphBufferSize = newGlyphBufferSize;
-    m_glyphBuffer->release();
-    m_glyphBuffer =
-      device->newBuffer(m_glyphBufferSize * sizeof(Glyph), MTL::ResourceStorageModeShared);
+    frameBuffer.m_glyphBufferSize = newGlyphBufferSize;
+    frameBuffer.m_glyphBuffer->release();
+    frameBuffer.m_glyphBuffer = device->newBuffer(newGlyphBufferSize * sizeof(Glyph),
+                                                  MTL::ResourceStorageModeShared);
   }
-  memcpy(m_glyphBuffer->contents(), m_screenGlyphs.data(), m_screenGlyphs.size() * sizeof(Glyph));
+  auto const contentPtr = static_cast<Glyph *>(frameBuffer.m_glyphBuffer->contents());
+  memcpy(contentPtr, m_screenGlyphs.data(), m_screenGlyphs.size() * sizeof(Glyph));
+  memcpy(contentPtr + m_screenGlyphs.size(),
+         m_screenCoverageGlyphs.data(),
+         m_screenCoverageGlyphs.size() * sizeof(Glyph));
+}
+
+void TextRenderer::mergeRecordedRuns() {
+  m_recordedRuns.clear();
+  auto addRuns = [this](Recorder const & recorder) {
+    for (auto const & run : recorder.m_runs) {
+      m_recordedRuns.push_back(RecordedRun{.m_recorder = &recorder, .m_run = &run});
+    }
+  };
+  for (auto const & recorder : m_recorders) {
+    addRuns(*recorder);
+  }
+  for (auto const recorder : m_detachedRecorders) {
+    addRuns(*recorder);
+  }
+  if (m_recordedRuns.empty()) {
+    return;
+  }
+  std::stable_sort(m_recordedRuns.begin(),
+                   m_recordedRuns.end(),
+                   [](RecordedRun const & r1, RecordedRun const & r2) {
+                     return r1.m_run->m_submissionKey < r2.m_run->m_submissionKey;
+                   });
+
+  // Prefix sums of run sizes are their offsets in the instance lists, so runs are
+  // copied independently.
+  auto glyphsCount = m_screenGlyphs.size();
+  auto barsCount = m_screenCoverageGlyphs.size();
+  for (auto & recordedRun : m_recordedRuns) {
+    recordedRun.m_glyphsOffset = glyphsCount;
+    recordedRun.m_barsOffset = barsCount;
+    glyphsCount += recordedRun.m_run->m_glyphsCount;
+    barsCount += recordedRun.m_run->m_barsCount;
+    utils::hashCombine(m_screenGlyphsHash, recordedRun.m_run->m_hash);
+  }
+  auto const recordedCount =
+    glyphsCount + barsCount - m_screenGlyphs.size() - m_screenCoverageGlyphs.size();
+  m_screenGlyphs.resize(glyphsCount);
+  m_screenCoverageGlyphs.resize(barsCount);
+
+  parallelFor(m_recordedRuns.size(),
+              recordedCount < kParallelMergeMinGlyphs ? 1 : 0,
+              [this](size_t index) {
+                auto const & [recorder, run, glyphsOffset, barsOffset] = m_recordedRuns[index];
+                std::copy_n(recorder->m_glyphs.begin() + run->m_firstGlyph,
+                            run->m_glyphsCount,
+                            m_screenGlyphs.begin() + glyphsOffset);
+                std::copy_n(recorder->m_bars.begin() + run->m_firstBar,
+                            run->m_barsCount,
+                            m_screenCoverageGlyphs.begin() + barsOffset);
+              });
+}
+
+void TextRenderer::updateCoverageTexture(MTL::Device * const device) {
+  if (m_coverageTexture == nullptr) {
+    if (m_screenCoverageGlyphs.empty()) {
+      return;
+    }
+    m_coverageTexture = GlyphTexture::createFromTexels(device,
+                                                       m_coverageAtlas.getAtlasSize(),
+                                                       m_coverageAtlas.getTexels().data());
+    m_coverageTexture->setLabel(STR("Coverage Glyphs Texture"));
+    m_coverageAtlas.clearDirtyRegions();
+    return;
+  }
+
+  // Only new bitmaps are uploaded, frames in flight never sample their texels.
+  auto const width = m_coverageAtlas.getAtlasSize().x;
+  for (auto const & region : m_coverageAtlas.getDirtyRegions()) {
+    m_coverageTexture->replaceRegion(
+      MTL::Region::Make2D(region.m_pos.x, region.m_pos.y, region.m_size.x, region.m_size.y),
+      0,
+      m_coverageAtlas.getTexels().data() + static_cast<size_t>(region.m_pos.y) * width +
+        region.m_pos.x,
+      width);
+  }
+  m_coverageAtlas.clearDirtyRegions();
+}
+
+void TextRenderer::layoutLabelTemplates(MTL::Device * const device) {
+  if (!m_labelTemplatesChanged || m_glyphAtlas == nullptr) {
+    return;
+  }
+  m_labelTemplatesChanged = false;
+
+  // Templates are few and short, so all of them are laid out again.
+  auto const & glyphSet = m_glyphAtlas->getGlyphSet();
+  auto const & glyphs = glyphSet.getGlyphs();
+  auto const baseFontSize = static_cast<float>(glyphSet.getBaseFontSize());
+  auto const white = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+  m_templateGlyphs.clear();
+  m_templateCodes.clear();
+  for (auto & labelTemplate : m_labelTemplates) {
+    labelTemplate.m_firstGlyph = static_cast<uint32_t>(m_templateGlyphs.size());
+    auto const scale = labelTemplate.m_pixelSize / baseFontSize;
+    float penX = 0.0f;
+    for (auto c : labelTemplate.m_text) {
+      auto it = glyphs.find(c);
+      if (it == glyphs.end()) {
+        it = glyphs.find(' ');
+        METAL_ASSERT(it != glyphs.end());
+      }
+      m_templateGlyphs.push_back(makeGlyph(
+        glyphSet, it->second, glm::vec2(penX, 0.0f), labelTemplate.m_pixelSize, white));
+      m_templateCodes.push_back(it->first);
+      penX += it->second.m_advance * scale;
+    }
+    labelTemplate.m_glyphsCount =
+      static_cast<uint32_t>(m_templateGlyphs.size()) - labelTemplate.m_firstGlyph;
+  }
+
+  // Frames in flight may still draw the previous templates.
+  if (m_templateGlyphBuffer != nullptr) {
+    m_retiredTemplateGlyphBuffers.emplace_back(m_frameIndex + m_maxFramesInFlight,
+                                               m_templateGlyphBuffer);
+    m_templateGlyphBuffer = nullptr;
+  }
+  if (!m_templateGlyphs.empty()) {
+    m_templateGlyphBuffer = device->newBuffer(m_templateGlyphs.data(),
+                                              m_templateGlyphs.size() * sizeof(Glyph),
+                                              MTL::ResourceStorageModeShared);
+    m_templateGlyphBuffer->setLabel(STR("Label Template Glyphs"));
+  }
+}
+
+void TextRenderer::updateStamps(MTL::Device * const device) {
+  // Group stamps by template (counting sort), every template is drawn by one
+  // instanced draw call.
+  for (auto & labelTemplate : m_labelTemplates) {
+    labelTemplate.m_stampsCount = 0;
+  }
+  for (auto const & [templateId, _] : m_labels) {
+    m_labelTemplates[templateId].m_stampsCount++;
+  }
+  uint32_t stampsCount = 0;
+  for (auto & labelTemplate : m_labelTemplates) {
+    labelTemplate.m_firstStamp = stampsCount;
+    stampsCount += labelTemplate.m_stampsCount;
+    labelTemplate.m_stampsCount = 0;
+  }
+  m_stamps.resize(stampsCount);
+  for (auto const & [templateId, stamp] : m_labels) {
+    auto & labelTemplate = m_labelTemplates[templateId];
+    m_stamps[labelTemplate.m_firstStamp + labelTemplate.m_stampsCount++] = stamp;
+  }
+
+  if (m_usageStats != nullptr) {
+    for (auto const & labelTemplate : m_labelTemplates) {
+      if (labelTemplate.m_stampsCount == 0) {
+        continue;
+      }
+      for (uint32_t i = 0; i < labelTemplate.m_glyphsCount; ++i) {
+        m_usageStats->count(m_templateCodes[labelTemplate.m_firstGlyph + i],
+                            labelTemplate.m_stampsCount);
+      }
+    }
+  }
+
+  // Stamps depend only on the labels, so the hash of labels gates the upload to the
+  // buffer of this frame as for glyphs.
+  m_uploadedStampsCount = 0;
+  if (m_stamps.empty() || m_frameBuffers.empty()) {
+    return;
+  }
+  auto & frameBuffer = getFrameBuffer();
+  if (frameBuffer.m_stampsHash == m_stampsHash) {
+    return;
+  }
+  frameBuffer.m_stampsHash = m_stampsHash;
+  auto newStampBufferSize = frameBuffer.m_stampBufferSize;
+  while (m_stamps.size() > newStampBufferSize) {
+    newStampBufferSize *= 2;
+  }
+  if (newStampBufferSize != frameBuffer.m_stampBufferSize) {
+    frameBuffer.m_stampBufferSize = newStampBufferSize;
+    frameBuffer.m_stampBuffer->release();
+    frameBuffer.m_stampBuffer =
+      device->newBuffer(newStampBufferSize * sizeof(Stamp), MTL::ResourceStorageModeShared);
+  }
+  memcpy(frameBuffer.m_stampBuffer->contents(), m_stamps.data(), m_stamps.size() * sizeof(Stamp));
+  m_uploadedStampsCount = m_stamps.size();
 }
 
 void TextRenderer::render(glm::vec2 const & screenSize,
                           MTL::RenderCommandEncoder * commandEncoder,
                           MTL::Texture * glyphTexture) {
-  if (m_screenGlyphs.empty()) {
+  if (m_frameBuffers.empty() ||
+      (m_screenGlyphs.empty() && m_screenCoverageGlyphs.empty() && m_stamps.empty())) {
     return;
   }
+  auto const & frameBuffer = getFrameBuffer();
+  auto const glyphBuffer = frameBuffer.m_glyphBuffer;
   FrameData frameData;
   auto const m = glm::ortho(0.0f, screenSize.x, 0.0f, screenSize.y);
   memcpy(&frameData.projection, glm::value_ptr(m), sizeof(m));
 
-  commandEncoder->setRenderPipelineState(m_pipelineState);
-  commandEncoder->setVertexBuffer(m_glyphBuffer, 0, TextRenderBufferGlyphs);
   commandEncoder->setVertexBytes(&frameData, sizeof(frameData), TextRenderBufferFrame);
-  commandEncoder->setFragmentTexture(glyphTexture, TextRenderTextureGlyphs);
-  commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
-                                 0 /* vertexStart */,
-                                 4 /* vertexCount */,
-                                 static_cast<uint32_t>(m_screenGlyphs.size()));
+  if (!m_screenGlyphs.empty()) {
+    commandEncoder->setRenderPipelineState(m_pipelineState);
+    commandEncoder->setVertexBuffer(glyphBuffer, 0, TextRenderBufferGlyphs);
+    commandEncoder->setFragmentTexture(glyphTexture, TextRenderTextureGlyphs);
+    commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
+                                   0 /* vertexStart */,
+                                   4 /* vertexCount */,
+                                   static_cast<uint32_t>(m_screenGlyphs.size()));
+  }
+
+  if (!m_screenCoverageGlyphs.empty() && m_coverageTexture != nullptr) {
+    commandEncoder->setRenderPipelineState(m_coveragePipelineState);
+    commandEncoder->setVertexBuffer(glyphBuffer,
+                                    m_screenGlyphs.size() * sizeof(Glyph),
+                                    TextRenderBufferGlyphs);
+    commandEncoder->setFragmentTexture(m_coverageTexture, TextRenderTextureGlyphs);
+    commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
+                                   0 /* vertexStart */,
+                                   4 /* vertexCount */,
+                                   static_cast<uint32_t>(m_screenCoverageGlyphs.size()));
+  }
+
+  if (!m_stamps.empty() && m_templateGlyphBuffer != nullptr) {
+    commandEncoder->setRenderPipelineState(m_stampedPipelineState);
+    commandEncoder->setFragmentTexture(glyphTexture, TextRenderTextureGlyphs);
+    for (auto const & labelTemplate : m_labelTemplates) {
+      if (labelTemplate.m_glyphsCount == 0 || labelTemplate.m_stampsCount == 0) {
+        continue;
+      }
+      commandEncoder->setVertexBuffer(m_templateGlyphBuffer,
+                                      labelTemplate.m_firstGlyph * sizeof(Glyph),
+                                      TextRenderBufferGlyphs);
+      commandEncoder->setVertexBuffer(frameBuffer.m_stampBuffer,
+                                      labelTemplate.m_firstStamp * sizeof(Stamp),
+                                      TextRenderBufferStamps);
+      commandEncoder->setVertexBytes(&labelTemplate.m_glyphsCount,
+                                     sizeof(labelTemplate.m_glyphsCount),
+                                     TextRenderBufferTemplateGlyphsCount);
+      commandEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip,
+                                     0 /* vertexStart */,
+                                     4 /* vertexCount */,
+                                     labelTemplate.m_glyphsCount * labelTemplate.m_stampsCount);
+    }
+  }
+}
+
+void TextRenderer::render(glm::vec2 const & screenSize,
+                          MTL::RenderCommandEncoder * commandEncoder) {
+  if (m_glyphAtlas == nullptr) {
+    return;
+  }
+  render(screenSize, commandEncoder, m_glyphAtlas->getTexture());
+}
+
+void TextRenderer::Recorder::reset(Settings settings) {
+  m_settings = std::move(settings);
+
+  m_submissionKey = 0;
+  m_runs.clear();
+  m_glyphs.clear();
+  m_bars.clear();
+}
+
+TextRenderer::Recorder::Run & TextRenderer::Recorder::getRun() {
+  if (m_runs.empty() || m_runs.back().m_submissionKey != m_submissionKey) {
+    m_runs.push_back(Run{
+      .m_submissionKey = m_submissionKey,
+      .m_firstGlyph = m_glyphs.size(),
+      .m_firstBar = m_bars.size(),
+    });
+  }
+  return m_runs.back();
+}
+
+void TextRenderer::Recorder::updateRun(Run & run) {
+  run.m_glyphsCount = m_glyphs.size() - run.m_firstGlyph;
+  run.m_barsCount = m_bars.size() - run.m_firstBar;
+}
+
+void TextRenderer::Recorder::addText(std::string const & s,
+                                     glm::vec2 const & leftTop,
+                                     glm::vec2 const & size,
+                                     glm::vec4 const & color,
+                                     GlyphSet const & glyphSet) {
+  if (s.empty()) {
+    return;
+  }
+
+  auto & run = getRun();
+  utils::hashCombine(run.m_hash,
+                     s,
+                     leftTop.x,
+                     leftTop.y,
+                     size.x,
+                     size.y,
+                     color.r,
+                     color.g,
+                     color.b,
+                     color.a);
+
+  auto const startIndex = m_glyphs.size();
+  auto const placement = placeText(s, leftTop, size, color, glyphSet, m_glyphs);
+  if (placement.m_pixelSize < m_settings.m_greekingPixelSize) {
+    m_glyphs.resize(startIndex);
+    addGreekedText(
+      s, glyphSet, placement.m_origin, placement.m_scale, color, m_settings.m_barUv, m_bars);
+  } else if (m_settings.m_usageStats != nullptr) {
+    countUsage(*m_settings.m_usageStats, s, glyphSet);
+  }
+  updateRun(run);
+}
+
+void TextRenderer::Recorder::addText(std::string const & s,
+                                     glm::vec2 const & leftTop,
+                                     glm::vec2 const & size,
+                                     glm::vec4 const & color) {
+  METAL_ASSERT(m_settings.m_glyphAtlas != nullptr);
+  addText(s, leftTop, size, color, m_settings.m_glyphAtlas->getGlyphSet());
+}
+
+void TextRenderer::Recorder::addIcon(uint16_t code,
+                                     glm::vec2 const & origin,
+                                     float pixelSize,
+                                     glm::vec4 const & color,
+                                     GlyphSet const & glyphSet) {
+  auto const it = glyphSet.getGlyphs().find(code);
+  if (it == glyphSet.getGlyphs().end()) {
+    return;
+  }
+
+  auto & run = getRun();
+  utils::hashCombine(run.m_hash,
+                     code,
+                     origin.x,
+                     origin.y,
+                     pixelSize,
+                     color.r,
+                     color.g,
+                     color.b,
+                     color.a);
+  m_glyphs.push_back(makeGlyph(glyphSet, it->second, origin, pixelSize, color));
+  updateRun(run);
+
+  if (m_settings.m_usageStats != nullptr) {
+    m_settings.m_usageStats->count(code);
+  }
+}
+
+void TextRenderer::Recorder::addIcon(uint16_t code,
+                                     glm::vec2 const & origin,
+                                     float pixelSize,
+                                     glm::vec4 const & color) {
+  METAL_ASSERT(m_settings.m_glyphAtlas != nullptr);
+  addIcon(code, origin, pixelSize, color, m_settings.m_glyphAtlas->getGlyphSet());
+}
+
+// static
+TextRenderer::LayoutThroughput TextRenderer::measureLayoutThroughput(
+  GlyphSet const & glyphSet,
+  size_t runLength /* = 10000 */) {
+  std::string const kWords = "Lorem ipsum dolor sit amet, consectetur adipiscing elit ";
+  std::string s;
+  s.reserve(runLength);
+  while (s.size() < runLength) {
+    s += kWords[s.size() % kWords.size()];
+  }
+  auto const leftTop = glm::vec2(0.0f, 0.0f);
+  auto const size = glm::vec2(static_cast<float>(runLength) * 10.0f, 20.0f);
+  auto const color = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+
+  // Enough repetitions to run for a few milliseconds, the best time is taken.
+  size_t constexpr kAttempts = 5;
+  size_t const repetitions = std::max<size_t>(1, 1000000 / std::max<size_t>(runLength, 1));
+  std::vector<Glyph> glyphs;
+  auto measure = [&](auto const & place) {
+    double bestSeconds = std::numeric_limits<double>::max();
+    for (size_t attempt = 0; attempt < kAttempts; ++attempt) {
+      auto const t = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < repetitions; ++i) {
+        glyphs.clear();
+        place(s, leftTop, size, color, glyphSet, glyphs);
+      }
+      auto const duration = std::chrono::steady_clock::now() - t;
+      bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(duration).count());
+    }
+    return static_cast<double>(repetitions * s.size()) / bestSeconds * 1e-6;
+  };
+  return LayoutThroughput{
+    .m_interleavedMGlyphsPerSec = measure(placeTextInterleaved),
+    .m_mGlyphsPerSec = measure(placeText),
+  };
 }
 
 }  // namespace sdf::gpu
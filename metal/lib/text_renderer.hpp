@@ -15,18 +15,157 @@
 #pragma once
 
 #include <Metal/Metal.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "coverage_atlas.hpp"
+#include "glyph_atlas.hpp"
 #include "glyph_set.hpp"
 #include "glyph_texture.hpp"
+#include "glyph_usage_stats.hpp"
 #include "sdf_text_types.h"
+#include "text_index.hpp"
 
 namespace sdf::gpu {
 
 class TextRenderer {
 public:
+  // Text with smaller font size (in pixels) is drawn from coverage bitmaps
+  // instead of SDF, if glyph outlines are available. Glyphs which don't fit into
+  // the coverage atlas are drawn from SDF until the glyph atlas is swapped.
+  static uint32_t constexpr kCoverageMaxPixelSize = 10;
+
+  // Lays out text into its own instance lists, so several threads can record
+  // text at once without locking. Every recorder is used by one thread at a time.
+  // Recorded runs are merged in endLayouting after the text added to the renderer
+  // directly, in ascending order of submission keys. Runs with equal keys keep the
+  // order of recorders creation and of recording. The coverage atlas is not
+  // thread-safe, so small recorded text is drawn from SDF (greeking still applies),
+  // and recorded text is not added to the text index.
+  class Recorder {
+  public:
+    // What a recorder takes from the renderer at the start of a frame.
+    struct Settings {
+      // Recorded text is drawn only with the same atlas.
+      std::shared_ptr<GlyphAtlas const> m_glyphAtlas;
+      uint32_t m_greekingPixelSize = 0;
+      glm::vec2 m_barUv = glm::vec2(0.0f, 0.0f);
+      std::shared_ptr<GlyphUsageStats> m_usageStats;
+    };
+
+    // Starts a new frame. Recorders created by the renderer are reset in
+    // beginLayouting, detached ones (see addRecorded) are reset by their owners.
+    void reset(Settings settings);
+    GlyphAtlas const * getGlyphAtlas() const { return m_settings.m_glyphAtlas.get(); }
+
+    // Applies to the text recorded after the call, the key is 0 after beginLayouting.
+    void setSubmissionKey(uint64_t key) { m_submissionKey = key; }
+    uint64_t getSubmissionKey() const { return m_submissionKey; }
+
+    void addText(std::string const & s,
+                 glm::vec2 const & leftTop,
+                 glm::vec2 const & size,
+                 glm::vec4 const & color,
+                 GlyphSet const & glyphSet);
+    // Uses the glyph set of the current glyph atlas.
+    void addText(std::string const & s,
+                 glm::vec2 const & leftTop,
+                 glm::vec2 const & size,
+                 glm::vec4 const & color);
+    void addIcon(uint16_t code,
+                 glm::vec2 const & origin,
+                 float pixelSize,
+                 glm::vec4 const & color,
+                 GlyphSet const & glyphSet);
+    // Uses the glyph set of the current glyph atlas.
+    void addIcon(uint16_t code,
+                 glm::vec2 const & origin,
+                 float pixelSize,
+                 glm::vec4 const & color);
+
+  private:
+    friend class TextRenderer;
+
+    // Consecutive text with the same submission key.
+    struct Run {
+      uint64_t m_submissionKey = 0;
+      size_t m_firstGlyph = 0;
+      size_t m_glyphsCount = 0;
+      size_t m_firstBar = 0;
+      size_t m_barsCount = 0;
+      size_t m_hash = 0;
+    };
+
+    Run & getRun();
+    void updateRun(Run & run);
+
+    Settings m_settings;
+
+    uint64_t m_submissionKey = 0;
+    std::vector<Run> m_runs;
+    std::vector<Glyph> m_glyphs;
+    // Greeking bars, drawn with coverage glyphs.
+    std::vector<Glyph> m_bars;
+  };
+
   ~TextRenderer();
-  bool initialize(MTL::Device * const device, MTL::Library * library);
+  // Resources replaced during rendering are kept alive for `maxFramesInFlight`
+  // frames, until GPU finishes all frames which could use them. With
+  // `premultipliedAlpha` the output is suitable for offscreen layers which are
+  // composited later (see TextLayer).
+  bool initialize(MTL::Device * const device,
+                  MTL::Library * library,
+                  uint32_t maxFramesInFlight = 3,
+                  bool premultipliedAlpha = false);
+
+  // Can be called from any thread. The atlas is swapped in at the next
+  // beginLayouting, so a frame never mixes glyphs of two atlases.
+  void setGlyphAtlas(std::shared_ptr<GlyphAtlas const> glyphAtlas);
+  std::shared_ptr<GlyphAtlas const> const & getGlyphAtlas() const { return m_glyphAtlas; }
+
+  void setSmallTextCoverageEnabled(bool enabled) { m_smallTextCoverageEnabled = enabled; }
+  bool isSmallTextCoverageEnabled() const { return m_smallTextCoverageEnabled; }
+
+  // Text with smaller font size (in pixels) is not readable anyway, so it's drawn
+  // as one bar per word (greeking). 0 disables greeking.
+  void setGreekingPixelSize(uint32_t pixelSize) { m_greekingPixelSize = pixelSize; }
+  uint32_t getGreekingPixelSize() const { return m_greekingPixelSize; }
+
+  // Number of instances laid out in the current frame.
+  size_t getSdfGlyphsCount() const { return m_screenGlyphs.size(); }
+  size_t getCoverageGlyphsCount() const { return m_screenCoverageGlyphs.size(); }
+
+  // Laid out instances, e.g. for cpu::TextRasterizer.
+  std::vector<Glyph> const & getSdfGlyphs() const { return m_screenGlyphs; }
+  std::vector<Glyph> const & getCoverageGlyphs() const { return m_screenCoverageGlyphs; }
+  CoverageAtlas const & getCoverageAtlas() const { return m_coverageAtlas; }
+
+  // Builds the spatial index of laid out text in endLayouting. Run indices in the
+  // index are the indices of addText calls since beginLayouting.
+  void setTextIndexEnabled(bool enabled) { m_textIndexEnabled = enabled; }
+  bool isTextIndexEnabled() const { return m_textIndexEnabled; }
+  TextIndex const & getTextIndex() const { return m_textIndex; }
+
+  // Counts drawn glyphs (greeked text is not counted), the counters are merged
+  // in endLayouting. Stats can be shared by renderers on different threads.
+  void setUsageStats(std::shared_ptr<GlyphUsageStats> usageStats) {
+    m_usageStats = std::move(usageStats);
+  }
+
+  // Must be called on the layouting thread. Recorders live as long as the renderer
+  // and are reset in beginLayouting. Recording must be finished before endLayouting.
+  Recorder & createRecorder();
+  // Settings of the current frame for recorders which are not owned by the renderer.
+  Recorder::Settings getRecorderSettings() const;
+  // Merges a recorder which is not owned by the renderer (e.g. filled on another
+  // thread, see LayoutThread) into the current frame, after the owned ones. The
+  // recorder must stay unchanged until endLayouting. Returns false and ignores
+  // the recorder if it was recorded with another glyph atlas.
+  bool addRecorded(Recorder const & recorder);
 
   void beginLayouting();
   void addText(std::string const & s,
@@ -34,20 +173,149 @@ public:
                glm::vec2 const & size,
                glm::vec4 const & color,
                GlyphSet const & glyphSet);
+  // Uses the glyph set of the current glyph atlas.
+  void addText(std::string const & s,
+               glm::vec2 const & leftTop,
+               glm::vec2 const & size,
+               glm::vec4 const & color);
+  // Draws a glyph (usually an icon, see GlyphSet::Icon) with the left-bottom
+  // corner of its view box at `origin`, scaled so that the view box height is
+  // `pixelSize`. Icons are laid out into the same instances as text.
+  void addIcon(uint16_t code,
+               glm::vec2 const & origin,
+               float pixelSize,
+               glm::vec4 const & color,
+               GlyphSet const & glyphSet);
+  // Uses the glyph set of the current glyph atlas.
+  void addIcon(uint16_t code,
+               glm::vec2 const & origin,
+               float pixelSize,
+               glm::vec4 const & color);
+  // Label templates are strings drawn at many places (units, tick labels, map
+  // labels). A template is laid out once into its own instances, and every label
+  // adds only a stamp with its position and color. Templates are laid out with the
+  // glyph set of the current atlas, again whenever the atlas is swapped. Labels are
+  // always drawn from SDF (no coverage bitmaps or greeking), after the other text.
+  // They are not included in getSdfGlyphs and in the text index.
+  using LabelTemplateId = uint32_t;
+  LabelTemplateId addLabelTemplate(std::string const & s, float pixelSize);
+  size_t getLabelTemplatesCount() const { return m_labelTemplates.size(); }
+  // Draws the template with the pen position of its first glyph at `origin`.
+  void addLabel(LabelTemplateId templateId, glm::vec2 const & origin, glm::vec4 const & color);
+  size_t getLabelsCount() const { return m_labels.size(); }
+  // Stamps are uploaded only if the labels changed since the buffer of the frame
+  // was written.
+  size_t getUploadedStampsCount() const { return m_uploadedStampsCount; }
+
   void endLayouting(MTL::Device * const device);
 
   void render(glm::vec2 const & screenSize,
               MTL::RenderCommandEncoder * commandEncoder,
               MTL::Texture * glyphTexture);
+  // Uses the texture of the current glyph atlas.
+  void render(glm::vec2 const & screenSize, MTL::RenderCommandEncoder * commandEncoder);
+
+  struct LayoutThroughput {
+    // Millions of glyphs laid out per second.
+    double m_interleavedMGlyphsPerSec = 0.0;
+    double m_mGlyphsPerSec = 0.0;
+  };
+  // Single-threaded microbenchmark of laying out a run of `runLength` glyphs as
+  // addText does it against placing glyphs directly into their instances (which
+  // addText does for short runs).
+  static LayoutThroughput measureLayoutThroughput(GlyphSet const & glyphSet,
+                                                  size_t runLength = 10000);
 
 private:
-  MTL::Buffer * m_glyphBuffer = nullptr;
-  uint32_t m_glyphBufferSize = 0;
+  bool addCoverageGlyph(GlyphSet const & glyphSet,
+                        uint16_t code,
+                        uint32_t pixelSize,
+                        glm::vec2 const & pen,
+                        glm::vec4 const & color);
+  void mergeRecordedRuns();
+  void updateCoverageTexture(MTL::Device * const device);
+  void layoutLabelTemplates(MTL::Device * const device);
+  void updateStamps(MTL::Device * const device);
+
+  uint32_t m_maxFramesInFlight = 3;
+  uint64_t m_frameIndex = 0;
+
+  std::shared_ptr<GlyphAtlas const> m_glyphAtlas;
+  uint64_t m_glyphAtlasGeneration = 0;
+  std::mutex m_pendingGlyphAtlasMutex;
+  std::shared_ptr<GlyphAtlas const> m_pendingGlyphAtlas;
+  // Replaced atlases with the frame index after which they can be released.
+  std::vector<std::pair<uint64_t, std::shared_ptr<GlyphAtlas const>>> m_retiredGlyphAtlases;
+
+  // Every frame in flight has its own instance buffer, so an upload never touches
+  // instances which GPU may still read.
+  struct FrameBuffer {
+    MTL::Buffer * m_glyphBuffer = nullptr;
+    uint32_t m_glyphBufferSize = 0;
+    // Hash of the instances in the buffer, the upload is skipped if it's unchanged.
+    std::optional<size_t> m_glyphsHash;
+    MTL::Buffer * m_stampBuffer = nullptr;
+    uint32_t m_stampBufferSize = 0;
+    std::optional<size_t> m_stampsHash;
+  };
+  FrameBuffer & getFrameBuffer() { return m_frameBuffers[m_frameIndex % m_frameBuffers.size()]; }
+  std::vector<FrameBuffer> m_frameBuffers;
   MTL::RenderPipelineState * m_pipelineState = nullptr;
+  MTL::RenderPipelineState * m_coveragePipelineState = nullptr;
+  MTL::RenderPipelineState * m_stampedPipelineState = nullptr;
+
+  bool m_smallTextCoverageEnabled = true;
+  uint32_t m_greekingPixelSize = 4;
+  CoverageAtlas m_coverageAtlas;
+  MTL::Texture * m_coverageTexture = nullptr;
+  uint64_t m_coverageAtlasGeneration = 0;
+  std::vector<std::pair<uint64_t, MTL::Texture *>> m_retiredCoverageTextures;
 
+  std::shared_ptr<GlyphUsageStats> m_usageStats;
+
+  bool m_textIndexEnabled = false;
+  TextIndex m_textIndex;
+  uint32_t m_runsCount = 0;
+  std::vector<float> m_carets;
+
+  // SDF glyphs are followed by coverage glyphs (and greeking bars) in the glyph buffer.
   std::vector<Glyph> m_screenGlyphs;
+  std::vector<Glyph> m_screenCoverageGlyphs;
+
+  std::vector<std::unique_ptr<Recorder>> m_recorders;
+  std::vector<Recorder const *> m_detachedRecorders;
+  struct RecordedRun {
+    Recorder const * m_recorder = nullptr;
+    Recorder::Run const * m_run = nullptr;
+    size_t m_glyphsOffset = 0;
+    size_t m_barsOffset = 0;
+  };
+  std::vector<RecordedRun> m_recordedRuns;
   size_t m_screenGlyphsHash = 0;
-  size_t m_prevScreenGlyphsHash = 0;
+
+  struct LabelTemplate {
+    std::string m_text;
+    float m_pixelSize = 0.0f;
+    // Range in the template glyph buffer.
+    uint32_t m_firstGlyph = 0;
+    uint32_t m_glyphsCount = 0;
+    // Range in the stamp buffer in the current frame.
+    uint32_t m_firstStamp = 0;
+    uint32_t m_stampsCount = 0;
+  };
+  std::vector<LabelTemplate> m_labelTemplates;
+  // Templates are laid out again after they are added or the atlas is swapped.
+  bool m_labelTemplatesChanged = false;
+  std::vector<Glyph> m_templateGlyphs;
+  std::vector<uint16_t> m_templateCodes;
+  MTL::Buffer * m_templateGlyphBuffer = nullptr;
+  // Replaced template buffers with the frame index after which they can be released.
+  std::vector<std::pair<uint64_t, MTL::Buffer *>> m_retiredTemplateGlyphBuffers;
+  std::vector<std::pair<LabelTemplateId, Stamp>> m_labels;
+  // Stamps grouped by template.
+  std::vector<Stamp> m_stamps;
+  size_t m_stampsHash = 0;
+  size_t m_uploadedStampsCount = 0;
 };
 
 }  // namespace sdf::gpu
@@ -0,0 +1,85 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "texture_cache_simulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <unordered_map>
+
+namespace sdf::cpu {
+
+// static
+TextureCacheSimulator::Stats TextureCacheSimulator::simulate(std::vector<Glyph> const & glyphs,
+                                                             glm::uvec2 const & atlasSize,
+                                                             Params const & params) {
+  Stats stats;
+  if (atlasSize.x == 0 || atlasSize.y == 0 || params.m_tileSize == 0) {
+    return stats;
+  }
+  auto const tileBytes = params.m_tileSize * params.m_tileSize * params.m_bytesPerTexel;
+  auto const cacheLinesCount = std::max(params.m_cacheSizeInBytes / tileBytes, 1u);
+  auto const tilesX = (atlasSize.x + params.m_tileSize - 1) / params.m_tileSize;
+  auto const tilesY = (atlasSize.y + params.m_tileSize - 1) / params.m_tileSize;
+
+  // Most recently used tiles are in front.
+  std::list<uint32_t> lru;
+  std::unordered_map<uint32_t, std::list<uint32_t>::iterator> cachedTiles;
+  std::vector<bool> isTouched(static_cast<size_t>(tilesX) * tilesY, false);
+
+  auto const size = glm::vec2(atlasSize);
+  for (auto const & g : glyphs) {
+    // Bilinear filtering reads one more texel around the rect.
+    auto const uvCenter = glm::vec2(g.uvCenter.x, g.uvCenter.y);
+    auto const uvHalfSize = glm::vec2(g.uvHalfSize.x, g.uvHalfSize.y);
+    auto const minTexel = glm::floor((uvCenter - uvHalfSize) * size) - 1.0f;
+    auto const maxTexel = glm::ceil((uvCenter + uvHalfSize) * size);
+    auto toTile = [&](float texel, uint32_t tilesCount) {
+      auto const tile = static_cast<int64_t>(texel) / static_cast<int64_t>(params.m_tileSize);
+      return static_cast<uint32_t>(std::clamp<int64_t>(tile, 0, tilesCount - 1));
+    };
+    auto const tx0 = toTile(std::max(minTexel.x, 0.0f), tilesX);
+    auto const ty0 = toTile(std::max(minTexel.y, 0.0f), tilesY);
+    auto const tx1 = toTile(std::max(maxTexel.x, 0.0f), tilesX);
+    auto const ty1 = toTile(std::max(maxTexel.y, 0.0f), tilesY);
+
+    for (auto ty = ty0; ty <= ty1; ++ty) {
+      for (auto tx = tx0; tx <= tx1; ++tx) {
+        auto const tile = ty * tilesX + tx;
+        stats.m_tileAccessesCount++;
+        if (!isTouched[tile]) {
+          isTouched[tile] = true;
+          stats.m_footprintTilesCount++;
+        }
+        auto const it = cachedTiles.find(tile);
+        if (it != cachedTiles.end()) {
+          lru.splice(lru.begin(), lru, it->second);
+          continue;
+        }
+        stats.m_missesCount++;
+        lru.push_front(tile);
+        cachedTiles[tile] = lru.begin();
+        if (lru.size() > cacheLinesCount) {
+          cachedTiles.erase(lru.back());
+          lru.pop_back();
+        }
+      }
+    }
+  }
+  stats.m_footprintBytes = stats.m_footprintTilesCount * tileBytes;
+  return stats;
+}
+
+}  // namespace sdf::cpu
@@ -0,0 +1,60 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/glm_math.hpp"
+#include "sdf_text_types.h"
+
+namespace sdf::cpu {
+
+// Estimates how glyph instances of a frame use the texture cache while sampling
+// the atlas. Every instance reads the tiles its atlas rect covers (plus the
+// bilinear footprint), instances are processed in draw order through a fully
+// associative LRU cache. Real GPUs shade many instances at once and have
+// several cache levels, so the numbers are for comparing atlas layouts, not
+// absolute predictions.
+class TextureCacheSimulator {
+public:
+  struct Params {
+    // Texels are cached in square tiles, 8x8 R8 texels make a 64-byte line.
+    uint32_t m_tileSize = 8;
+    uint32_t m_bytesPerTexel = 1;
+    uint32_t m_cacheSizeInBytes = 16 * 1024;
+  };
+
+  struct Stats {
+    size_t m_tileAccessesCount = 0;
+    size_t m_missesCount = 0;
+    // Distinct tiles read during the frame.
+    size_t m_footprintTilesCount = 0;
+    size_t m_footprintBytes = 0;
+
+    float getHitRate() const {
+      return m_tileAccessesCount == 0
+               ? 1.0f
+               : 1.0f - static_cast<float>(m_missesCount) / m_tileAccessesCount;
+    }
+  };
+
+  static Stats simulate(std::vector<Glyph> const & glyphs,
+                        glm::uvec2 const & atlasSize,
+                        Params const & params);
+};
+
+}  // namespace sdf::cpu
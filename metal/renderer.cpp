@@ -14,10 +14,21 @@
 
 #include "renderer.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <thread>
 
 #include "common/utils.hpp"
+#include "lib/atlas_bake_service.hpp"
+#include "lib/baked_atlas.hpp"
+#include "lib/font_file.hpp"
+#include "lib/glyph_packing_order.hpp"
 #include "lib/glyph_texture.hpp"
+#include "lib/shared_atlas.hpp"
+#include "lib/texture_cache_simulator.hpp"
 
 App * getApp() {
   static Renderer app;
@@ -29,6 +40,72 @@ char const * const kDemoName = "GPU Accelerated SDF Text";
 namespace {
 uint32_t constexpr kMaxFramesInFlight = 3;
 
+// If set, the glyph atlas is taken from (or published to) the shared memory
+// segment with this name prefix, e.g. SDF_SHARED_ATLAS=/sdf-text-ui. The key of
+// the atlas parameters is appended, see SharedAtlas::makeName.
+char const * const kSharedAtlasEnvVar = "SDF_SHARED_ATLAS";
+
+// If set, the glyph atlas is requested from the local bake service listening
+// on this socket, e.g. SDF_BAKE_SERVICE=/tmp/sdf-bake.sock.
+char const * const kBakeServiceEnvVar = "SDF_BAKE_SERVICE";
+
+// If set, the demo glyphs are extracted from this font file (TrueType or CFF) on
+// CPU threads instead of CoreText, e.g. SDF_FONT_FILE=/Library/Fonts/Arial Unicode.ttf.
+// The bake service bakes CoreText fonts only, so it's not used then.
+char const * const kFontFileEnvVar = "SDF_FONT_FILE";
+
+char const * const kFontNames[] = {"Helvetica", "Times New Roman", "Courier New", "Menlo"};
+
+// Text which the demo draws, glyphs which appear together in it are packed
+// next to each other with co-occurrence packing.
+char const * const kDemoCorpus =
+  "This text is rendered by GPU Accelerated SDF algorithm written by @rokuz "
+  "Tiny text is rasterized to coverage bitmaps on CPU "
+  "Captions are measured and truncated without laying them out "
+  "Lorem ipsum dolor sit amet, consectetur adipiscing elit "
+  "Edits: 0123456789 Only changed glyphs are uploaded";
+
+uint16_t constexpr kIconPlay = sdf::GlyphSet::kFirstIconCode;
+uint16_t constexpr kIconRing = sdf::GlyphSet::kFirstIconCode + 1;
+uint16_t constexpr kIconHeart = sdf::GlyphSet::kFirstIconCode + 2;
+
+// Icons in a 24x24 view box, y goes down.
+std::vector<sdf::GlyphSet::Icon> makeDemoIcons() {
+  sdf::GlyphSet::Icon play;
+  play.m_code = kIconPlay;
+  play.moveTo({6, 3}).lineTo({21, 12}).lineTo({6, 21}).close();
+
+  // The inner circle makes a hole, odd number of crossings means inside.
+  sdf::GlyphSet::Icon ring;
+  ring.m_code = kIconRing;
+  auto addCircle = [&ring](float radius) {
+    float constexpr k = 0.5523f;  // Control point distance of a cubic quarter circle.
+    auto const c = glm::vec2(12, 12);
+    auto const r = radius;
+    ring.moveTo(c + glm::vec2(r, 0))
+      .cubicTo(c + glm::vec2(r, r * k), c + glm::vec2(r * k, r), c + glm::vec2(0, r))
+      .cubicTo(c + glm::vec2(-r * k, r), c + glm::vec2(-r, r * k), c + glm::vec2(-r, 0))
+      .cubicTo(c + glm::vec2(-r, -r * k), c + glm::vec2(-r * k, -r), c + glm::vec2(0, -r))
+      .cubicTo(c + glm::vec2(r * k, -r), c + glm::vec2(r, -r * k), c + glm::vec2(r, 0))
+      .close();
+  };
+  addCircle(10.0f);
+  addCircle(6.0f);
+
+  sdf::GlyphSet::Icon heart;
+  heart.m_code = kIconHeart;
+  heart.moveTo({12, 21})
+    .cubicTo({5, 15}, {2, 12}, {2, 8})
+    .cubicTo({2, 5}, {4.5f, 3}, {7, 3})
+    .quadTo({10, 3}, {12, 6})
+    .quadTo({14, 3}, {17, 3})
+    .cubicTo({19.5f, 3}, {22, 5}, {22, 8})
+    .cubicTo({22, 12}, {19, 15}, {12, 21})
+    .close();
+
+  return {play, ring, heart};
+}
+
 std::vector<uint16_t> enumerateGlyphs() {
   static std::string const kGlyphs =
     "abcdefghijklmnopqrstuvwxyz "
@@ -39,9 +116,41 @@ std::vector<uint16_t> enumerateGlyphs() {
   }
   return v;
 }
+
+// Zoomed out document, most of the runs are greeked.
+uint32_t constexpr kOverviewRows = 150;
+glm::vec2 const kOverviewPosition = glm::vec2(20, 60);
+
+// Lays out rows [rowsBegin; rowsEnd) of the overview, returns the size of the whole overview.
+template <typename Target>
+glm::vec2 addOverview(Target & target,
+                      glm::vec2 const & origin,
+                      uint32_t rowsBegin,
+                      uint32_t rowsEnd) {
+  uint32_t constexpr kColumns = 4;
+  auto const sz = glm::vec2(180, 2.5f);
+  for (uint32_t row = rowsBegin; row < rowsEnd; ++row) {
+    for (uint32_t column = 0; column < kColumns; ++column) {
+      target.addText("Lorem ipsum dolor sit amet, consectetur adipiscing elit",
+                     origin + glm::vec2(column * (sz.x + 20), row * (sz.y + 1.5f)),
+                     sz,
+                     glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+    }
+  }
+  return glm::vec2(kColumns * (sz.x + 20), kOverviewRows * (sz.y + 1.5f));
+}
+
+// Tick labels of a chart grid, a few distinct strings repeated many times.
+char const * const kTickLabels[] = {
+  "0 ms", "10 ms", "20 ms", "30 ms", "40 ms", "50 ms", "60 ms", "70 ms", "80 ms", "90 ms"};
+float constexpr kTickLabelPixelSize = 11.0f;
+uint32_t constexpr kChartColumns = 24;
+uint32_t constexpr kChartRows = 60;
+glm::vec2 const kChartPosition = glm::vec2(20, 140);
+glm::vec2 const kChartCellSize = glm::vec2(40, 12);
 }  // namespace
 
-Renderer::Renderer() : m_glyphs(enumerateGlyphs()) {}
+Renderer::Renderer() = default;
 
 char const * const Renderer::getName() const { return kDemoName; }
 
@@ -65,17 +174,142 @@ bool Renderer::onInitialize(MTL::Device * const device,
   METAL_ASSERT(m_library != 0);
 
   auto t1 = std::chrono::steady_clock::now();
-  m_glyphTexture = sdf::gpu::GlyphTexture::generate(m_context->m_device,
+  std::unique_ptr<sdf::GlyphSet> glyphs;
+  MTL::Texture * glyphTexture = nullptr;
+  uint64_t glyphChecksum = 0;
+  sdf::BakeParams atlasParams;
+  atlasParams.m_glyphs = enumerateGlyphs();
+  atlasParams.m_icons = makeDemoIcons();
+  std::unique_ptr<sdf::FontFile> fontFile;
+  if (char const * fontFilePath = std::getenv(kFontFileEnvVar)) {
+    fontFile = sdf::FontFile::open(fontFilePath);
+    if (fontFile != nullptr) {
+      // Atlases of the font file are shared under their own name.
+      atlasParams.m_fontName = fontFilePath;
+      m_fontFileMappingSize = fontFile->getMappingSize();
+    }
+  }
+  char const * sharedAtlasPrefix = std::getenv(kSharedAtlasEnvVar);
+  std::string sharedAtlasName;
+  // Texels are sampled from the shared mapping, so it lives as long as the atlas.
+  std::shared_ptr<sdf::SharedAtlas const> sharedAtlas;
+  if (sharedAtlasPrefix != nullptr) {
+    sharedAtlasName = sdf::SharedAtlas::makeName(sharedAtlasPrefix, atlasParams.getKey());
+    if (auto atlas = sdf::SharedAtlas::open(sharedAtlasName, atlasParams.getKey())) {
+      glyphTexture = sdf::gpu::GlyphTexture::createNoCopy(m_context->m_device,
+                                                          atlas->getAtlasSize(),
+                                                          atlas->getTexels(),
+                                                          atlas->getBytesPerRow(),
+                                                          atlas->getTexelsSize());
+      if (glyphTexture != nullptr) {
+        glyphs = atlas->releaseGlyphSet();
+        glyphChecksum = atlas->getChecksum();
+        sharedAtlas = std::move(atlas);
+        m_usesSharedAtlas = true;
+      }
+    }
+  }
+  char const * bakeServiceSocket = std::getenv(kBakeServiceEnvVar);
+  if (glyphTexture == nullptr && bakeServiceSocket != nullptr && fontFile == nullptr) {
+    if (auto atlas = sdf::AtlasBakeClient::requestAtlas(bakeServiceSocket, atlasParams)) {
+      glyphs = std::make_unique<sdf::GlyphSet>(std::move(atlas->m_glyphs),
+                                               atlas->m_atlasSize,
+                                               atlasParams.m_fontSize,
+                                               atlasParams.m_fontName);
+      glyphTexture = sdf::gpu::GlyphTexture::createFromTexels(m_context->m_device,
+                                                              atlas->m_atlasSize,
+                                                              atlas->m_texels.data());
+      glyphChecksum = atlas->m_checksum;
+    }
+  }
+  // Atlases shared with other processes should depend on the baking GPU as little
+  // as possible, their checksum is taken from the publisher anyway.
+  m_deterministicBake = sharedAtlasPrefix != nullptr;
+  std::vector<uint8_t> glyphTexels;
+  if (glyphTexture == nullptr && fontFile != nullptr) {
+    auto const t2 = std::chrono::steady_clock::now();
+    glyphs = std::make_unique<sdf::GlyphSet>(*fontFile,
+                                             atlasParams.m_glyphs,
+                                             atlasParams.m_atlasSize,
+                                             atlasParams.m_fontSize,
+                                             atlasParams.m_packingOrder,
+                                             atlasParams.m_icons);
+    m_fontFileGlyphsTimeMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t2).count();
+  } else if (glyphTexture == nullptr) {
+    glyphs = std::make_unique<sdf::GlyphSet>(atlasParams.m_glyphs,
+                                             atlasParams.m_atlasSize,
+                                             atlasParams.m_fontSize,
+                                             atlasParams.m_fontName,
+                                             atlasParams.m_packingOrder,
+                                             atlasParams.m_icons);
+  }
+  if (glyphTexture == nullptr) {
+    glyphTexture = sdf::gpu::GlyphTexture::generate(m_context->m_device,
                                                     m_context->m_commandQueue,
                                                     m_library,
-                                                    m_glyphs);
+                                                    *glyphs,
+                                                    m_deterministicBake);
+    glyphTexels = sdf::gpu::GlyphTexture::readTexels(m_context->m_device,
+                                                     m_context->m_commandQueue,
+                                                     glyphTexture);
+    if (sharedAtlasPrefix != nullptr) {
+      sdf::SharedAtlas::publish(sharedAtlasName, atlasParams.getKey(), *glyphs, glyphTexels);
+    }
+  }
   auto const duration = std::chrono::steady_clock::now() - t1;
   m_glyphGenTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  if (!glyphTexels.empty()) {
+    glyphChecksum =
+      sdf::computeAtlasChecksum(glyphs->getGlyphs(), glyphs->getAtlasSize(), glyphTexels.data());
+  }
 
   m_textRenderer = std::make_unique<sdf::gpu::TextRenderer>();
-  if (!m_textRenderer->initialize(m_context->m_device, m_library)) {
+  if (!m_textRenderer->initialize(m_context->m_device, m_library, kMaxFramesInFlight)) {
+    return false;
+  }
+  auto glyphAtlas = std::make_shared<sdf::gpu::GlyphAtlas const>(
+    std::move(glyphs), glyphTexture, glyphChecksum, std::move(sharedAtlas));
+  m_textRenderer->setGlyphAtlas(glyphAtlas);
+  for (auto const tickLabel : kTickLabels) {
+    m_tickLabelTemplates.push_back(
+      m_textRenderer->addLabelTemplate(tickLabel, kTickLabelPixelSize));
+  }
+
+  m_layoutThread =
+    std::make_unique<sdf::gpu::LayoutThread>([](sdf::gpu::TextRenderer::Recorder & recorder) {
+      addOverview(recorder, kOverviewPosition, 0, kOverviewRows);
+    });
+
+  m_overviewLayer = std::make_unique<sdf::gpu::TextLayer>();
+  if (!m_overviewLayer->initialize(m_context->m_device, m_library, kMaxFramesInFlight)) {
+    return false;
+  }
+  m_overviewLayer->setGlyphAtlas(glyphAtlas);
+
+  m_editableText = std::make_unique<sdf::gpu::EditableText>(20.0f);
+  if (!m_editableText->initialize(m_context->m_device, m_library, kMaxFramesInFlight)) {
     return false;
   }
+  m_editableText->setGlyphAtlas(glyphAtlas);
+  m_editableText->setText("Edits: 0000000\nOnly changed glyphs are uploaded");
+  m_editableText->setColor(glm::vec4(0.5f, 0.1f, 0.1f, 1.0f));
+
+  m_renderTimeField = std::make_unique<sdf::gpu::NumericField>(3, 2, 20.0f);
+  if (!m_renderTimeField->initialize(m_context->m_device, m_library, kMaxFramesInFlight)) {
+    return false;
+  }
+  m_renderTimeField->setGlyphAtlas(glyphAtlas);
+  m_renderTimeField->setColor(glm::vec4(0.1f, 0.3f, 0.1f, 1.0f));
+  m_renderTimeLabel = m_textRenderer->addLabelTemplate(" ms on the render thread", 20.0f);
+
+  m_imGuiSdfFont = std::make_unique<ImGuiSdfFont>();
+  if (!m_imGuiSdfFont->initialize(m_context->m_device, m_library)) {
+    return false;
+  }
+  m_imGuiSdfFont->setGlyphAtlas(glyphAtlas);
+
+  m_atlasRebuilder = std::make_unique<sdf::gpu::AtlasRebuilder>(m_context->m_device, m_library);
 
   return true;
 }
@@ -85,15 +319,30 @@ void Renderer::onDeinitialize() {
   commandBuffer->commit();
   commandBuffer->waitUntilCompleted();
 
-  if (m_glyphTexture) {
-    m_glyphTexture->release();
-  }
-
+  m_atlasRebuilder.reset();
+  m_overviewLayer.reset();
+  m_overviewRecorders.clear();
+  m_layoutThread.reset();
+  m_imGuiSdfFont.reset();
+  m_editableText.reset();
+  m_renderTimeField.reset();
   m_textRenderer.reset();
 
   m_library->release();
 }
 
+void Renderer::requestAtlasRebuild() {
+  sdf::BakeParams params;
+  params.m_fontName = kFontNames[m_fontIndex];
+  params.m_glyphs = enumerateGlyphs();
+  params.m_icons = makeDemoIcons();
+  if (m_cooccurrencePacking) {
+    params.m_glyphs = sdf::getCooccurrencePackingOrder(params.m_glyphs, kDemoCorpus);
+    params.m_packingOrder = sdf::GlyphSet::PackingOrder::AsGiven;
+  }
+  m_atlasRebuilder->requestRebuild(params, m_deterministicBake);
+}
+
 void Renderer::onResize(uint32_t screenWidth, uint32_t screenHeight) {
   m_screenWidth = screenWidth;
   m_screenHeight = screenHeight;
@@ -102,9 +351,22 @@ void Renderer::onResize(uint32_t screenWidth, uint32_t screenHeight) {
 void Renderer::renderFrame(MTL::CommandBuffer * frameCommandBuffer,
                            MTL::Texture * outputTexture,
                            double elapsedSeconds) {
+  auto const frameStart = std::chrono::steady_clock::now();
   NS::AutoreleasePool * autoreleasePool = NS::AutoreleasePool::alloc()->init();
   METAL_GUARD(autoreleasePool);
 
+  // Fonts are rebuilt in background, the new atlas is swapped in at the next frame.
+  if (auto glyphAtlas = m_atlasRebuilder->takeRebuiltAtlas()) {
+    if (m_log != nullptr) {
+      m_log->setGlyphSet(glyphAtlas->getGlyphSet());
+    }
+    m_overviewLayer->setGlyphAtlas(glyphAtlas);
+    m_editableText->setGlyphAtlas(glyphAtlas);
+    m_renderTimeField->setGlyphAtlas(glyphAtlas);
+    m_imGuiSdfFont->setGlyphAtlas(glyphAtlas);
+    m_textRenderer->setGlyphAtlas(std::move(glyphAtlas));
+  }
+
   m_textRenderer->beginLayouting();
 
   auto const screenSz = glm::vec2(m_screenWidth, m_screenHeight);
@@ -115,24 +377,159 @@ void Renderer::renderFrame(MTL::CommandBuffer * frameCommandBuffer,
     m_textRenderer->addText("This text is rendered by",
                             glm::vec2(screenSz - sz) * 0.5f + screenSz * glm::vec2(-0.25f, 0.1f),
                             sz,
-                            glm::vec4(0.1f, 0.1f, 0.1f, 1.0f),
-                            m_glyphs);
+                            glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
     sz = glm::vec2(600, 200);
     m_textRenderer->addText("GPU Accelerated SDF algorithm",
                             glm::vec2(screenSz - sz) * 0.5f,
                             sz,
-                            glm::vec4(0.5f, 0.1f, 0.1f, 1.0f),
-                            m_glyphs);
+                            glm::vec4(0.5f, 0.1f, 0.1f, 1.0f));
     sz = glm::vec2(200, 200);
     m_textRenderer->addText("written by @rokuz",
                             glm::vec2(screenSz - sz) * 0.5f + screenSz * glm::vec2(0.25f, -0.1f),
                             sz,
-                            glm::vec4(0.1f, 0.1f, 0.1f, 1.0f),
-                            m_glyphs);
+                            glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+    // Tiny text, drawn from coverage bitmaps.
+    sz = glm::vec2(400, 6);
+    m_textRenderer->addText("Tiny text is rasterized to coverage bitmaps on CPU",
+                            glm::vec2(20, 20),
+                            sz,
+                            glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+
+    // Caption with a fixed font size, truncated to the available width.
+    float constexpr kCaptionPixelSize = 20.0f;
+    float constexpr kCaptionWidth = 300.0f;
+    sdf::TextMeasurer const measurer(m_textRenderer->getGlyphAtlas()->getGlyphSet());
+    auto const scale = kCaptionPixelSize / measurer.getBaseFontSize();
+    auto const caption = measurer.truncate(
+      "Captions are measured and truncated without laying them out", kCaptionWidth / scale);
+    m_textRenderer->addText(caption,
+                            glm::vec2(20.0f, screenSz.y - 40.0f),
+                            measurer.getLayoutSize(caption) * scale,
+                            glm::vec4(0.1f, 0.1f, 0.5f, 1.0f));
+
+    // Icons share the atlas and the draw call with text.
+    float constexpr kIconPixelSize = 32.0f;
+    auto iconOrigin = glm::vec2(screenSz.x * 0.5f - 1.5f * kIconPixelSize - 20.0f, 120.0f);
+    for (auto icon : {kIconPlay, kIconRing, kIconHeart}) {
+      m_textRenderer->addIcon(icon, iconOrigin, kIconPixelSize, glm::vec4(0.5f, 0.1f, 0.1f, 1.0f));
+      iconOrigin.x += kIconPixelSize + 20.0f;
+    }
+  }
+
+  // The overview is static, so it can be cached in a text layer which is rendered
+  // only once.
+  bool const drawOverviewLayer = m_showOverview && m_cacheOverviewInLayer;
+  if (drawOverviewLayer) {
+    m_overviewLayer->clear();
+    m_overviewLayer->setSize(addOverview(*m_overviewLayer, glm::vec2(0, 0), 0, kOverviewRows));
+    m_overviewLayer->setPosition(kOverviewPosition);
+    m_overviewLayer->update(m_context->m_device, frameCommandBuffer);
+  } else if (m_showOverview && m_recordOverviewOnThreads) {
+    // Every thread records a band of rows, bands are merged in the order of their keys.
+    uint32_t constexpr kBandsCount = 4;
+    while (m_overviewRecorders.size() < kBandsCount) {
+      m_overviewRecorders.push_back(&m_textRenderer->createRecorder());
+    }
+    auto const t = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t band = 0; band < kBandsCount; ++band) {
+      threads.emplace_back([&, band]() {
+        auto & recorder = *m_overviewRecorders[band];
+        recorder.setSubmissionKey(band);
+        addOverview(recorder,
+                    kOverviewPosition,
+                    band * kOverviewRows / kBandsCount,
+                    (band + 1) * kOverviewRows / kBandsCount);
+      });
+    }
+    for (auto & thread : threads) {
+      thread.join();
+    }
+    auto const duration = std::chrono::steady_clock::now() - t;
+    m_overviewLayoutTimeMs = std::chrono::duration<double, std::milli>(duration).count();
+  } else if (m_showOverview && m_overviewLayoutThread) {
+    // Laid out one frame ahead on the layout thread.
+    if (auto const frame = m_layoutThread->acquireFrame()) {
+      m_textRenderer->addRecorded(*frame);
+    }
+    m_layoutThread->requestFrame(m_textRenderer->getRecorderSettings());
+  } else if (m_showOverview) {
+    auto const t = std::chrono::steady_clock::now();
+    addOverview(*m_textRenderer, kOverviewPosition, 0, kOverviewRows);
+    auto const duration = std::chrono::steady_clock::now() - t;
+    m_overviewLayoutTimeMs = std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+  if (m_showChartLabels) {
+    auto const t = std::chrono::steady_clock::now();
+    auto const color = glm::vec4(0.2f, 0.2f, 0.5f, 1.0f);
+    sdf::TextMeasurer const measurer(m_textRenderer->getGlyphAtlas()->getGlyphSet());
+    auto const scale = kTickLabelPixelSize / static_cast<float>(measurer.getBaseFontSize());
+    for (uint32_t row = 0; row < kChartRows; ++row) {
+      for (uint32_t column = 0; column < kChartColumns; ++column) {
+        auto const tick = (row + column) % std::size(kTickLabels);
+        auto const origin = kChartPosition + glm::vec2(column, row) * kChartCellSize;
+        if (m_useLabelTemplates) {
+          m_textRenderer->addLabel(m_tickLabelTemplates[tick], origin, color);
+        } else {
+          auto const size = measurer.getLayoutSize(kTickLabels[tick]) * scale;
+          m_textRenderer->addText(kTickLabels[tick], origin, size, color);
+        }
+      }
+    }
+    auto const duration = std::chrono::steady_clock::now() - t;
+    m_chartLabelsLayoutTimeMs = std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+  // Virtualized log, only visible lines are laid out.
+  if (m_showLog) {
+    if (m_log == nullptr) {
+      uint32_t constexpr kLogLinesCount = 1000000;
+      auto const t = std::chrono::steady_clock::now();
+      m_log = std::make_unique<sdf::gpu::TextDocument>(14.0f);
+      m_log->setGlyphSet(m_textRenderer->getGlyphAtlas()->getGlyphSet());
+      for (uint32_t i = 0; i < kLogLinesCount; ++i) {
+        m_log->appendLine("[" + std::to_string(i) + "] Lorem ipsum dolor sit amet, consectetur");
+      }
+      auto const duration = std::chrono::steady_clock::now() - t;
+      m_logBuildTimeMs = std::chrono::duration<double, std::milli>(duration).count();
+    }
+    auto const viewportSize = glm::vec2(400.0f, 300.0f);
+    auto const maxScroll = std::max(0.0f, m_log->getContentSize().y - viewportSize.y);
+    auto const t = std::chrono::steady_clock::now();
+    m_logLaidOutLines = m_log->layout(*m_textRenderer,
+                                      glm::vec2(screenSz.x * 0.5f - viewportSize.x * 0.5f, 20.0f),
+                                      viewportSize,
+                                      glm::dvec2(0.0, static_cast<double>(m_logScroll) * maxScroll),
+                                      glm::vec4(0.1f, 0.3f, 0.1f, 1.0f));
+    auto const duration = std::chrono::steady_clock::now() - t;
+    m_logLayoutTimeMs = std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+  // Render thread time of the previous frame. Only changed digits are uploaded. The
+  // caption is a label at a fixed position, its stamp is uploaded only until every
+  // frame in flight has it, and the screen glyphs hash doesn't depend on it.
+  {
+    auto const origin = glm::vec2(20.0f, screenSz.y - 140.0f);
+    m_renderTimeField->setValue(m_renderThreadMs);
+    m_renderTimeField->setOrigin(origin);
+    m_renderTimeField->update();
+    m_textRenderer->addLabel(m_renderTimeLabel,
+                             origin + glm::vec2(m_renderTimeField->getWidth(), 0.0f),
+                             glm::vec4(0.1f, 0.3f, 0.1f, 1.0f));
   }
 
   m_textRenderer->endLayouting(m_context->m_device);
 
+  // Counter in the editable text, usually only the last digit is re-laid out and uploaded.
+  {
+    char counter[16];
+    snprintf(counter, sizeof(counter), "%07llu", static_cast<unsigned long long>(++m_editsCount));
+    m_editableText->replace(7, 7, counter);
+    m_editableText->setOrigin(glm::vec2(20.0f, screenSz.y - 80.0f));
+    m_editableText->update(m_context->m_device);
+  }
+
   auto renderPassDescriptor = MTL::RenderPassDescriptor::renderPassDescriptor();
   auto colorAttachment = renderPassDescriptor->colorAttachments()->object(0);
   colorAttachment->setTexture(outputTexture);
@@ -145,10 +542,16 @@ void Renderer::renderFrame(MTL::CommandBuffer * frameCommandBuffer,
   encoder->setLabel(STR("Main Command Encoder"));
 
   encoder->pushDebugGroup(STR("Encode Text Rendering"));
-  m_textRenderer->render(glm::vec2(m_screenWidth, m_screenHeight), encoder, m_glyphTexture);
+  m_textRenderer->render(glm::vec2(m_screenWidth, m_screenHeight), encoder);
+  if (drawOverviewLayer) {
+    m_overviewLayer->render(glm::vec2(m_screenWidth, m_screenHeight), encoder);
+  }
+  m_editableText->render(glm::vec2(m_screenWidth, m_screenHeight), encoder);
+  m_renderTimeField->render(glm::vec2(m_screenWidth, m_screenHeight), encoder);
   encoder->popDebugGroup();
 
   app::renderImGui(frameCommandBuffer, renderPassDescriptor, encoder, [=, this](ImGuiIO & io) {
+    m_imGuiSdfFont->beginFrame(encoder);
     m_fpsTimer += (1.0 / io.Framerate);
     m_frameCounter++;
     if (m_fpsTimer > 1.0) {
@@ -163,10 +566,155 @@ void Renderer::renderFrame(MTL::CommandBuffer * frameCommandBuffer,
     ImGui::Begin("Info & Controls");
     ImGui::Text("Device: %s", m_context->m_device->name()->utf8String());
     ImGui::Text("GPU Family: %s", m_gpuFamily.c_str());
-    ImGui::Text("SDF texture gen time: %llu ms", m_glyphGenTimeMs);
+    ImGui::Text("SDF texture %s time: %llu ms",
+                m_usesSharedAtlas ? "mapping" : "gen",
+                m_glyphGenTimeMs);
+    auto const & packingStats = m_textRenderer->getGlyphAtlas()->getGlyphSet().getPackingStats();
+    ImGui::Text("Atlas packing: %.2f ms, %u pages, %u retries",
+                packingStats.m_timeMs,
+                packingStats.m_pagesCount,
+                packingStats.m_retriesCount);
+    if (m_fontFileMappingSize != 0) {
+      ImGui::Text("Font file: %zu KB mapped, glyph set in %.2f ms",
+                  m_fontFileMappingSize / 1024,
+                  m_fontFileGlyphsTimeMs);
+    }
     ImGui::Text("Avg time frame = %.3f ms (%.1f FPS)",
                 m_fps == 0 ? 0.0f : (1000.0f / m_fps),
                 m_fps);
+    if (ImGui::Combo("Font", &m_fontIndex, kFontNames, IM_ARRAYSIZE(kFontNames))) {
+      requestAtlasRebuild();
+    }
+    if (m_atlasRebuilder->isRebuilding()) {
+      ImGui::SameLine();
+      ImGui::Text("(rebuilding)");
+    }
+    bool sdfUiFont = m_imGuiSdfFont->isEnabled();
+    if (ImGui::Checkbox("SDF UI font", &sdfUiFont)) {
+      m_imGuiSdfFont->setEnabled(sdfUiFont);
+    }
+    if (sdfUiFont) {
+      float uiFontSize = m_imGuiSdfFont->getPixelSize();
+      if (ImGui::SliderFloat("UI font size", &uiFontSize, 10.0f, 40.0f)) {
+        m_imGuiSdfFont->setPixelSize(uiFontSize);
+      }
+    }
+    ImGui::Checkbox("Deterministic bake", &m_deterministicBake);
+    if (ImGui::Checkbox("Co-occurrence packing", &m_cooccurrencePacking)) {
+      requestAtlasRebuild();
+    }
+    auto const cacheStats = sdf::cpu::TextureCacheSimulator::simulate(
+      m_textRenderer->getSdfGlyphs(),
+      m_textRenderer->getGlyphAtlas()->getGlyphSet().getAtlasSize(),
+      sdf::cpu::TextureCacheSimulator::Params());
+    ImGui::Text("Texture cache: %zu KB footprint, %.1f%% hits",
+                cacheStats.m_footprintBytes / 1024,
+                cacheStats.getHitRate() * 100.0f);
+    bool smallTextCoverage = m_textRenderer->isSmallTextCoverageEnabled();
+    if (ImGui::Checkbox("Coverage bitmaps for tiny text", &smallTextCoverage)) {
+      m_textRenderer->setSmallTextCoverageEnabled(smallTextCoverage);
+    }
+    ImGui::Checkbox("Document overview", &m_showOverview);
+    ImGui::SameLine();
+    ImGui::Checkbox("Cache in layer", &m_cacheOverviewInLayer);
+    if (m_showOverview && !m_cacheOverviewInLayer) {
+      ImGui::Checkbox("Record on threads", &m_recordOverviewOnThreads);
+      ImGui::SameLine();
+      ImGui::Checkbox("Layout thread", &m_overviewLayoutThread);
+      if (m_overviewLayoutThread && !m_recordOverviewOnThreads) {
+        auto const timings = m_layoutThread->getTimings();
+        ImGui::Text("Layout thread: %.2f ms layout, %.2f ms waiting, %llu dropped",
+                    timings.m_layoutMs,
+                    timings.m_waitMs,
+                    static_cast<unsigned long long>(timings.m_droppedFramesCount));
+        ImGui::Text("Render thread: %.2f ms", m_renderThreadMs);
+      } else {
+        ImGui::Text("Overview laid out in %.2f ms", m_overviewLayoutTimeMs);
+      }
+    }
+    ImGui::Text("Overview layer renders: %u", m_overviewLayer->getRendersCount());
+    ImGui::Checkbox("Chart labels", &m_showChartLabels);
+    ImGui::SameLine();
+    ImGui::Checkbox("Label templates", &m_useLabelTemplates);
+    if (m_showChartLabels) {
+      ImGui::Text("%u labels laid out in %.3f ms",
+                  kChartColumns * kChartRows,
+                  m_chartLabelsLayoutTimeMs);
+    }
+    ImGui::Checkbox("Virtualized log", &m_showLog);
+    if (m_showLog && m_log != nullptr) {
+      ImGui::SliderFloat("Log scroll", &m_logScroll, 0.0f, 1.0f);
+      ImGui::Text("Log: %zu lines, built in %.1f ms", m_log->getLinesCount(), m_logBuildTimeMs);
+      ImGui::Text("Log layout: %zu lines in %.3f ms", m_logLaidOutLines, m_logLayoutTimeMs);
+    }
+    bool collectUsageStats = m_usageStats != nullptr;
+    if (ImGui::Checkbox("Glyph usage stats", &collectUsageStats)) {
+      m_usageStats = collectUsageStats ? std::make_shared<sdf::GlyphUsageStats>() : nullptr;
+      m_textRenderer->setUsageStats(m_usageStats);
+    }
+    if (m_usageStats != nullptr) {
+      auto const & glyphSet = m_textRenderer->getGlyphAtlas()->getGlyphSet();
+      auto const unusedCount = m_usageStats->getUnusedCodes(glyphSet).size();
+      ImGui::Text("Glyphs drawn: %zu of %zu",
+                  glyphSet.getGlyphs().size() - unusedCount,
+                  glyphSet.getGlyphs().size());
+      ImGui::SameLine();
+      if (ImGui::Button("Export histogram")) {
+        m_usageStats->exportHistogram("glyph_usage.csv");
+      }
+    }
+    if (ImGui::Button("Measure segment cost")) {
+      m_segmentCost = sdf::cpu::GlyphTexture::measureSegmentCost(
+        m_textRenderer->getGlyphAtlas()->getGlyphSet());
+    }
+    if (m_segmentCost.m_segmentsNs > 0.0) {
+      ImGui::SameLine();
+      ImGui::Text("%.2f ns per segment (%.2f ns unprepared)",
+                  m_segmentCost.m_segmentsNs,
+                  m_segmentCost.m_linesNs);
+    }
+    if (ImGui::Button("Measure layout throughput")) {
+      m_layoutThroughput = sdf::gpu::TextRenderer::measureLayoutThroughput(
+        m_textRenderer->getGlyphAtlas()->getGlyphSet());
+    }
+    if (m_layoutThroughput.m_mGlyphsPerSec > 0.0) {
+      ImGui::SameLine();
+      ImGui::Text("%.1f M glyphs/s (%.1f M interleaved)",
+                  m_layoutThroughput.m_mGlyphsPerSec,
+                  m_layoutThroughput.m_interleavedMGlyphsPerSec);
+    }
+    ImGui::Text("Editable text uploads: %zu of %zu glyphs",
+                m_editableText->getUploadedGlyphsCount(),
+                m_editableText->getGlyphsCount());
+    ImGui::Text("Numeric field uploads: %zu of %zu glyphs",
+                m_renderTimeField->getUploadedGlyphsCount(),
+                m_renderTimeField->getGlyphsCount());
+    ImGui::Text("Label stamp uploads: %zu of %zu",
+                m_textRenderer->getUploadedStampsCount(),
+                m_textRenderer->getLabelsCount());
+    int greekingPixelSize = static_cast<int>(m_textRenderer->getGreekingPixelSize());
+    if (ImGui::SliderInt("Greeking below, px", &greekingPixelSize, 0, 10)) {
+      m_textRenderer->setGreekingPixelSize(static_cast<uint32_t>(greekingPixelSize));
+    }
+    bool textIndex = m_textRenderer->isTextIndexEnabled();
+    if (ImGui::Checkbox("Hit testing", &textIndex)) {
+      m_textRenderer->setTextIndexEnabled(textIndex);
+    }
+    if (textIndex && io.DisplaySize.x > 0.0f && io.DisplaySize.y > 0.0f) {
+      // Text is laid out in pixels with y going up.
+      auto const p = glm::vec2(io.MousePos.x / io.DisplaySize.x * m_screenWidth,
+                               (1.0f - io.MousePos.y / io.DisplaySize.y) * m_screenHeight);
+      if (auto const hit = m_textRenderer->getTextIndex().hitTest(p)) {
+        ImGui::Text("Hover: run %u, char %u", hit->m_runIndex, hit->m_charIndex);
+      } else {
+        ImGui::Text("Hover: none");
+      }
+    }
+    ImGui::Text("Instances: %zu SDF, %zu coverage",
+                m_textRenderer->getSdfGlyphsCount(),
+                m_textRenderer->getCoverageGlyphsCount());
+    ImGui::Text("Atlas checksum: %016llx",
+                static_cast<unsigned long long>(m_textRenderer->getGlyphAtlas()->getChecksum()));
     if (ImGui::Checkbox("Enable VSync", &enableVSync)) {
       app::setEnabledVSync(enableVSync);
     }
@@ -174,6 +722,10 @@ void Renderer::renderFrame(MTL::CommandBuffer * frameCommandBuffer,
       app::closeApp();
     }
     ImGui::End();
+    m_imGuiSdfFont->endFrame();
   });
   encoder->endEncoding();
+
+  auto const frameDuration = std::chrono::steady_clock::now() - frameStart;
+  m_renderThreadMs = std::chrono::duration<double, std::milli>(frameDuration).count();
 }
@@ -15,9 +15,19 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "common/app.hpp"
+#include "imgui_sdf_font.hpp"
+#include "lib/atlas_rebuilder.hpp"
+#include "lib/editable_text.hpp"
+#include "lib/glyph_texture_cpu.hpp"
+#include "lib/layout_thread.hpp"
+#include "lib/numeric_field.hpp"
+#include "lib/text_document.hpp"
 #include "lib/glyph_set.hpp"
+#include "lib/text_layer.hpp"
+#include "lib/text_measurer.hpp"
 #include "lib/text_renderer.hpp"
 
 class Renderer : public App {
@@ -39,6 +49,8 @@ public:
                    double elapsedSeconds) override;
 
 private:
+  void requestAtlasRebuild();
+
   struct MetalContext {
     MTL::Device * const m_device;
     MTL::CommandQueue * const m_commandQueue;
@@ -47,15 +59,48 @@ private:
   uint32_t m_screenWidth = 0;
   uint32_t m_screenHeight = 0;
 
-  sdf::GlyphSet m_glyphs;
   std::unique_ptr<sdf::gpu::TextRenderer> m_textRenderer;
+  std::unique_ptr<sdf::gpu::AtlasRebuilder> m_atlasRebuilder;
+  std::unique_ptr<sdf::gpu::TextLayer> m_overviewLayer;
+  // Owned by the text renderer.
+  std::vector<sdf::gpu::TextRenderer::Recorder *> m_overviewRecorders;
+  std::unique_ptr<sdf::gpu::LayoutThread> m_layoutThread;
+  std::unique_ptr<ImGuiSdfFont> m_imGuiSdfFont;
+  std::unique_ptr<sdf::gpu::TextDocument> m_log;
+  std::unique_ptr<sdf::gpu::EditableText> m_editableText;
+  std::unique_ptr<sdf::gpu::NumericField> m_renderTimeField;
+  sdf::gpu::TextRenderer::LabelTemplateId m_renderTimeLabel = 0;
+  std::shared_ptr<sdf::GlyphUsageStats> m_usageStats;
+  uint64_t m_editsCount = 0;
 
   MTL::Library * m_library = nullptr;
-  MTL::Texture * m_glyphTexture = nullptr;
 
   // Info & Controls.
   std::string m_gpuFamily;
   uint64_t m_glyphGenTimeMs = 0.0;
+  bool m_usesSharedAtlas = false;
+  double m_fontFileGlyphsTimeMs = 0.0;
+  size_t m_fontFileMappingSize = 0;
+  int m_fontIndex = 0;
+  bool m_deterministicBake = false;
+  bool m_cooccurrencePacking = false;
+  bool m_showOverview = false;
+  bool m_cacheOverviewInLayer = true;
+  bool m_recordOverviewOnThreads = false;
+  bool m_overviewLayoutThread = false;
+  double m_overviewLayoutTimeMs = 0.0;
+  double m_renderThreadMs = 0.0;
+  std::vector<sdf::gpu::TextRenderer::LabelTemplateId> m_tickLabelTemplates;
+  bool m_showChartLabels = false;
+  bool m_useLabelTemplates = true;
+  double m_chartLabelsLayoutTimeMs = 0.0;
+  bool m_showLog = false;
+  float m_logScroll = 0.0f;
+  double m_logBuildTimeMs = 0.0;
+  double m_logLayoutTimeMs = 0.0;
+  size_t m_logLaidOutLines = 0;
+  sdf::cpu::GlyphTexture::SegmentCost m_segmentCost;
+  sdf::gpu::TextRenderer::LayoutThroughput m_layoutThroughput;
   double m_fpsTimer = 0.0;
   uint32_t m_frameCounter = 0;
   double m_fps = 0.0;
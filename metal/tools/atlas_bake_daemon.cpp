@@ -0,0 +1,46 @@
+// Copyright © 2023 Roman Kuznetsov.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+#include "lib/atlas_bake_service.hpp"
+
+// Usage: atlas-bake-daemon <socket path> <cache directory> [workers count]
+int main(int argc, char ** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <socket path> <cache directory> [workers count]\n", argv[0]);
+    return 1;
+  }
+  auto const workersCount = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 0u;
+
+  // Block termination signals before any thread is started, so only sigwait gets them.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  sdf::AtlasBakeService service(argv[1], argv[2], workersCount);
+  if (!service.start()) {
+    fprintf(stderr, "Could not start the service on %s\n", argv[1]);
+    return 1;
+  }
+
+  int signal = 0;
+  sigwait(&signals, &signal);
+  service.stop();
+  return 0;
+}